@@ -60,12 +60,29 @@ struct Dir_light
 };
 uniform Dir_light dir_light;
 
+// gridlines drawn over the surface
+struct Grid_lines
+{
+    bool enabled;
+    float density;
+    float width;
+    vec3 color;
+};
+uniform Grid_lines grid_lines;
+
+// normals baked on a finer grid than the verticies, read with grid_coords
+uniform bool use_normal_map;
+uniform sampler2D normal_map;
+uniform mat3 normal_transform;
+
 // camera facing direction
 uniform vec3 light_forward;
 
 in vec2 tex_coords;
+in vec2 grid_coords;
 in vec3 normal_vec;
 in vec3 pos;
+in vec2 occlusion;
 
 void calc_point_lighting(in vec3 pos, in vec3 forward, in vec3 normal_vec,
     in Material material, in Point_light point_light, out vec3 scattered, out vec3 reflected);
@@ -73,21 +90,33 @@ void calc_point_lighting(in vec3 pos, in vec3 forward, in vec3 normal_vec,
 void calc_dir_lighting(in vec3 normal_vec, in Material material, in Dir_light dir_light,
     out vec3 scattered, out vec3 reflected);
 
+vec3 calc_grid_lines(in vec3 rgb, in vec2 coords, in Grid_lines grid_lines);
+
+vec3 calc_map_normal(in vec3 normal_vec, in vec2 coords, in sampler2D normal_map, in mat3 normal_transform);
+
 void main()
 {
     vec3 scattered = ambient_color, reflected = vec3(0.0, 0.0, 0.0);
     vec3 tmp_scattered, tmp_reflected;
 
-    calc_point_lighting(pos, light_forward, normal_vec, material, cam_light,
+    vec3 normal = normal_vec;
+    if(use_normal_map)
+        normal = calc_map_normal(normal_vec, grid_coords, normal_map, normal_transform);
+
+    calc_point_lighting(pos, light_forward, normal, material, cam_light,
         tmp_scattered, tmp_reflected);
     scattered += tmp_scattered;
     reflected += tmp_reflected;
 
-    calc_dir_lighting(normal_vec, material, dir_light, tmp_scattered, tmp_reflected);
+    calc_dir_lighting(normal, material, dir_light, tmp_scattered, tmp_reflected);
     scattered += tmp_scattered;
     reflected += tmp_reflected;
 
+    // darken diffuse light where the graph blocks itself
+    scattered *= gl_FrontFacing ? occlusion.x : occlusion.y;
+
     // add to material color (from material color) to lighting for final color
     vec3 rgb = min(color.rgb * scattered + reflected, vec3(1.0));
+    rgb = calc_grid_lines(rgb, grid_coords, grid_lines);
     frag_color = vec4(rgb, 1.0);
 }
@@ -53,6 +53,15 @@ struct Dir_light
     vec3 half_vec;
 };
 
+// gridlines drawn over the surface
+struct Grid_lines
+{
+    bool enabled;
+    float density; // cells along each axis
+    float width; // in pixels
+    vec3 color;
+};
+
 void calc_common_lighting(in vec3 normal_vec, in vec3 dir, in vec3 half_vec,
     in Material material, in Base_light base,
     out float diffuse_mul, out float specular_mul)
@@ -103,6 +112,48 @@ void calc_point_lighting(in vec3 pos, in vec3 forward, in vec3 normal_vec,
     reflected = point_light.base.color * specular_mul * atten * material.specular;
 }
 
+// mix gridlines into a color. coords run from 0 to 1 across the graph, and lines fall at every
+// multiple of 1 / density, except along the edges. the screen space rate of change of coords
+// gives the distance to the nearest line in pixels, which is used to anti-alias the lines
+vec3 calc_grid_lines(in vec3 rgb, in vec2 coords, in Grid_lines grid_lines)
+{
+    vec2 cells = coords * grid_lines.density;
+    // derivatives are taken before any branching
+    vec2 cells_per_pixel = max(fwidth(cells), vec2(1e-6));
+
+    if(!grid_lines.enabled)
+        return rgb;
+
+    vec2 line = floor(cells + 0.5);
+    vec2 dist = abs(cells - line) / cells_per_pixel;
+
+    // no lines on the edges
+    if(line.x <= 0.0 || line.x >= grid_lines.density)
+        dist.x = grid_lines.width;
+    if(line.y <= 0.0 || line.y >= grid_lines.density)
+        dist.y = grid_lines.width;
+
+    // fully covered within half the width of the line, falling off over the next pixel
+    float coverage = clamp(0.5 * grid_lines.width + 0.5 - min(dist.x, dist.y), 0.0, 1.0);
+    return mix(rgb, grid_lines.color, coverage);
+}
+
+// look up a normal in a normal map and transform it into view space. coords run from 0 to 1 across
+// the graph, landing on the centers of the first and last texels. undefined points are stored as
+// zero, so where those are mixed in, the interpolated vertex normal is used instead. so is any
+// normal facing away from it, as found at degenerate points like the poles of a sphere
+vec3 calc_map_normal(in vec3 normal_vec, in vec2 coords, in sampler2D normal_map, in mat3 normal_transform)
+{
+    vec2 size = vec2(textureSize(normal_map, 0));
+    vec3 map_normal = texture(normal_map, (coords * (size - 1.0) + 0.5) / size).xyz;
+
+    if(dot(map_normal, map_normal) < 0.25)
+        return normal_vec;
+
+    map_normal = normalize(normal_transform * map_normal);
+    return dot(map_normal, normal_vec) < 0.0 ? normal_vec : map_normal;
+}
+
 void calc_dir_lighting(in vec3 normal_vec, in Material material, in Dir_light dir_light,
     out vec3 scattered, out vec3 reflected)
 {
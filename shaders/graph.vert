@@ -22,24 +22,76 @@
 
 #version 330 core
 
+// with an implicit grid, only x holds data: the height
 layout(location = 0) in vec3 vert_pos;
 layout(location = 1) in vec2 vert_tex_coords;
-layout(location = 2) in vec3 vert_normal;
+// octahedral encoded normal. see packed_vertex.hpp
+layout(location = 2) in vec2 vert_normal;
+// baked ambient light reaching the front and back. see set_occlusion_attribs
+layout(location = 3) in vec2 vert_occlusion;
 
 uniform mat4 view_model_perspective;
 uniform mat4 view_model;
 uniform mat3 normal_transform;
 
+// rebuilds x, y, and tex coords from the vertex index. see Graph::Implicit_grid
+struct Implicit_grid
+{
+    bool enabled;
+    int num_columns;
+    int first_row;
+    vec2 origin;
+    vec2 step;
+    vec2 tex_step;
+    // change in gridline coords per column, row. set for any graph whose verticies form a grid
+    vec2 line_step;
+};
+uniform Implicit_grid implicit_grid;
+
+// points where dot(clip_plane, vec4(pos, 1.0)) < 0 are clipped, when GL_CLIP_DISTANCE0 is enabled
+uniform vec4 clip_plane;
+
 out vec2 tex_coords;
+// row and column, scaled to [0, 1], for gridlines drawn by the fragment shader
+out vec2 grid_coords;
 out vec3 normal_vec;
 out vec3 pos;
+out vec2 occlusion;
+
+// unfold a normal from the [-1, 1] square back onto the octahedron
+vec3 octahedral_decode(vec2 enc)
+{
+    vec3 n = vec3(enc, 1.0 - abs(enc.x) - abs(enc.y));
+    float t = max(-n.z, 0.0);
+    n.xy -= t * sign(n.xy);
+    return normalize(n);
+}
 
 void main()
 {
+    vec3 vert = vert_pos;
     tex_coords = vert_tex_coords;
+    occlusion = vert_occlusion;
+
+    vec2 grid_pos = vec2(gl_VertexID % max(implicit_grid.num_columns, 1),
+        implicit_grid.first_row + gl_VertexID / max(implicit_grid.num_columns, 1));
+
+    if(implicit_grid.enabled)
+    {
+        vert = vec3(implicit_grid.origin + grid_pos * implicit_grid.step, vert_pos.x);
+        tex_coords = grid_pos * implicit_grid.tex_step;
+    }
+
+    // graphs that aren't a grid (implicit surfaces) have gridlines over their tex coords instead
+    if(implicit_grid.line_step != vec2(0.0))
+        grid_coords = grid_pos * implicit_grid.line_step;
+    else
+        grid_coords = tex_coords;
+
     // transform the vertex normal into view space coordinates
-    normal_vec = normalize(normal_transform * vert_normal);
+    normal_vec = normalize(normal_transform * octahedral_decode(vert_normal));
     // same with vertex position
-    pos = vec3(view_model * vec4(vert_pos, 1.0));
-    gl_Position = view_model_perspective * vec4(vert_pos, 1.0);
+    pos = vec3(view_model * vec4(vert, 1.0));
+    gl_ClipDistance[0] = dot(clip_plane, vec4(vert, 1.0));
+    gl_Position = view_model_perspective * vec4(vert, 1.0);
 }
@@ -22,13 +22,46 @@
 
 #version 330 core
 
+// with an implicit grid, only x holds data: the height
 layout(location = 0) in vec3 vert_pos;
+// octahedral encoded normal, for normal.geom. unused otherwise
+layout(location = 2) in vec2 vert_normal;
 
 uniform mat4 perspective;
 uniform mat4 view_model;
 
+// rebuilds x & y from the vertex index. see Graph::Implicit_grid
+struct Implicit_grid
+{
+    bool enabled;
+    int num_columns;
+    int first_row;
+    vec2 origin;
+    vec2 step;
+};
+uniform Implicit_grid implicit_grid;
+
+// points where dot(clip_plane, vec4(pos, 1.0)) < 0 are clipped, when GL_CLIP_DISTANCE0 is enabled
+uniform vec4 clip_plane;
+
+// position in graph coordinates and encoded normal, for slice.geom and normal.geom
+out vec3 graph_pos;
+out vec2 graph_normal;
+
 void main()
 {
+    vec3 vert = vert_pos;
+
+    if(implicit_grid.enabled)
+    {
+        vec2 grid_pos = vec2(gl_VertexID % implicit_grid.num_columns, implicit_grid.first_row + gl_VertexID / implicit_grid.num_columns);
+        vert = vec3(implicit_grid.origin + grid_pos * implicit_grid.step, vert_pos.x);
+    }
+
+    graph_pos = vert;
+    graph_normal = vert_normal;
+    gl_ClipDistance[0] = dot(clip_plane, vec4(vert, 1.0));
+
     // draw vertex slightly in front of its actual coords
-    gl_Position = perspective * (view_model * vec4(vert_pos, 1.0) + vec4(0.0, 0.0, 0.01, 0.0));
+    gl_Position = perspective * (view_model * vec4(vert, 1.0) + vec4(0.0, 0.0, 0.01, 0.0));
 }
@@ -0,0 +1,392 @@
+// decimate.cpp
+// quadric error mesh simplification
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <queue>
+
+#include "decimate.hpp"
+#include "parallel.hpp"
+
+typedef std::array<GLushort, 3> Triangle;
+
+// symmetric 4x4 matrix for the sum of squared distances to a set of planes
+struct Quadric
+{
+    Quadric() = default;
+
+    // for the plane dot(n, p) + d = 0. n must be unit length
+    Quadric(const glm::dvec3 & n, const double d):
+        a{n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,
+                     n.y * n.y, n.y * n.z, n.y * d,
+                                n.z * n.z, n.z * d,
+                                           d * d}
+    {}
+
+    Quadric & operator+=(const Quadric & q)
+    {
+        for(int i = 0; i < 10; ++i)
+            a[i] += q.a[i];
+        return *this;
+    }
+
+    // sum of squared distances from p to the planes
+    double error(const glm::dvec3 & p) const
+    {
+        double e = a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y + 2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x
+                 + a[4] * p.y * p.y + 2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y
+                 + a[7] * p.z * p.z + 2.0 * a[8] * p.z
+                 + a[9];
+        // can come out slightly negative from rounding
+        return std::max(e, 0.0);
+    }
+
+    // upper triangle of the matrix, by rows
+    double a[10] = {};
+};
+
+// moving vertex from onto vertex to, removing from
+struct Collapse
+{
+    double cost;
+    GLushort from, to;
+    // versions of from & to when cost was calculated. if either has changed since, this is out of date
+    unsigned int from_version, to_version;
+
+    // reversed, so std::priority_queue gives us the cheapest first
+    bool operator<(const Collapse & other) const
+    {
+        return cost > other.cost;
+    }
+};
+
+// split triangle strips (with restarts) into triangles, skipping degenerate ones
+static void strip_triangles(const GLushort * index, const size_t count, std::vector<Triangle> & tris)
+{
+    size_t strip_begin = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(index[i] == restart_index)
+        {
+            strip_begin = i + 1;
+            continue;
+        }
+
+        if(i - strip_begin < 2)
+            continue;
+
+        GLushort a = index[i - 2], b = index[i - 1], c = index[i];
+        if(a == b || b == c || a == c)
+            continue;
+
+        // every other triangle in a strip has its winding reversed
+        if((i - strip_begin) % 2 == 0)
+            tris.push_back({a, b, c});
+        else
+            tris.push_back({b, a, c});
+    }
+}
+
+// simplify one chunk's triangles, in place
+// tris are relative to coords, which is the chunk's first vertex
+static void decimate_chunk(const glm::vec3 * coords, std::vector<Triangle> & tris,
+    const double max_error_sq, const size_t target_triangles)
+{
+    // reject collapses that rotate any triangle by more than this (cosine of the angle)
+    const double min_cos = 0.5;
+    // reject collapses that leave a vertex with more neighbors than this
+    // keeps triangles from fanning out around a few verticies, which is also slow
+    const size_t max_valence = 24;
+
+    size_t num_verts = 0;
+    for(const auto & t: tris)
+        num_verts = std::max<size_t>(num_verts, *std::max_element(t.begin(), t.end()) + 1);
+
+    std::vector<std::vector<size_t>> vert_tris(num_verts);
+    std::vector<char> tri_alive(tris.size(), true);
+    for(size_t t = 0; t < tris.size(); ++t)
+    {
+        for(auto v: tris[t])
+            vert_tris[v].push_back(t);
+    }
+
+    // verticies on a boundary edge (used by only one triangle) are never moved
+    // neither are verticies on non-manifold edges
+    std::vector<uint32_t> edges;
+    edges.reserve(tris.size() * 3);
+    for(const auto & t: tris)
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            uint32_t a = t[i], b = t[(i + 1) % 3];
+            edges.push_back(std::min(a, b) << 16 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<char> locked(num_verts, false);
+    for(size_t i = 0; i < edges.size();)
+    {
+        size_t run_end = i;
+        while(run_end < edges.size() && edges[run_end] == edges[i])
+            ++run_end;
+
+        if(run_end - i != 2)
+            locked[edges[i] >> 16] = locked[edges[i] & 0xFFFF] = true;
+
+        i = run_end;
+    }
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    // each vertex starts with the planes of the triangles around it
+    std::vector<Quadric> quadrics(num_verts);
+    for(const auto & t: tris)
+    {
+        glm::dvec3 p0(coords[t[0]]), p1(coords[t[1]]), p2(coords[t[2]]);
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double len = glm::length(n);
+        if(len == 0.0)
+            continue;
+
+        n /= len;
+        Quadric q(n, -glm::dot(n, p0));
+        for(auto v: t)
+            quadrics[v] += q;
+    }
+
+    std::vector<unsigned int> version(num_verts, 0);
+    std::vector<char> removed(num_verts, false);
+    std::priority_queue<Collapse> queue;
+
+    auto add_collapse = [&](const GLushort from, const GLushort to)
+    {
+        if(locked[from])
+            return;
+
+        Quadric q = quadrics[from];
+        q += quadrics[to];
+        double cost = q.error(glm::dvec3(coords[to]));
+
+        if(cost <= max_error_sq)
+            queue.push({cost, from, to, version[from], version[to]});
+    };
+
+    for(auto e: edges)
+    {
+        add_collapse(e >> 16, e & 0xFFFF);
+        add_collapse(e & 0xFFFF, e >> 16);
+    }
+
+    // other verticies of the living triangles around v, sorted
+    auto neighbors = [&](const GLushort v, std::vector<GLushort> & out)
+    {
+        out.clear();
+        for(auto t: vert_tris[v])
+        {
+            if(!tri_alive[t])
+                continue;
+            for(auto w: tris[t])
+            {
+                if(w != v)
+                    out.push_back(w);
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    auto contains = [](const Triangle & t, const GLushort v)
+    {
+        return t[0] == v || t[1] == v || t[2] == v;
+    };
+
+    // check that moving from onto to doesn't flip or badly distort any remaining triangles
+    auto distorts = [&](const GLushort from, const GLushort to)
+    {
+        for(auto t: vert_tris[from])
+        {
+            if(!tri_alive[t] || contains(tris[t], to))
+                continue;
+
+            glm::dvec3 old_pts[3], new_pts[3];
+            for(int i = 0; i < 3; ++i)
+            {
+                old_pts[i] = glm::dvec3(coords[tris[t][i]]);
+                new_pts[i] = glm::dvec3(coords[tris[t][i] == from ? to : tris[t][i]]);
+            }
+
+            glm::dvec3 old_n = glm::cross(old_pts[1] - old_pts[0], old_pts[2] - old_pts[0]);
+            glm::dvec3 new_n = glm::cross(new_pts[1] - new_pts[0], new_pts[2] - new_pts[0]);
+
+            if(glm::dot(old_n, new_n) <= min_cos * glm::length(old_n) * glm::length(new_n))
+                return true;
+        }
+        return false;
+    };
+
+    size_t num_tris = tris.size();
+    std::vector<GLushort> from_neighbors, to_neighbors, common;
+
+    while(!queue.empty() && num_tris > target_triangles)
+    {
+        Collapse c = queue.top();
+        queue.pop();
+
+        if(removed[c.from] || removed[c.to] || c.from_version != version[c.from] || c.to_version != version[c.to])
+            continue;
+
+        neighbors(c.from, from_neighbors);
+        if(!std::binary_search(from_neighbors.begin(), from_neighbors.end(), c.to))
+            continue;
+
+        // the edge's 2 triangles must be the only ones shared by both ends,
+        // otherwise the collapse would pinch the surface
+        neighbors(c.to, to_neighbors);
+        common.clear();
+        std::set_intersection(from_neighbors.begin(), from_neighbors.end(),
+            to_neighbors.begin(), to_neighbors.end(), std::back_inserter(common));
+        if(common.size() != 2)
+            continue;
+
+        if(from_neighbors.size() + to_neighbors.size() - 4 > max_valence)
+            continue;
+
+        if(distorts(c.from, c.to))
+            continue;
+
+        // remove triangles on the edge, and move the rest over to c.to
+        for(auto t: vert_tris[c.from])
+        {
+            if(!tri_alive[t])
+                continue;
+
+            if(contains(tris[t], c.to))
+            {
+                tri_alive[t] = false;
+                --num_tris;
+            }
+            else
+            {
+                std::replace(tris[t].begin(), tris[t].end(), c.from, c.to);
+                vert_tris[c.to].push_back(t);
+            }
+        }
+        vert_tris[c.from].clear();
+        removed[c.from] = true;
+
+        auto & to_tris = vert_tris[c.to];
+        to_tris.erase(std::remove_if(to_tris.begin(), to_tris.end(),
+            [&tri_alive](const size_t t){ return !tri_alive[t]; }), to_tris.end());
+
+        // only costs of edges touching c.to have changed
+        quadrics[c.to] += quadrics[c.from];
+        ++version[c.to];
+
+        neighbors(c.to, to_neighbors);
+        for(auto w: to_neighbors)
+        {
+            add_collapse(c.to, w);
+            add_collapse(w, c.to);
+        }
+    }
+
+    // keep the remaining triangles, in their original order
+    size_t out = 0;
+    for(size_t t = 0; t < tris.size(); ++t)
+    {
+        if(tri_alive[t])
+            tris[out++] = tris[t];
+    }
+    tris.resize(out);
+}
+
+// simplify a graph's surface by collapsing edges, using quadric error metrics
+void decimate_mesh(Mesh_data & mesh, const float max_error, const size_t target_triangles,
+    const std::atomic<bool> & cancelled)
+{
+    if(mesh.index_mode != GL_TRIANGLE_STRIP)
+        return;
+
+    // scale error to the size of the graph
+    glm::vec3 min_pt(std::numeric_limits<float>::max()), max_pt(std::numeric_limits<float>::lowest());
+    for(size_t i = 0; i < mesh.coords.size(); ++i)
+    {
+        if(mesh.defined.get(i / mesh.num_columns, i % mesh.num_columns))
+        {
+            min_pt = glm::min(min_pt, mesh.coords[i]);
+            max_pt = glm::max(max_pt, mesh.coords[i]);
+        }
+    }
+    double max_error_sq = max_error * glm::length(glm::dvec3(max_pt - min_pt));
+    max_error_sq *= max_error_sq;
+
+    // gather up each chunk's triangles
+    std::map<GLint, size_t> chunk_nums;
+    std::vector<GLint> base_verts;
+    std::vector<std::vector<Triangle>> chunk_tris;
+    size_t num_tris = 0;
+
+    for(const auto & chunk: mesh.chunks)
+    {
+        auto chunk_num = chunk_nums.emplace(chunk.base_vertex, base_verts.size());
+        if(chunk_num.second)
+        {
+            base_verts.push_back(chunk.base_vertex);
+            chunk_tris.emplace_back();
+        }
+
+        auto & tris = chunk_tris[chunk_num.first->second];
+        size_t prev_size = tris.size();
+        strip_triangles(mesh.index.data() + chunk.index_begin, chunk.index_count, tris);
+        num_tris += tris.size() - prev_size;
+    }
+
+    // chunks don't share any triangles, so they can be simplified in parallel
+    // the target is split between them according to their size
+    Thread_pool::get().parallel_for(0, chunk_tris.size(), [&](const size_t i)
+    {
+        if(cancelled)
+            return;
+
+        size_t chunk_target = target_triangles == 0 ? 0 :
+            (target_triangles * chunk_tris[i].size() + num_tris - 1) / num_tris;
+
+        decimate_chunk(mesh.coords.data() + base_verts[i], chunk_tris[i], max_error_sq, chunk_target);
+    });
+
+    // replace strips with triangle lists
+    mesh.index.clear();
+    mesh.chunks.clear();
+    for(size_t i = 0; i < chunk_tris.size(); ++i)
+    {
+        mesh.chunks.push_back({base_verts[i], mesh.index.size(), 3 * chunk_tris[i].size()});
+        for(const auto & t: chunk_tris[i])
+            mesh.index.insert(mesh.index.end(), t.begin(), t.end());
+    }
+    mesh.index_mode = GL_TRIANGLES;
+    // the strips were measured, not the triangles drawn now
+    mesh.chunk_cache_stats.clear();
+}
@@ -0,0 +1,43 @@
+// decimate.hpp
+// quadric error mesh simplification
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <atomic>
+
+#include "graph.hpp"
+
+// simplify a graph's surface by collapsing edges, using quadric error metrics
+// replaces mesh's triangle strips with a triangle list (index_mode is set to GL_TRIANGLES)
+// verticies are never moved or removed, only dropped from the index, so the
+// vertex data (and an implicit grid) stays valid. grid and normal lines are unchanged.
+// each chunk is simplified on its own, and verticies on the edge of a chunk,
+// or on any other boundary (the edge of the graph, undefined regions, seams) are kept,
+// so chunks still meet without cracks.
+// stops once max_error is reached, and once there are target_triangles left, if not 0
+// max_error is a fraction of the size of the graph's bounding box
+// once cancelled is set, chunks not yet started are left as they are
+void decimate_mesh(Mesh_data & mesh, const float max_error, const size_t target_triangles,
+    const std::atomic<bool> & cancelled);
+
+#endif // DECIMATE_H
@@ -0,0 +1,154 @@
+// defined_mask.cpp
+// packed flags for which points of a graph are defined
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+
+#include "defined_mask.hpp"
+
+Defined_mask::Defined_mask(const size_t num_rows, const size_t num_columns):
+    _num_rows(num_rows), _num_columns(num_columns),
+    _words_per_row((num_columns + word_bits - 1) / word_bits),
+    _words(num_rows * _words_per_row, 0)
+{}
+
+// set a row from an array of byte flags
+void Defined_mask::set_row(const size_t row, const char * flags)
+{
+    Word * words = this->row(row);
+
+    for(size_t w = 0; w < _words_per_row; ++w)
+    {
+        size_t begin = w * word_bits;
+        size_t end = std::min(begin + word_bits, _num_columns);
+
+        Word word = 0;
+        for(size_t i = begin; i < end; ++i)
+            word |= Word(flags[i] != 0) << (i - begin);
+
+        words[w] = word;
+    }
+}
+
+// add rows from another mask with the same number of columns onto the end
+void Defined_mask::append(const Defined_mask & other)
+{
+    if(_words_per_row == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    // rows are word aligned, so we can just copy them on
+    _words.insert(_words.end(), other._words.begin(), other._words.end());
+    _num_rows += other._num_rows;
+}
+
+// hash of the flags, continuing on from seed
+uint64_t Defined_mask::hash(const uint64_t seed) const
+{
+    return hash_rows(0, _num_rows, seed);
+}
+
+// hash of the flags for rows [row_begin, row_end)
+uint64_t Defined_mask::hash_rows(const size_t row_begin, const size_t row_end, const uint64_t seed) const
+{
+    uint64_t h = seed;
+    for(size_t i = row_begin * _words_per_row; i < row_end * _words_per_row; ++i)
+    {
+        h = (h ^ _words[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// index of the first bit in [begin, end) that is equal to value, or end if none are
+size_t Defined_mask::find(const Word * words, const size_t begin, const size_t end, const bool value)
+{
+    size_t i = begin;
+    while(i < end)
+    {
+        // flip so that we're always looking for a set bit, and mask off bits before i
+        Word word = value ? words[i / word_bits] : ~words[i / word_bits];
+        word &= ~Word(0) << (i % word_bits);
+
+        if(word)
+            return std::min(end, (i / word_bits) * word_bits + __builtin_ctzll(word));
+
+        i = (i / word_bits + 1) * word_bits;
+    }
+    return end;
+}
+
+// check each value for undefined / infinity (anything not normal or zero)
+// checks the exponent and mantissa bits directly:
+// exponent all 1s is inf / NaN, exponent 0 with a non-zero mantissa is subnormal
+void classify_defined(const double * vals, const size_t count, char * out)
+{
+    const uint64_t exp_mask = 0x7FF0000000000000ull;
+    const uint64_t mant_mask = 0x000FFFFFFFFFFFFFull;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &vals[i], sizeof(bits));
+
+        uint64_t exp = bits & exp_mask;
+        uint64_t mant = bits & mant_mask;
+
+        out[i] = (exp != exp_mask) & ((exp != 0) | (mant == 0));
+    }
+}
+
+void classify_defined(const float * vals, const size_t count, char * out)
+{
+    const uint32_t exp_mask = 0x7F800000u;
+    const uint32_t mant_mask = 0x007FFFFFu;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &vals[i], sizeof(bits));
+
+        uint32_t exp = bits & exp_mask;
+        uint32_t mant = bits & mant_mask;
+
+        out[i] = (exp != exp_mask) & ((exp != 0) | (mant == 0));
+    }
+}
+
+// a vec3 is defined when all of its components are
+void classify_defined(const glm::vec3 * vals, const size_t count, char * out)
+{
+    const size_t batch_size = 256;
+    char components[batch_size * 3];
+
+    for(size_t batch = 0; batch < count; batch += batch_size)
+    {
+        size_t size = std::min(batch_size, count - batch);
+
+        classify_defined(&vals[batch].x, size * 3, components);
+
+        for(size_t i = 0; i < size; ++i)
+            out[batch + i] = components[i * 3] & components[i * 3 + 1] & components[i * 3 + 2];
+    }
+}
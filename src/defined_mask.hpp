@@ -0,0 +1,94 @@
+// defined_mask.hpp
+// packed flags for which points of a graph are defined
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DEFINED_MASK_H
+#define DEFINED_MASK_H
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// grid of bits, one per point, set when the point is defined
+// each row starts on a new word, so threads can write to different rows at once
+class Defined_mask
+{
+public:
+    typedef uint64_t Word;
+    static const size_t word_bits = 64;
+
+    Defined_mask() = default;
+    Defined_mask(const size_t num_rows, const size_t num_columns);
+
+    size_t num_rows() const { return _num_rows; }
+    size_t num_columns() const { return _num_columns; }
+    size_t words_per_row() const { return _words_per_row; }
+
+    bool get(const size_t row, const size_t column) const
+    {
+        return (_words[row * _words_per_row + column / word_bits] >> (column % word_bits)) & 1;
+    }
+
+    void set(const size_t row, const size_t column, const bool value)
+    {
+        Word & w = _words[row * _words_per_row + column / word_bits];
+        Word bit = Word(1) << (column % word_bits);
+        w = value ? (w | bit) : (w & ~bit);
+    }
+
+    // raw access to a row's words. bits past the last column are always 0
+    Word * row(const size_t row) { return &_words[row * _words_per_row]; }
+    const Word * row(const size_t row) const { return &_words[row * _words_per_row]; }
+
+    // set a row from an array of byte flags
+    void set_row(const size_t row, const char * flags);
+
+    // add rows from another mask with the same number of columns onto the end
+    void append(const Defined_mask & other);
+
+    // hash of the flags, continuing on from seed
+    // hashing each tile of a graph in order gives the same result as hashing the whole graph
+    static const uint64_t hash_seed = 14695981039346656037ull;
+    uint64_t hash(const uint64_t seed = hash_seed) const;
+    // hash of the flags for rows [row_begin, row_end)
+    uint64_t hash_rows(const size_t row_begin, const size_t row_end, const uint64_t seed = hash_seed) const;
+
+    // index of the first bit in [begin, end) that is equal to value, or end if none are
+    static size_t find(const Word * words, const size_t begin, const size_t end, const bool value);
+
+private:
+    size_t _num_rows = 0;
+    size_t _num_columns = 0;
+    size_t _words_per_row = 0;
+    std::vector<Word> _words;
+};
+
+// check each value for undefined / infinity (anything not normal or zero)
+// out[i] is set to 1 for defined values and 0 otherwise
+// works on the bits directly, so it can be vectorized
+void classify_defined(const double * vals, const size_t count, char * out);
+void classify_defined(const float * vals, const size_t count, char * out);
+// a vec3 is defined when all of its components are
+void classify_defined(const glm::vec3 * vals, const size_t count, char * out);
+
+#endif // DEFINED_MASK_H
@@ -20,18 +20,28 @@
 // IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include "gl_helpers.hpp"
+#include "decimate.hpp"
 #include "graph.hpp"
+#include "packed_vertex.hpp"
+#include "parallel.hpp"
 
 Graph::Graph():
     use_tex(false), valid_tex(false), color(1.0f, 1.0f, 1.0f), transparency(0.5),
     shininess(50.0f), specular(1.0f), grid_color(0.1f, 0.1f, 0.1f), normal_color(0.0f, 1.0f, 1.0f),
+    contour_color(0.9f, 0.9f, 0.9f), normal_length(0.1f),
     draw_flag(true), transparent_flag(false), draw_normals_flag(false), draw_grid_flag(true),
-    _tex(0), _vao(0), _vbo(0), _ebo(0), _num_indexes(0),
-    _grid_vao(0), _grid_ebo(0), _grid_num_indexes(0),
-    _normal_vao(0), _normal_vbo(0), _normal_num_indexes(0)
+    draw_contours_flag(false), shader_grid_flag(false), grid_density(10.0f), grid_width(2.0f),
+    optimize_index_order(true),
+    _height_field(false),
+    _tex(0), _normal_map(0),
+    _bake_seconds(0.0), _cancelled(false),
+    _param_grid(false),
+    _contour_vao(0), _contour_vbo(0), _contour_num_verts(0)
 {}
 
 Graph::~Graph()
@@ -39,56 +49,150 @@ Graph::~Graph()
     // free OpenGL resources
     if(_tex)
         glDeleteTextures(1, &_tex);
+    if(_normal_map)
+        glDeleteTextures(1, &_normal_map);
 
-    if(_vao)
-        glDeleteVertexArrays(1, &_vao);
-    if(_vbo)
-        glDeleteBuffers(1, &_vbo);
-    if(_ebo)
-        glDeleteBuffers(1, &_ebo);
+    free_graph_geometry();
 
-    if(_grid_vao)
-        glDeleteVertexArrays(1, &_grid_vao);
-    if(_grid_ebo)
-        glDeleteBuffers(1, &_grid_ebo);
-
-    if(_normal_vao)
-        glDeleteVertexArrays(1, &_normal_vao);
-    if(_normal_vbo)
-        glDeleteBuffers(1, &_normal_vbo);
+    if(_contour_vao)
+        glDeleteVertexArrays(1, &_contour_vao);
+    if(_contour_vbo)
+        glDeleteBuffers(1, &_contour_vbo);
 }
 
 // draw graph geometry
-void Graph::draw() const
+void Graph::draw(const Implicit_grid_setup & grid_setup) const
 {
-    glBindVertexArray(_vao);
+    // the normal map goes on texture unit 1
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, _normal_map);
+    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, _tex);
 
-    glDrawElements(GL_TRIANGLE_STRIP, _num_indexes, GL_UNSIGNED_INT, NULL);
+    for(const auto & section: _sections)
+    {
+        // skip sections left unfinished by an error
+        if(!section.index_buffers)
+            continue;
+
+        Implicit_grid grid = _implicit_grid;
+        grid.first_row = section.row_begin;
+        grid_setup(grid);
+
+        glBindVertexArray(section.vao);
+
+        for(const auto & chunk: section.index_buffers->chunks)
+            glDrawElementsBaseVertex(section.index_buffers->mode, chunk.index_count, GL_UNSIGNED_SHORT,
+                (const GLvoid *)(sizeof(GLushort) * chunk.index_begin), chunk.base_vertex);
+    }
 
     glBindVertexArray(0);
 }
 
 // draw gridlines
-void Graph::draw_grid() const
+void Graph::draw_grid(const Implicit_grid_setup & grid_setup) const
 {
-    glBindVertexArray(_grid_vao);
+    for(const auto & section: _sections)
+    {
+        // graphs built for shader gridlines have none
+        if(!section.index_buffers || !section.grid_vao)
+            continue;
 
-    glDrawElements(GL_LINE_STRIP, _grid_num_indexes, GL_UNSIGNED_INT, NULL);
+        Implicit_grid grid = _implicit_grid;
+        grid.first_row = section.row_begin;
+        grid_setup(grid);
+
+        glBindVertexArray(section.grid_vao);
+
+        for(const auto & chunk: section.index_buffers->grid_chunks)
+            glDrawElementsBaseVertex(GL_LINE_STRIP, chunk.index_count, GL_UNSIGNED_SHORT,
+                (const GLvoid *)(sizeof(GLushort) * chunk.index_begin), chunk.base_vertex);
+    }
 
     glBindVertexArray(0);
 }
 
 // draw normals
-void Graph::draw_normals() const
+// the surface's indexes are drawn as points, for a geometry shader that turns each into a line.
+// only defined verticies are indexed, but most are indexed more than once, so lines are drawn over
+void Graph::draw_normals(const Implicit_grid_setup & grid_setup) const
 {
-    glBindVertexArray(_normal_vao);
+    for(const auto & section: _sections)
+    {
+        if(!section.index_buffers)
+            continue;
+
+        Implicit_grid grid = _implicit_grid;
+        grid.first_row = section.row_begin;
+        grid_setup(grid);
+
+        glBindVertexArray(section.vao);
 
-    glDrawArrays(GL_LINES, 0, _normal_num_indexes);
+        for(const auto & chunk: section.index_buffers->chunks)
+            glDrawElementsBaseVertex(GL_POINTS, chunk.index_count, GL_UNSIGNED_SHORT,
+                (const GLvoid *)(sizeof(GLushort) * chunk.index_begin), chunk.base_vertex);
+    }
 
     glBindVertexArray(0);
 }
 
+// check if a box reaches both sides of a plane
+static bool box_crosses_plane(const Graph_bvh::Box & box, const glm::vec3 & normal, const float offset)
+{
+    if(box.empty())
+        return false;
+
+    glm::vec3 center = 0.5f * (box.min + box.max);
+    glm::vec3 extent = 0.5f * (box.max - box.min);
+
+    return std::abs(glm::dot(normal, center) - offset) <= glm::dot(glm::abs(normal), extent);
+}
+
+// draw the graph's triangles that may cross a plane
+void Graph::draw_slice(const glm::vec3 & normal, const float offset, const Implicit_grid_setup & grid_setup) const
+{
+    for(const auto & section: _sections)
+    {
+        if(!section.index_buffers)
+            continue;
+
+        bool section_bound = false;
+        const auto & chunks = section.index_buffers->chunks;
+        for(size_t i = 0; i < chunks.size(); ++i)
+        {
+            // skip chunks entirely on one side
+            if(i < section.chunk_bounds.size() && !box_crosses_plane(section.chunk_bounds[i], normal, offset))
+                continue;
+
+            if(!section_bound)
+            {
+                Implicit_grid grid = _implicit_grid;
+                grid.first_row = section.row_begin;
+                grid_setup(grid);
+
+                glBindVertexArray(section.vao);
+                section_bound = true;
+            }
+
+            glDrawElementsBaseVertex(section.index_buffers->mode, chunks[i].index_count, GL_UNSIGNED_SHORT,
+                (const GLvoid *)(sizeof(GLushort) * chunks[i].index_begin), chunks[i].base_vertex);
+        }
+    }
+
+    glBindVertexArray(0);
+}
+
+// draw contour lines
+void Graph::draw_contours() const
+{
+    if(!_contour_vao)
+        return;
+
+    glBindVertexArray(_contour_vao);
+    glDrawArrays(GL_LINES, 0, _contour_num_verts);
+    glBindVertexArray(0);
+}
+
 // change texture given a filename
 // deletes texture when empty filename is given
 void Graph::set_texture(const std::string & filename)
@@ -109,205 +213,1174 @@ void Graph::set_texture(const std::string & filename)
     valid_tex = true;
 }
 
+// calculate graph geometry and build OpenGL objects from it
+// tiles are uploaded as they are finished. needs OpenGL to be initialized
+void Graph::build()
+{
+    // decimation and ambient occlusion need the whole graph at once
+    if(decimation.enabled || ambient_occlusion.enabled)
+    {
+        upload(build_mesh());
+    }
+    else
+    {
+        Geometry_upload upload;
+
+        build_graph([this, &upload](Mesh_data & tile)
+        {
+            if(tile.row_begin == 0)
+                begin_graph_geometry(upload, tile.num_rows, tile.num_columns);
+
+            upload_graph_tile(upload, tile);
+        });
+
+        end_graph_geometry(upload);
+        find_chunk_bounds();
+        upload_contours();
+
+        // sampled separately, at its own resolution
+        build_normal_map();
+    }
+}
+
+// calculate graph geometry without creating any OpenGL objects
+Mesh_data Graph::build_mesh()
+{
+    Mesh_data mesh;
+
+    build_graph([&mesh](Mesh_data & tile)
+    {
+        mesh.append(std::move(tile));
+    });
+
+    if(decimation.enabled)
+        decimate_mesh(mesh, decimation.max_error, decimation.target_triangles, _cancelled);
+
+    // verticies are never moved by decimation, so this can come after
+    _bake_seconds = 0.0;
+    if(ambient_occlusion.enabled)
+        bake_ambient_occlusion(mesh);
+
+    return mesh;
+}
+
+// build OpenGL objects from previously calculated geometry
+void Graph::upload(const Mesh_data & mesh)
+{
+    Geometry_upload upload;
+
+    begin_graph_geometry(upload, mesh.num_rows, mesh.num_columns);
+    upload_graph_tile(upload, mesh);
+    end_graph_geometry(upload);
+    find_chunk_bounds();
+    upload_contours();
+
+    // sampled separately, at its own resolution
+    build_normal_map();
+}
+
+// pass on a whole graph whose vertices aren't a grid of the column and row variables
+void Graph::sink_unstructured_mesh(Mesh_data & mesh, const Tile_sink & sink)
+{
+    _param_grid = false;
+    _implicit_grid.line_step = glm::vec2(0.0f);
+    _contours.clear();
+
+    _bvh.begin(mesh.num_rows, mesh.num_columns);
+    if(mesh.row_end > mesh.row_begin)
+        _bvh.add_rows(mesh.row_begin, mesh.row_end, mesh.coords.data(), mesh.defined);
+    _bvh.end();
+
+    // the verticies are still measured, from the triangles that join them
+    _measure.set_triangles(mesh.coords.data(), mesh.index, mesh.chunks);
+
+    sink(mesh);
+}
+
+// true for height field graphs, which can have contour lines
+bool Graph::has_contours() const
+{
+    return _height_field;
+}
+
+// set the heights to draw contour lines at
+void Graph::set_contour_levels(const std::vector<float> & levels)
+{
+    _contours.set_levels(levels);
+    upload_contours();
+}
+
+// re-evaluate the points of a bvh leaf, rather than keeping a copy of the whole graph around
+void Graph::eval_leaf(const Graph_bvh::Leaf & leaf, std::vector<glm::vec3> & pts, std::vector<char> & defined)
+{
+    const size_t num_rows = leaf.row_end - leaf.row_begin;
+    const size_t num_columns = leaf.col_end - leaf.col_begin;
+
+    pts.resize(num_rows * num_columns);
+    defined.resize(num_rows * num_columns);
+
+    for(size_t row = 0; row < num_rows; ++row)
+    {
+        for(size_t col = 0; col < num_columns; ++col)
+        {
+            size_t i = row * num_columns + col;
+            glm::dvec2 param = _param_origin + _param_step * glm::dvec2(leaf.col_begin + col, leaf.row_begin + row);
+            glm::dvec3 pos;
+            defined[i] = eval_point(param.x, param.y, pos);
+            pts[i] = glm::vec3(pos);
+        }
+    }
+}
+
+// find the nearest point where a ray hits the graph
+bool Graph::intersect(const glm::vec3 & origin, const glm::vec3 & dir, Ray_hit & hit)
+{
+    // column, row of the nearest hit on the sampled surface, and its distance
+    glm::dvec2 grid_pos;
+    float nearest = std::numeric_limits<float>::infinity();
+
+    auto param = [this](const glm::dvec2 & grid_pos)
+    {
+        return _param_origin + _param_step * grid_pos;
+    };
+
+    // the bvh's rows and columns have to be a grid of the column and row variables to refine the hit
+    if(!_param_grid)
+        return false;
+
+    std::vector<glm::vec3> pts;
+    std::vector<char> defined;
+
+    _bvh.intersect(origin, dir, [&](const Graph_bvh::Leaf & leaf)
+    {
+        const size_t num_rows = leaf.row_end - leaf.row_begin;
+        const size_t num_columns = leaf.col_end - leaf.col_begin;
+
+        eval_leaf(leaf, pts, defined);
+
+        for(size_t row = 0; row + 1 < num_rows; ++row)
+        {
+            for(size_t col = 0; col + 1 < num_columns; ++col)
+            {
+                for(const auto & tri: Graph_bvh::quad_triangles)
+                {
+                    size_t i[3];
+                    bool tri_defined = true;
+                    for(int j = 0; j < 3; ++j)
+                    {
+                        i[j] = (row + tri[j].y) * num_columns + col + tri[j].x;
+                        tri_defined &= (bool)defined[i[j]];
+                    }
+
+                    if(!tri_defined)
+                        continue;
+
+                    glm::vec2 bary;
+                    float dist = intersect_triangle(origin, dir, pts[i[0]], pts[i[1]], pts[i[2]], bary);
+                    if(dist < nearest)
+                    {
+                        nearest = dist;
+                        glm::dvec2 corner(leaf.col_begin + col, leaf.row_begin + row);
+                        grid_pos = corner + glm::dvec2(tri[0])
+                            + (double)bary.x * glm::dvec2(glm::ivec2(tri[1]) - glm::ivec2(tri[0]))
+                            + (double)bary.y * glm::dvec2(glm::ivec2(tri[2]) - glm::ivec2(tri[0]));
+                    }
+                }
+            }
+        }
+
+        return nearest;
+    });
+
+    if(nearest == std::numeric_limits<float>::infinity())
+        return false;
+
+    // the sampled surface is only an approximation. refine the hit with Newton's method,
+    // solving surface(col, row) = origin + dist * dir for col, row, and dist.
+    // partial derivatives are found by finite differences
+    const int max_iterations = 8;
+    // in columns, rows
+    const double h = 1e-3;
+    const double tolerance = 1e-4;
+
+    glm::dvec2 refined_pos = grid_pos;
+    double refined_dist = nearest;
+    bool converged = false;
+
+    for(int iteration = 0; iteration < max_iterations && !converged; ++iteration)
+    {
+        glm::dvec3 pos, pos_col, pos_row;
+        glm::dvec2 p = param(refined_pos);
+        glm::dvec2 p_off = param(refined_pos + h);
+
+        if(!eval_point(p.x, p.y, pos) || !eval_point(p_off.x, p.y, pos_col) || !eval_point(p.x, p_off.y, pos_row))
+            break;
+
+        glm::dvec3 error = pos - glm::dvec3(origin) - refined_dist * glm::dvec3(dir);
+        glm::dmat3 jacobian((pos_col - pos) / h, (pos_row - pos) / h, -glm::dvec3(dir));
+
+        if(std::abs(glm::determinant(jacobian)) < 1e-12)
+            break;
+
+        glm::dvec3 step = glm::inverse(jacobian) * error;
+        refined_pos -= glm::dvec2(step);
+        refined_dist -= step.z;
+
+        converged = glm::length(glm::dvec2(step)) < tolerance;
+    }
+
+    // only keep the refined hit if it's near the one on the sampled surface, and on the graph
+    glm::dvec2 max_pos(_bvh.num_columns() - 1, _bvh.num_rows() - 1);
+    glm::dvec3 pos;
+    glm::dvec2 p = param(refined_pos);
+
+    if(converged && refined_dist >= 0.0
+        && glm::all(glm::lessThanEqual(glm::abs(refined_pos - grid_pos), glm::dvec2(1.0)))
+        && glm::all(glm::greaterThanEqual(refined_pos, glm::dvec2(0.0)))
+        && glm::all(glm::lessThanEqual(refined_pos, max_pos))
+        && eval_point(p.x, p.y, pos))
+    {
+        grid_pos = refined_pos;
+        nearest = refined_dist;
+    }
+
+    hit.dist = nearest;
+    hit.col_param = param(grid_pos).x;
+    hit.row_param = param(grid_pos).y;
+    return true;
+}
+
+const Graph::Implicit_grid & Graph::implicit_grid() const
+{
+    return _implicit_grid;
+}
+
 sigc::signal<void, const std::string &> Graph::signal_cursor_moved()
 {
     return _signal_cursor_moved;
 }
 
-// helper function to build OpenGL objects from verticies
-void Graph::build_graph_geometry(size_t num_rows, size_t num_columns,
-    const std::vector<glm::vec3> & coords,
-    const std::vector<glm::vec2> & tex_coords,
-    const std::vector<glm::vec3> & normals,
-    const std::vector<bool> & defined)
+sigc::signal<void, float> Graph::signal_bake_progress()
+{
+    return _signal_bake_progress;
+}
+
+double Graph::bake_seconds() const
+{
+    return _bake_seconds;
+}
+
+void Graph::cancel()
+{
+    _cancelled = true;
+}
+
+std::vector<Graph::Section_stats> Graph::section_stats() const
+{
+    std::vector<Section_stats> stats;
+    for(const auto & section: _sections)
+    {
+        stats.push_back(Section_stats{section.row_begin, section.row_end,
+            section.vertex_bytes, section.index_bytes, section.shared_indexes, section.build_seconds,
+            section.cache_stats});
+    }
+    return stats;
+}
+
+// add chunks for indexes appended at offset, merging with the last chunk when they share a base vertex
+static void append_chunks(std::vector<Mesh_chunk> & chunks, const std::vector<Mesh_chunk> & new_chunks, const size_t offset)
+{
+    for(auto chunk: new_chunks)
+    {
+        chunk.index_begin += offset;
+
+        if(!chunks.empty() && chunks.back().base_vertex == chunk.base_vertex
+            && chunks.back().index_begin + chunks.back().index_count == chunk.index_begin)
+        {
+            chunks.back().index_count += chunk.index_count;
+        }
+        else
+            chunks.push_back(chunk);
+    }
+}
+
+// add the next tile onto the end of this one
+void Mesh_data::append(Mesh_data && tile)
+{
+    if(coords.empty())
+    {
+        *this = std::move(tile);
+        return;
+    }
+
+    row_end = tile.row_end;
+
+    coords.insert(coords.end(), tile.coords.begin(), tile.coords.end());
+    tex_coords.insert(tex_coords.end(), tile.tex_coords.begin(), tile.tex_coords.end());
+    normals.insert(normals.end(), tile.normals.begin(), tile.normals.end());
+    occlusion.insert(occlusion.end(), tile.occlusion.begin(), tile.occlusion.end());
+    defined.append(tile.defined);
+
+    append_chunks(chunks, tile.chunks, index.size());
+    index.insert(index.end(), tile.index.begin(), tile.index.end());
+    append_chunks(grid_chunks, tile.grid_chunks, grid_index.size());
+    grid_index.insert(grid_index.end(), tile.grid_index.begin(), tile.grid_index.end());
+    chunk_cache_stats.insert(chunk_cache_stats.end(), tile.chunk_cache_stats.begin(), tile.chunk_cache_stats.end());
+}
+
+// counts indexes without storing them, for sizing index arrays
+struct Index_counter
+{
+    size_t count = 0;
+    void push_back(const GLushort) { ++count; }
+};
+
+// writes indexes into a pre-sized array
+struct Index_writer
 {
-    std::vector<GLuint> index;
+    GLushort * out;
+    void push_back(const GLushort i) { *out++ = i; }
+};
+
+// arrange a pair of rows, from first_column to last_column, as a triangle strip
+// top & bot are the rows' defined flags, full_quads & tri_quads flag each quad
+// (between columns n and n + 1) having all 4, and at least 3 defined corners
+// indexes are relative to base, the first vertex of the row's chunk
+template<typename Index>
+static void strip_row(const size_t row, const size_t num_columns, const size_t base,
+    const size_t first_column, const size_t last_column,
+    const Defined_mask::Word * top, const Defined_mask::Word * bot,
+    const Defined_mask::Word * full_quads, const Defined_mask::Word * tri_quads,
+    Index & index)
+{
+    const size_t word_bits = Defined_mask::word_bits;
+
+    auto bit = [word_bits](const Defined_mask::Word * words, const size_t i) -> bool
+    {
+        return (words[i / word_bits] >> (i % word_bits)) & 1;
+    };
+
+    const size_t top_begin = row * num_columns - base;
+    const size_t bot_begin = top_begin + num_columns;
 
     bool break_flag = true;
 
-    // arrange verts as a triangle strip
-    for(size_t row = 0; row < num_rows - 1; ++row)
+    // close off a run of full quads at column, and restart the strip
+    auto break_strip = [&](const size_t column)
     {
-        for(size_t column = 0; column < num_columns - 1; ++column)
+        if(!break_flag)
         {
-            // 4 corner indexes
-            int ul = row * num_columns + column;
-            int ur = row * num_columns + column + 1;
-            int ll = (row + 1) * num_columns + column;
-            int lr = (row + 1) * num_columns + column + 1;
-
-            // draw appropriate triangles for defined verticies
-            if(defined[ul] && defined[ur] && defined[ll] && defined[lr])
-            {
-                index.push_back(ul);
-                index.push_back(ll);
-                break_flag = false;
-            }
-            else if(defined[ul] && defined[ur] && defined[ll])
-            {
-                index.push_back(ul);
-                index.push_back(ll);
-                index.push_back(ur);
-                index.push_back(0xFFFFFFFF);
-                break_flag = true;
-            }
-            else if(defined[ul] && defined[ur] && defined[lr])
-            {
-                if(!break_flag)
-                    index.push_back(0xFFFFFFFF);
-                index.push_back(ul);
-                index.push_back(lr);
-                index.push_back(ur);
-                index.push_back(0xFFFFFFFF);
-                break_flag = true;
-            }
-            else if(defined[ul] && defined[ll] && defined[lr])
-            {
-                index.push_back(ul);
-                index.push_back(ll);
-                index.push_back(lr);
-                index.push_back(0xFFFFFFFF);
-                break_flag = true;
-            }
-            else if(defined[ur] && defined[ll] && defined[lr])
-            {
-                if(!break_flag)
-                    index.push_back(0xFFFFFFFF);
-                index.push_back(ur);
-                index.push_back(ll);
-                index.push_back(lr);
-                index.push_back(0xFFFFFFFF);
-                break_flag = true;
-            }
-            else
+            index.push_back(top_begin + column);
+            index.push_back(bot_begin + column);
+            index.push_back(restart_index);
+        }
+        break_flag = true;
+    };
+
+    size_t column = first_column;
+    while(column < last_column)
+    {
+        // 4 corner indexes
+        GLushort ul = top_begin + column;
+        GLushort ur = top_begin + column + 1;
+        GLushort ll = bot_begin + column;
+        GLushort lr = bot_begin + column + 1;
+
+        if(bit(full_quads, column))
+        {
+            // a run of fully defined quads continues the strip
+            size_t run_end = Defined_mask::find(full_quads, column, last_column, false);
+            for(; column < run_end; ++column)
             {
-                if(!break_flag)
-                    index.push_back(0xFFFFFFFF);
-                break_flag = true;
+                index.push_back(top_begin + column);
+                index.push_back(bot_begin + column);
             }
+            break_flag = false;
+            continue;
         }
 
-        // finish row
-        int ul = row * num_columns + num_columns - 1;
-        int ll = (row + 1) * num_columns + num_columns - 1;
+        if(!bit(tri_quads, column))
+        {
+            // a run of quads without enough points for a triangle breaks the strip
+            break_strip(column);
+
+            column = Defined_mask::find(tri_quads, column, last_column, true);
+            continue;
+        }
+
+        bool ul_def = bit(top, column);
+        bool ur_def = bit(top, column + 1);
+        bool ll_def = bit(bot, column);
 
-        if(!break_flag && defined[ul] && defined[ll])
+        // draw appropriate triangle for the 3 defined verticies
+        // triangles starting with ul, ll can continue a strip, others need to break it first
+        if(ul_def && ur_def && ll_def)
         {
             index.push_back(ul);
             index.push_back(ll);
+            index.push_back(ur);
+            index.push_back(restart_index);
+        }
+        else if(ul_def && ur_def)
+        {
+            break_strip(column);
+            index.push_back(ul);
+            index.push_back(lr);
+            index.push_back(ur);
+            index.push_back(restart_index);
+        }
+        else if(ul_def)
+        {
+            index.push_back(ul);
+            index.push_back(ll);
+            index.push_back(lr);
+            index.push_back(restart_index);
+        }
+        else
+        {
+            break_strip(column);
+            index.push_back(ur);
+            index.push_back(ll);
+            index.push_back(lr);
+            index.push_back(restart_index);
         }
-
-        if(!break_flag)
-            index.push_back(0xFFFFFFFF);
         break_flag = true;
+        ++column;
     }
 
-    // generate required OpenGL structures
-    glGenVertexArrays(1, &_vao);
-    glBindVertexArray(_vao);
+    // finish row
+    break_strip(last_column);
+}
+
+// number of rows of verticies in each chunk
+// neighboring chunks share a row, so that strips between them can be drawn
+// all verticies in a chunk must be addressable by 16 bit indexes, minus the restart index
+size_t Graph::chunk_rows(const size_t num_columns)
+{
+    return std::max<size_t>(2, restart_index / num_columns);
+}
+
+// maximum number of verticies in each section's buffers, rounded down to whole chunks
+static const size_t section_vertices = 1 << 22;
+
+// number of columns in each block of strips, when optimizing the strip order
+// the top row of each block must still be in the vertex cache when it is drawn
+static const size_t strip_block_columns = 16;
+
+// arrange the quads of a tile into triangle strips
+// with block_columns > 0, strips are split into blocks of that many columns, and each block
+// is run down all of a chunk's rows before moving to the next block. a block's top row is
+// still in the post-transform vertex cache from the strip above it, so each vertex is
+// transformed about once, instead of about twice for strips that run the full width
+// all arrays are sized exactly before being filled: strips are counted in parallel,
+// then filled in parallel at offsets from the prefix sum of their counts
+static void index_strips(const Mesh_data & tile, const Defined_mask::Word * prev_row_defined,
+    const size_t chunk_strips, const size_t block_columns,
+    std::vector<GLushort> & index, std::vector<Mesh_chunk> & chunks)
+{
+    typedef Defined_mask::Word Word;
 
-    glGenBuffers(1, &_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size() +
-        sizeof(glm::vec3) * normals.size(), NULL, GL_STATIC_DRAW);
+    Thread_pool & pool = Thread_pool::get();
 
-    // store vertex data
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * coords.size(), coords.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size(), sizeof(glm::vec2) * tex_coords.size(), tex_coords.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size(),
-        sizeof(glm::vec3) * normals.size(), normals.data());
+    const size_t num_columns = tile.num_columns;
+    const size_t words_per_row = tile.defined.words_per_row();
+    const size_t word_bits = Defined_mask::word_bits;
 
-    glGenBuffers(1, &_ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * index.size(), index.data(), GL_STATIC_DRAW);
+    // look up a row of defined flags, including the row above this tile
+    auto row_defined = [&](const size_t row) -> const Word *
+    {
+        if(row < tile.row_begin)
+            return prev_row_defined;
+        else
+            return tile.defined.row(row - tile.row_begin);
+    };
+
+    // first tile starts at the top, all others join to the last row of the previous tile
+    const size_t first_row = tile.row_begin > 0 ? tile.row_begin - 1 : 0;
+    const size_t num_strips = tile.row_end - first_row - 1;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
+    // neighboring blocks share a column
+    const size_t block_quads = block_columns > 1 ? block_columns - 1 : std::max<size_t>(1, num_columns - 1);
+    const size_t num_blocks = std::max<size_t>(1, (num_columns - 1 + block_quads - 1) / block_quads);
+
+    // strip / block pairs, in the order they are drawn: by chunk, then block, then strip
+    struct Segment
+    {
+        size_t strip, block;
+    };
+    std::vector<Segment> segments;
+    segments.reserve(num_strips * num_blocks);
+
+    // position of each strip / block pair in segments
+    std::vector<size_t> order(num_strips * num_blocks);
+
+    for(size_t chunk_begin = 0; chunk_begin < num_strips;)
+    {
+        const size_t chunk = (first_row + chunk_begin) / chunk_strips;
+        const size_t chunk_end = std::min(num_strips, (chunk + 1) * chunk_strips - first_row);
+
+        for(size_t block = 0; block < num_blocks; ++block)
+        {
+            for(size_t strip = chunk_begin; strip < chunk_end; ++strip)
+            {
+                order[strip * num_blocks + block] = segments.size();
+                segments.push_back({strip, block});
+            }
+        }
+        chunk_begin = chunk_end;
+    }
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size()));
-    glEnableVertexAttribArray(1);
+    auto chunk_base = [&](const size_t strip) -> size_t
+    {
+        return (first_row + strip) / chunk_strips * chunk_strips * num_columns;
+    };
 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size()));
-    glEnableVertexAttribArray(2);
+    auto block_range = [&](const size_t block, size_t & first_column, size_t & last_column)
+    {
+        first_column = block * block_quads;
+        last_column = std::min(first_column + block_quads, num_columns - 1);
+    };
 
-    _num_indexes = index.size();
+    // flags for each quad in a row - bit n for the quad between columns n and n + 1
+    std::vector<Word> full_quads(num_strips * words_per_row), tri_quads(num_strips * words_per_row);
 
-    // generate grid lines
-    std::vector<GLuint> grid_index;
+    // offset of each segment's indexes
+    std::vector<size_t> offsets(segments.size() + 1, 0);
 
-    // horizontal pass
-    for(size_t i = 1; i < 10; ++i)
+    // count pass
+    pool.parallel_for(0, num_strips, [&](const size_t strip)
     {
-        for(size_t column = 0; column < num_columns; ++column)
+        const size_t row = first_row + strip;
+
+        // find quads with all 4 corners defined, and with at least 3 defined, a word at a time
+        const Word * top = row_defined(row);
+        const Word * bot = row_defined(row + 1);
+        Word * full = &full_quads[strip * words_per_row];
+        Word * tri = &tri_quads[strip * words_per_row];
+
+        for(size_t w = 0; w < words_per_row; ++w)
         {
-            GLuint ind = (int)((float)num_rows * (float)i / 10.0f) * num_columns + column;
-            if(defined[ind])
-                grid_index.push_back(ind);
-            else
-                grid_index.push_back(0xFFFFFFFF);
+            // shift the next column's flags into place
+            Word top_next = (top[w] >> 1) | (w + 1 < words_per_row ? top[w + 1] << (word_bits - 1) : 0);
+            Word bot_next = (bot[w] >> 1) | (w + 1 < words_per_row ? bot[w + 1] << (word_bits - 1) : 0);
+
+            full[w] = top[w] & top_next & bot[w] & bot_next;
+            tri[w] = (top[w] & top_next & (bot[w] | bot_next)) | (bot[w] & bot_next & (top[w] | top_next));
         }
-        grid_index.push_back(0xFFFFFFFF);
+
+        for(size_t block = 0; block < num_blocks; ++block)
+        {
+            size_t first_column, last_column;
+            block_range(block, first_column, last_column);
+
+            Index_counter counter;
+            strip_row(row, num_columns, chunk_base(strip), first_column, last_column, top, bot, full, tri, counter);
+            offsets[order[strip * num_blocks + block] + 1] = counter.count;
+        }
+    });
+
+    // group segments into chunks as we go
+    chunks.clear();
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        const GLint base = chunk_base(segments[i].strip);
+        if(chunks.empty() || chunks.back().base_vertex != base)
+            chunks.push_back({base, offsets[i], 0});
+
+        chunks.back().index_count += offsets[i + 1];
+        offsets[i + 1] += offsets[i];
     }
 
-    //vertical pass
-    for(size_t i = 1; i < 10; ++i)
+    // fill pass
+    index.resize(offsets[segments.size()]);
+    pool.parallel_for(0, num_strips, [&](const size_t strip)
     {
-        for(size_t row = 0; row < num_rows; ++row)
+        const size_t row = first_row + strip;
+
+        for(size_t block = 0; block < num_blocks; ++block)
         {
-            GLuint ind = row * num_columns + (int)((float)num_columns * (float)i / 10.0f);
-            if(defined[ind])
-                grid_index.push_back(ind);
-            else
-                grid_index.push_back(0xFFFFFFFF);
+            size_t first_column, last_column;
+            block_range(block, first_column, last_column);
+
+            Index_writer writer{index.data() + offsets[order[strip * num_blocks + block]]};
+            strip_row(row, num_columns, chunk_base(strip), first_column, last_column,
+                row_defined(row), row_defined(row + 1),
+                &full_quads[strip * words_per_row], &tri_quads[strip * words_per_row], writer);
+        }
+    });
+}
+
+void Vertex_cache_stats::add(const Vertex_cache_stats & other)
+{
+    num_triangles += other.num_triangles;
+    misses += other.misses;
+    row_misses += other.row_misses;
+}
+
+// count triangles and vertex cache misses for a chunk of triangle strips
+// simulates a FIFO post-transform cache of Vertex_cache_stats::cache_size entries, empty at the start
+// of the chunk. hits don't move a vertex in a FIFO cache, so it's still there if fewer than
+// cache_size misses have come since it was loaded
+static void measure_vertex_cache(const GLushort * index, const size_t count, size_t & num_triangles, size_t & num_misses)
+{
+    // the miss that last loaded each vertex, counting from 1. 0 if it hasn't been loaded
+    std::vector<size_t> loaded((size_t)std::numeric_limits<GLushort>::max() + 1, 0);
+    size_t strip_len = 0;
+
+    num_triangles = num_misses = 0;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(index[i] == restart_index)
+        {
+            strip_len = 0;
+            continue;
+        }
+
+        if(++strip_len >= 3)
+            ++num_triangles;
+
+        size_t & load = loaded[index[i]];
+        if(load == 0 || num_misses - load >= Vertex_cache_stats::cache_size)
+            load = ++num_misses;
+    }
+}
+
+// build index and grid data for a tile
+// prev_row_defined holds the defined flags for the last row of the previous tile
+// grid lines are only generated when grid_lines is set
+void Graph::index_graph_tile(Mesh_data & tile, std::vector<Defined_mask::Word> & prev_row_defined,
+    const bool optimize_order, const bool grid_lines)
+{
+    typedef Defined_mask::Word Word;
+
+    const size_t num_rows = tile.num_rows;
+    const size_t num_columns = tile.num_columns;
+    const size_t words_per_row = tile.defined.words_per_row();
+    const size_t word_bits = Defined_mask::word_bits;
+
+    // look up a row of defined flags, including the row above this tile
+    auto row_defined = [&](const size_t row) -> const Word *
+    {
+        if(row < tile.row_begin)
+            return prev_row_defined.data();
+        else
+            return tile.defined.row(row - tile.row_begin);
+    };
+
+    auto defined = [&](const size_t row, const size_t column) -> bool
+    {
+        return (row_defined(row)[column / word_bits] >> (column % word_bits)) & 1;
+    };
+
+    const size_t first_row = tile.row_begin > 0 ? tile.row_begin - 1 : 0;
+
+    // the strip between rows r and r + 1 is in chunk r / chunk_strips
+    const size_t chunk_strips = chunk_rows(num_columns) - 1;
+    const size_t num_chunks = std::max<size_t>(1, (num_rows - 1 + chunk_strips - 1) / chunk_strips);
+
+    auto chunk_base = [&](const size_t chunk) -> size_t
+    {
+        return chunk * chunk_strips * num_columns;
+    };
+
+    index_strips(tile, prev_row_defined.data(), chunk_strips, optimize_order ? strip_block_columns : 0,
+        tile.index, tile.chunks);
+
+    // measure the vertex cache use of the block order against full width strips, a chunk at a time
+    // both orders have one chunk for each chunk of rows, in the same order
+    tile.chunk_cache_stats.clear();
+    if(optimize_order)
+    {
+        std::vector<GLushort> row_index;
+        std::vector<Mesh_chunk> row_chunks;
+        index_strips(tile, prev_row_defined.data(), chunk_strips, 0, row_index, row_chunks);
+
+        tile.chunk_cache_stats.resize(tile.chunks.size());
+        Thread_pool::get().parallel_for(0, tile.chunks.size(), [&](const size_t i)
+        {
+            const Mesh_chunk & chunk = tile.chunks[i];
+            const Mesh_chunk & row_chunk = row_chunks[i];
+            Vertex_cache_stats & stats = tile.chunk_cache_stats[i].second;
+            size_t row_triangles;
+
+            tile.chunk_cache_stats[i].first = chunk.base_vertex;
+            measure_vertex_cache(tile.index.data() + chunk.index_begin, chunk.index_count, stats.num_triangles, stats.misses);
+            measure_vertex_cache(row_index.data() + row_chunk.index_begin, row_chunk.index_count, row_triangles, stats.row_misses);
+        });
+    }
+
+    // generate grid lines, grouped by chunk
+    // horizontal lines that fall in this tile, and vertical lines running through it
+    // with no lines, this leaves the grid index empty
+    std::vector<size_t> grid_rows;
+    std::vector<size_t> grid_columns;
+    if(grid_lines)
+    {
+        for(size_t i = 1; i < 10; ++i)
+        {
+            size_t row = (size_t)((float)num_rows * (float)i / 10.0f);
+            if(row >= tile.row_begin && row < tile.row_end)
+                grid_rows.push_back(row);
         }
-        grid_index.push_back(0xFFFFFFFF);
+
+        for(size_t i = 1; i < 10; ++i)
+            grid_columns.push_back((size_t)((float)num_columns * (float)i / 10.0f));
+    }
+
+    // rows are in the lowest numbered chunk that contains them
+    auto row_chunk = [&](const size_t row) -> size_t
+    {
+        return std::min(row / chunk_strips, num_chunks - 1);
+    };
+
+    // vertical lines are split at chunk boundaries, with the shared row in both segments
+    // segments are joined to the previous tile's
+    const size_t first_chunk = std::min(first_row / chunk_strips, num_chunks - 1);
+    const size_t last_chunk = row_chunk(tile.row_end - 1);
+
+    auto vert_range = [&](const size_t chunk, size_t & begin, size_t & end)
+    {
+        begin = std::max(first_row, chunk * chunk_strips);
+        end = std::min(tile.row_end, chunk * chunk_strips + chunk_strips + 1);
+    };
+
+    size_t grid_size = grid_rows.size() * (num_columns + 1);
+    for(size_t chunk = first_chunk; chunk <= last_chunk; ++chunk)
+    {
+        size_t begin, end;
+        vert_range(chunk, begin, end);
+        grid_size += grid_columns.size() * (end - begin + 1);
+    }
+
+    tile.grid_index.resize(grid_size);
+    tile.grid_chunks.clear();
+    GLushort * grid_out = tile.grid_index.data();
+
+    for(size_t chunk = first_chunk; chunk <= last_chunk; ++chunk)
+    {
+        const size_t base = chunk_base(chunk);
+        const GLushort * chunk_begin = grid_out;
+
+        // horizontal pass
+        for(size_t row: grid_rows)
+        {
+            if(row_chunk(row) != chunk)
+                continue;
+
+            for(size_t column = 0; column < num_columns; ++column)
+                *grid_out++ = defined(row, column) ? row * num_columns + column - base : restart_index;
+            *grid_out++ = restart_index;
+        }
+
+        // vertical pass
+        size_t begin, end;
+        vert_range(chunk, begin, end);
+        for(size_t column: grid_columns)
+        {
+            for(size_t row = begin; row < end; ++row)
+                *grid_out++ = defined(row, column) ? row * num_columns + column - base : restart_index;
+            *grid_out++ = restart_index;
+        }
+
+        if(grid_out != chunk_begin)
+            tile.grid_chunks.push_back({(GLint)base, (size_t)(chunk_begin - tile.grid_index.data()),
+                (size_t)(grid_out - chunk_begin)});
+    }
+
+    // save last row for the next tile
+    const Word * last_row = tile.defined.row(tile.row_end - tile.row_begin - 1);
+    prev_row_defined.assign(last_row, last_row + words_per_row);
+}
+
+// append data to a buffer, reallocating it if it is out of space
+static void append_buffer_data(GLuint & buffer, GLsizeiptr & size, GLsizeiptr & capacity,
+    const GLvoid * data, const GLsizeiptr data_size)
+{
+    if(data_size == 0)
+        return;
+
+    if(size + data_size > capacity)
+    {
+        // grow the buffer, copying the existing data over
+        GLsizeiptr new_capacity = std::max(capacity * 2, size + data_size);
+
+        GLuint new_buffer;
+        glGenBuffers(1, &new_buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, NULL, GL_STATIC_DRAW);
+
+        if(size > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        }
+
+        if(buffer)
+            glDeleteBuffers(1, &buffer);
+
+        buffer = new_buffer;
+        capacity = new_capacity;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size, data_size, data);
+    size += data_size;
+}
+
+// size of each vertex in the VBO
+size_t Graph::vertex_size() const
+{
+    return _implicit_grid.enabled ? sizeof(Height_vertex) : sizeof(Packed_vertex);
+}
+
+// set attribute pointers for the bound VBO
+void Graph::set_vertex_attribs() const
+{
+    if(_implicit_grid.enabled)
+        set_height_vertex_attribs();
+    else
+        set_packed_vertex_attribs();
+}
+
+// start uploading a graph of the given size
+void Graph::begin_graph_geometry(Geometry_upload & upload, const size_t num_rows, const size_t num_columns)
+{
+    // free any existing geometry
+    free_graph_geometry();
+
+    upload.num_rows = num_rows;
+    upload.num_columns = num_columns;
+
+    // as many whole chunks as will fit in a section, and at least one
+    const size_t chunk_strips = chunk_rows(num_columns) - 1;
+    upload.section_rows = chunk_strips * std::max<size_t>(1, section_vertices / (chunk_strips * num_columns));
+
+    upload.first_open_section = 0;
+    upload.sections.clear();
+}
+
+// create OpenGL buffers for the next section
+void Graph::begin_section(Geometry_upload & upload)
+{
+    Section section;
+    section.row_begin = _sections.size() * upload.section_rows;
+    section.row_end = std::min(section.row_begin + upload.section_rows + 1, upload.num_rows);
+    section.vao = section.grid_vao = 0;
+    section.ebo = section.grid_ebo = 0;
+    section.occlusion_vbo = 0;
+    section.shared_indexes = false;
+    section.build_seconds = 0.0;
+    section.cache_stats = Vertex_cache_stats();
+
+    size_t num_verts = (section.row_end - section.row_begin) * upload.num_columns;
+
+    Section_upload sec_upload;
+    sec_upload.index_mode = GL_TRIANGLE_STRIP;
+    sec_upload.defined_hash = Defined_mask::hash_seed;
+
+    // vertex data size is known up front
+    section.vertex_bytes = vertex_size() * num_verts;
+    glGenBuffers(1, &section.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, section.vbo);
+    glBufferData(GL_ARRAY_BUFFER, section.vertex_bytes, NULL, GL_STATIC_DRAW);
+
+    // index sizes depend on which points are defined. start with a guess, and grow as needed
+    sec_upload.index_size = 0;
+    sec_upload.index_capacity = sizeof(GLushort) * 2 * num_verts;
+    glGenBuffers(1, &section.ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, section.ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, sec_upload.index_capacity, NULL, GL_STATIC_DRAW);
+
+    // gridlines drawn by the shader don't need a buffer
+    sec_upload.grid_size = 0;
+    sec_upload.grid_capacity = 0;
+    if(!shader_grid_flag)
+    {
+        sec_upload.grid_capacity = sizeof(GLushort) * 9 * (section.row_end - section.row_begin + upload.num_columns + 2);
+        glGenBuffers(1, &section.grid_ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, section.grid_ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, sec_upload.grid_capacity, NULL, GL_STATIC_DRAW);
     }
 
-    // generate & load required OpenGL structures
-    glGenVertexArrays(1, &_grid_vao);
-    glBindVertexArray(_grid_vao);
+    check_error("allocate graph section");
 
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    _sections.push_back(section);
+    upload.sections.push_back(std::move(sec_upload));
+}
 
-    glGenBuffers(1, &_grid_ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _grid_ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * grid_index.size(), grid_index.data(), GL_STATIC_DRAW);
+// copy a tile into the OpenGL buffers, finishing any sections it completes
+void Graph::upload_graph_tile(Geometry_upload & upload, const Mesh_data & tile)
+{
+    const size_t num_columns = upload.num_columns;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
+    // open every section that has rows in this tile
+    // the next section starts on the last row of the one before
+    while(_sections.empty() || (_sections.back().row_end < upload.num_rows && _sections.back().row_end - 1 < tile.row_end))
+        begin_section(upload);
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size()));
-    glEnableVertexAttribArray(1);
+    // pack and interleave vertex data
+    std::vector<Height_vertex> height_verts;
+    std::vector<Packed_vertex> packed_verts;
+    if(_implicit_grid.enabled)
+    {
+        height_verts.resize(tile.coords.size());
+        Thread_pool::get().parallel_for(0, height_verts.size(), [&](const size_t i)
+        {
+            height_verts[i] = pack_height_vertex(tile.coords[i].z, tile.normals[i]);
+        });
+    }
+    else
+    {
+        packed_verts.resize(tile.coords.size());
+        Thread_pool::get().parallel_for(0, packed_verts.size(), [&](const size_t i)
+        {
+            packed_verts[i] = pack_vertex(tile.coords[i], tile.tex_coords[i], tile.normals[i]);
+        });
+    }
 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size()));
-    glEnableVertexAttribArray(2);
+    std::vector<GLubyte> occlusion(2 * tile.occlusion.size());
+    for(size_t i = 0; i < tile.occlusion.size(); ++i)
+    {
+        glm::vec2 light = glm::clamp(tile.occlusion[i], 0.0f, 1.0f) * 255.0f + 0.5f;
+        occlusion[2 * i] = (GLubyte)light.x;
+        occlusion[2 * i + 1] = (GLubyte)light.y;
+    }
 
-    _grid_num_indexes = grid_index.size();
+    // copy the rows each open section shares with the tile
+    for(size_t s = upload.first_open_section; s < _sections.size(); ++s)
+    {
+        Section & section = _sections[s];
+        size_t row_begin = std::max(tile.row_begin, section.row_begin);
+        size_t row_end = std::min(tile.row_end, section.row_end);
+        if(row_begin >= row_end)
+            continue;
 
-    // lines for normal vectors
-    std::vector<glm::vec3> normal_coords;
+        size_t tile_offset = (row_begin - tile.row_begin) * num_columns;
+        size_t section_offset = (row_begin - section.row_begin) * num_columns;
+        size_t count = (row_end - row_begin) * num_columns;
+
+        glBindBuffer(GL_ARRAY_BUFFER, section.vbo);
+        if(_implicit_grid.enabled)
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Height_vertex) * section_offset,
+                sizeof(Height_vertex) * count, &height_verts[tile_offset]);
+        else
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Packed_vertex) * section_offset,
+                sizeof(Packed_vertex) * count, &packed_verts[tile_offset]);
+
+        upload.sections[s].defined_hash = tile.defined.hash_rows(row_begin - tile.row_begin,
+            row_end - tile.row_begin, upload.sections[s].defined_hash);
+
+        // baked ambient occlusion goes in a buffer of its own, made when it's first needed
+        if(!occlusion.empty())
+        {
+            if(!section.occlusion_vbo)
+            {
+                size_t section_verts = (section.row_end - section.row_begin) * num_columns;
+                glGenBuffers(1, &section.occlusion_vbo);
+                glBindBuffer(GL_ARRAY_BUFFER, section.occlusion_vbo);
+                glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(GLubyte) * section_verts, NULL, GL_STATIC_DRAW);
+                section.vertex_bytes += 2 * sizeof(GLubyte) * section_verts;
+            }
 
-    for(size_t i = 0; i < coords.size(); ++i)
+            glBindBuffer(GL_ARRAY_BUFFER, section.occlusion_vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, 2 * sizeof(GLubyte) * section_offset,
+                2 * sizeof(GLubyte) * count, &occlusion[2 * tile_offset]);
+        }
+    }
+
+    // indexes go onto the end of their section's buffers, relative to the section's first vertex
+    auto append_index = [&](const std::vector<GLushort> & index, const std::vector<Mesh_chunk> & chunks, const bool grid)
     {
-        if(defined[i])
+        for(auto chunk: chunks)
         {
-            normal_coords.push_back(coords[i]);
-            normal_coords.push_back(coords[i] + 0.1f * normals[i]);
+            const size_t s = chunk.base_vertex / num_columns / upload.section_rows;
+            Section & section = _sections[s];
+            Section_upload & sec_upload = upload.sections[s];
+
+            const GLushort * data = index.data() + chunk.index_begin;
+            chunk.base_vertex -= section.row_begin * num_columns;
+
+            if(grid)
+            {
+                chunk.index_begin = sec_upload.grid_size / sizeof(GLushort);
+                append_chunks(sec_upload.grid_chunks, {chunk}, 0);
+                append_buffer_data(section.grid_ebo, sec_upload.grid_size, sec_upload.grid_capacity,
+                    data, sizeof(GLushort) * chunk.index_count);
+            }
+            else
+            {
+                chunk.index_begin = sec_upload.index_size / sizeof(GLushort);
+                append_chunks(sec_upload.chunks, {chunk}, 0);
+                append_buffer_data(section.ebo, sec_upload.index_size, sec_upload.index_capacity,
+                    data, sizeof(GLushort) * chunk.index_count);
+            }
         }
+    };
+
+    for(size_t s = upload.first_open_section; s < _sections.size(); ++s)
+        upload.sections[s].index_mode = tile.index_mode;
+
+    append_index(tile.index, tile.chunks, false);
+    append_index(tile.grid_index, tile.grid_chunks, true);
+
+    // vertex cache use is counted for the section holding each chunk
+    for(const auto & chunk_stats: tile.chunk_cache_stats)
+        _sections[chunk_stats.first / num_columns / upload.section_rows].cache_stats.add(chunk_stats.second);
+
+    // finish sections this tile completes
+    while(upload.first_open_section < _sections.size() && _sections[upload.first_open_section].row_end <= tile.row_end)
+        end_section(upload, upload.first_open_section++);
+}
+
+// set up vertex arrays for a section once all of its tiles are uploaded
+void Graph::end_section(Geometry_upload & upload, const size_t s)
+{
+    Section & section = _sections[s];
+    Section_upload & sec_upload = upload.sections[s];
+
+    // graphs with the same size and defined points have identical indexes
+    // use existing buffers if there are any, otherwise share ours
+    // decimated indexes depend on the shape of the graph, so they are never shared
+    Index_buffer_cache & cache = Index_buffer_cache::get();
+    Index_buffer_cache::Key key{upload.num_rows, upload.num_columns, section.row_begin, sec_upload.defined_hash,
+        optimize_index_order, (size_t)sec_upload.index_size, (size_t)sec_upload.grid_size};
+
+    bool shareable = sec_upload.index_mode == GL_TRIANGLE_STRIP;
+
+    section.index_buffers = shareable ? cache.find(key) : nullptr;
+    section.shared_indexes = (bool)section.index_buffers;
+    if(section.shared_indexes)
+    {
+        glDeleteBuffers(1, &section.ebo);
+        if(section.grid_ebo)
+            glDeleteBuffers(1, &section.grid_ebo);
+    }
+    else
+    {
+        section.index_buffers = std::make_shared<const Index_buffers>(section.ebo, section.grid_ebo,
+            sec_upload.chunks, sec_upload.grid_chunks, sec_upload.index_mode);
+        if(shareable)
+            cache.insert(key, section.index_buffers);
     }
+    section.ebo = section.grid_ebo = 0;
+
+    // generate required OpenGL structures
+    glGenVertexArrays(1, &section.vao);
+    glBindVertexArray(section.vao);
 
-    // generate & load required OpenGL structures
-    glGenVertexArrays(1, &_normal_vao);
-    glBindVertexArray(_normal_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, section.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, section.index_buffers->ebo);
 
-    glGenBuffers(1, &_normal_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, _normal_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normal_coords.size(), normal_coords.data(), GL_STATIC_DRAW);
+    set_vertex_attribs();
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
+    if(section.occlusion_vbo)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, section.occlusion_vbo);
+        set_occlusion_attribs();
+    }
+
+    // grid lines
+    if(section.index_buffers->grid_ebo)
+    {
+        glGenVertexArrays(1, &section.grid_vao);
+        glBindVertexArray(section.grid_vao);
 
-    _normal_num_indexes = normal_coords.size();
+        glBindBuffer(GL_ARRAY_BUFFER, section.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, section.index_buffers->grid_ebo);
+
+        set_vertex_attribs();
+    }
 
     glBindVertexArray(0);
+
+    // sizes are the allocated sizes, including any room left over
+    section.index_bytes = sec_upload.index_capacity + sec_upload.grid_capacity;
+
+    auto now = std::chrono::steady_clock::now();
+    section.build_seconds = std::chrono::duration<double>(now - upload.section_start).count();
+    upload.section_start = now;
+}
+
+// finish any sections left once all tiles are uploaded
+void Graph::end_graph_geometry(Geometry_upload & upload)
+{
+    while(upload.first_open_section < _sections.size())
+        end_section(upload, upload.first_open_section++);
+}
+
+// free graph geometry OpenGL objects
+void Graph::free_graph_geometry()
+{
+    for(auto & section: _sections)
+    {
+        if(section.vao)
+            glDeleteVertexArrays(1, &section.vao);
+        if(section.vbo)
+            glDeleteBuffers(1, &section.vbo);
+        if(section.ebo)
+            glDeleteBuffers(1, &section.ebo);
+        if(section.grid_vao)
+            glDeleteVertexArrays(1, &section.grid_vao);
+        if(section.grid_ebo)
+            glDeleteBuffers(1, &section.grid_ebo);
+        if(section.occlusion_vbo)
+            glDeleteBuffers(1, &section.occlusion_vbo);
+    }
+    _sections.clear();
+}
+
+// find the bounds of each section's index chunks from the bvh
+void Graph::find_chunk_bounds()
+{
+    const size_t num_columns = _bvh.num_columns();
+
+    for(auto & section: _sections)
+    {
+        section.chunk_bounds.clear();
+        if(!section.index_buffers || num_columns == 0)
+            continue;
+
+        // a chunk's indexes are 16 bit offsets from its base vertex, so that limits the rows it can use
+        for(const auto & chunk: section.index_buffers->chunks)
+        {
+            size_t row_begin = section.row_begin + chunk.base_vertex / num_columns;
+            size_t row_end = std::min(section.row_end,
+                section.row_begin + (chunk.base_vertex + restart_index) / num_columns + 1);
+
+            section.chunk_bounds.push_back(_bvh.rows_bounds(row_begin, row_end));
+        }
+    }
+}
+
+// send contour lines for the current levels to OpenGL
+void Graph::upload_contours()
+{
+    // lines are kept by the contours, so this only finds lines for new levels
+    std::vector<glm::vec3> lines = _contours.lines();
+    _contour_num_verts = lines.size();
+
+    if(!_contour_vao)
+    {
+        // nothing to draw yet, so don't bother creating the buffers
+        if(lines.empty())
+            return;
+
+        glGenVertexArrays(1, &_contour_vao);
+        glBindVertexArray(_contour_vao);
+
+        glGenBuffers(1, &_contour_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, _contour_vbo);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(0);
+
+        glBindVertexArray(0);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, _contour_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * lines.size(), lines.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    check_error("upload contours");
 }
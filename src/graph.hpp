@@ -23,7 +23,13 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <GL/glew.h>
 
@@ -36,6 +42,12 @@
 
 #include <muParser.h>
 
+#include "defined_mask.hpp"
+#include "graph_bvh.hpp"
+#include "graph_contours.hpp"
+#include "graph_measure.hpp"
+#include "index_buffer.hpp"
+
 #ifndef M_PI
 #define M_PI 3.141592654
 #endif
@@ -49,7 +61,7 @@
 class Graph_exception: public mu::Parser::exception_type
 {
 public:
-    typedef enum {ROW_MIN, ROW_MAX, COL_MIN, COL_MAX, EQN, EQN_X, EQN_Y, EQN_Z} Location;
+    typedef enum {ROW_MIN, ROW_MAX, COL_MIN, COL_MAX, EQN, EQN_X, EQN_Y, EQN_Z, Z_MIN, Z_MAX} Location;
     Graph_exception(const mu::Parser::exception_type & mu_e, const Location l);
     Location GetLocation() const;
 
@@ -57,16 +69,87 @@ private:
     Location _location;
 };
 
-// calculate the normal of a point given surrounding points
-glm::vec3 get_normal (glm::vec3 center,
-    glm::vec3 up, bool up_def,
-    glm::vec3 ur, bool ur_def,
-    glm::vec3 rt, bool rt_def,
-    glm::vec3 lr, bool lr_def,
-    glm::vec3 dn, bool dn_def,
-    glm::vec3 ll, bool ll_def,
-    glm::vec3 lf, bool lf_def,
-    glm::vec3 ul, bool ul_def);
+// a parser for one of a graph's equations, with its own copies of the column and row variables,
+// so that each thread can have one. errors are thrown as Graph_exceptions from location
+// the parser holds pointers to the variables, so this can't be moved once created
+class Equation_parser
+{
+public:
+    Equation_parser(const std::string & eqn, const std::string & col_var, const std::string & row_var,
+        const Graph_exception::Location location);
+
+    double eval(const double col_param, const double row_param);
+
+private:
+    mu::Parser _p;
+    double _col, _row;
+    Graph_exception::Location _location;
+
+    // make non-copyable
+    Equation_parser(const Equation_parser &) = delete;
+    Equation_parser(const Equation_parser &&) = delete;
+    Equation_parser & operator=(const Equation_parser &) = delete;
+    Equation_parser & operator=(const Equation_parser &&) = delete;
+};
+
+// calculate normals for a batch of points, given the points surrounding each
+// pts holds a 3x3 stencil of 9 points for each normal, indexed [row offset * 3 + col offset],
+// with the center point at 4. def holds the matching defined flags
+void get_normals(const glm::vec3 * pts, const char * def, glm::vec3 * normals, const size_t count);
+
+// distance along a ray to where it hits a triangle, or infinity if it misses (Möller–Trumbore)
+// bary is set to the barycentric coords of the hit, relative to b and c
+float intersect_triangle(const glm::vec3 & origin, const glm::vec3 & dir,
+    const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c, glm::vec2 & bary);
+
+// post-transform vertex cache use of triangle strips, from a simulated FIFO cache
+// misses are counted for the strips as drawn, and for the same triangles drawn as full width strips
+struct Vertex_cache_stats
+{
+    // number of entries in the simulated cache
+    static const size_t cache_size = 32;
+
+    size_t num_triangles = 0;
+    // misses for strips in the order they are drawn
+    size_t misses = 0;
+    // misses for strips running the full width of the graph
+    size_t row_misses = 0;
+
+    void add(const Vertex_cache_stats & other);
+};
+
+// graph geometry on the CPU side, with no OpenGL objects
+// can be built on any thread, and uploaded with Graph::upload
+// vertex data covers rows [row_begin, row_end) of a num_rows x num_columns grid.
+// while building, this holds a tile of the graph, and the index data
+// includes the triangles joining it to the previous tile
+struct Mesh_data
+{
+    // add the next tile onto the end of this one
+    void append(Mesh_data && tile);
+
+    size_t num_rows = 0, num_columns = 0;
+    size_t row_begin = 0, row_end = 0;
+
+    std::vector<glm::vec3> coords;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<glm::vec3> normals;
+    Defined_mask defined;
+
+    std::vector<GLushort> index;
+    std::vector<Mesh_chunk> chunks;
+    // triangle strips, or a triangle list once decimated
+    GLenum index_mode = GL_TRIANGLE_STRIP;
+    std::vector<GLushort> grid_index;
+    std::vector<Mesh_chunk> grid_chunks;
+    // vertex cache use of each chunk's strips, with the chunk's base vertex
+    // only measured when the index order is optimized, and dropped once decimated
+    std::vector<std::pair<GLint, Vertex_cache_stats>> chunk_cache_stats;
+
+    // light reaching the front and back of each vertex, from 0 (none) to 1 (unblocked)
+    // empty unless ambient occlusion is baked. see Graph::Ambient_occlusion
+    std::vector<glm::vec2> occlusion;
+};
 
 // graph base class
 // common methods and ownership of OpenGL resources
@@ -76,19 +159,105 @@ public:
     Graph();
     virtual ~Graph();
 
+    // parameters for rebuilding x, y, and tex coords from the vertex index in the vertex shader
+    // for graphs where those are linear functions of the row and column (cartesian)
+    // when enabled, the VBO holds only the height and normal of each vertex
+    struct Implicit_grid
+    {
+        bool enabled = false;
+        GLint num_columns = 0;
+        // row of the first vertex in the VBO being drawn
+        GLint first_row = 0;
+        // position of row 0, column 0, and the change per column, row
+        glm::vec2 origin, step;
+        // change in tex coords per column, row
+        glm::vec2 tex_step;
+        // change in grid line coords per column, row, for gridlines drawn by the fragment shader.
+        // set along with num_columns and first_row whenever the verticies are a grid of the
+        // column and row variables, even if the rest is disabled. zero for other graphs
+        glm::vec2 line_step = glm::vec2(0.0f);
+    };
+    const Implicit_grid & implicit_grid() const;
+
+    // graphs are drawn a section at a time, each with its own buffers
+    // called before each section is drawn, to set the implicit grid for it
+    typedef std::function<void(const Implicit_grid &)> Implicit_grid_setup;
+
     // draw graph geometry
-    void draw() const;
+    void draw(const Implicit_grid_setup & grid_setup) const;
     // draw gridlines
-    void draw_grid() const;
-    // draw normals
-    void draw_normals() const;
+    void draw_grid(const Implicit_grid_setup & grid_setup) const;
+    // draw normals, from the surface's verticies. needs a geometry shader to turn points into lines
+    void draw_normals(const Implicit_grid_setup & grid_setup) const;
+    // draw contour lines
+    void draw_contours() const;
+    // draw the graph's triangles that may cross the plane dot(normal, pos) == offset
+    // index chunks are culled by their bounds, and the rest are drawn whole, for a geometry
+    // shader that turns each triangle into the segment where it crosses the plane
+    void draw_slice(const glm::vec3 & normal, const float offset, const Implicit_grid_setup & grid_setup) const;
 
     // change texture given a filename
     void set_texture(const std::string & filename);
 
+    // calculate graph geometry and build OpenGL objects from it
+    // tiles are uploaded as they are finished (unless decimating). needs OpenGL to be initialized
+    void build();
+    // calculate graph geometry without creating any OpenGL objects
+    // can be run on any thread, but not concurrently with other calls to this graph
+    Mesh_data build_mesh();
+    // build OpenGL objects from previously calculated geometry, and the normal map, if enabled
+    void upload(const Mesh_data & mesh);
+
+    // where a ray hits the graph, given by the values of the column and row variables
+    // of the sampling grid (x, y for cartesian, u, v for parametric, etc.)
+    struct Ray_hit
+    {
+        float dist;
+        double col_param, row_param;
+    };
+    // find the nearest point where a ray hits the graph. origin and dir are in graph coordinates
+    // the hit found on the sampled surface is refined by re-evaluating the equation around it
+    // returns false on a miss, when the graph hasn't been built, or for unstructured graphs
+    bool intersect(const glm::vec3 & origin, const glm::vec3 & dir, Ray_hit & hit);
+
+    // find the curves where this graph's surface meets another's, as polylines in graph coordinates
+    // only triangles in overlapping bvh leaves are tested against each other.
+    // empty if either graph is unstructured. defined in graph_intersect.cpp
+    std::vector<std::vector<glm::vec3>> intersection_curves(Graph & other);
+
+    // area of the surface, and for height fields (cartesian, cylindrical), the signed volume between it
+    // and z = 0, and its average height over the part of the x-y plane where it's defined.
+    // each comes with an estimate of its error
+    struct Measurements
+    {
+        double area = 0.0, area_error = 0.0;
+        bool has_volume = false;
+        double volume = 0.0, volume_error = 0.0;
+        // area of the graph projected onto the x-y plane
+        double projected_area = 0.0, projected_area_error = 0.0;
+        double average_height = 0.0, average_height_error = 0.0;
+        // set when the integrals were refined by evaluating the equation
+        bool refined = false;
+    };
+    // measure the sampled surface, from sums kept from the last build. errors are estimated by comparing
+    // with the surface sampled on every other row and column, and are NaN for implicit graphs.
+    // with refine, the integrals are found again by adaptive quadrature, evaluating the equation directly,
+    // for graphs that are a grid of the column and row variables. refining uses its own parsers, so it
+    // can run on another thread while the graph is drawn. defined in graph_measure.cpp
+    Measurements measure(const bool refine) const;
+
+    // true for height field graphs (cartesian, cylindrical), which can have contour lines
+    bool has_contours() const;
+    // set the heights to draw contour lines at
+    // lines are found from the heights kept from the last build, without evaluating the graph again,
+    // and only for levels that weren't already set. needs OpenGL to be initialized
+    void set_contour_levels(const std::vector<float> & levels);
+
     // cursor funcs
     typedef enum {UP, DOWN, LEFT, RIGHT} Cursor_dir;
     virtual void move_cursor(const Cursor_dir dir) = 0;
+    // move the cursor to the point given by the column and row variables, as in Ray_hit
+    virtual void set_cursor(const double col_param, const double row_param) = 0;
     virtual glm::vec3 cursor_pos() const = 0;
     virtual bool cursor_defined() const = 0;
     virtual std::string cursor_text() const = 0;
@@ -105,43 +274,272 @@ public:
 
     glm::vec3 grid_color;
     glm::vec3 normal_color;
+    glm::vec3 contour_color;
+
+    // length of normal lines, in graph coordinates
+    float normal_length;
 
     // toggle drawing on and off
     bool draw_flag;
     bool transparent_flag;
     bool draw_normals_flag;
     bool draw_grid_flag;
+    bool draw_contours_flag;
+
+    // draw gridlines in the surface's fragment shader instead of from their own index buffers.
+    // read when the graph is built, and graphs built with it have no grid indexes
+    bool shader_grid_flag;
+    // gridlines drawn by the shader divide the graph into this many cells along each axis
+    float grid_density;
+    // width of gridlines drawn by the shader, in pixels
+    float grid_width;
+
+    // largest resolution along either axis, so that each 16 bit index chunk holds at least 2 rows
+    // graphs are built and stored a section at a time, so otherwise size is only limited by memory
+    static const size_t max_resolution = restart_index / 2;
+
+    // order triangle strips to make better use of the vertex cache
+    bool optimize_index_order;
+
+    // simplify the surface once it's sampled, before it's uploaded. see decimate.hpp
+    struct Decimation
+    {
+        bool enabled = false;
+        // how far the surface may move, as a fraction of the size of the graph
+        float max_error = 1e-3f;
+        // stop once this many triangles are left. 0 for no limit
+        size_t target_triangles = 0;
+    };
+    Decimation decimation;
+
+    // darken creases and enclosed areas by how much of the sky above each vertex the graph itself
+    // blocks. rays are cast from both sides of every vertex once the graph is sampled, and the
+    // result is stored with the verticies, so it costs nothing to draw. see graph_occlusion.cpp
+    // needs the whole graph at once, and a grid of the column and row variables (not implicit)
+    struct Ambient_occlusion
+    {
+        bool enabled = false;
+        // rays cast from each side of each vertex
+        size_t rays = 32;
+        // how far away the graph can block a ray, as a fraction of the size of the graph
+        float distance = 0.25f;
+    };
+    Ambient_occlusion ambient_occlusion;
+
+    // signaled on the building thread as ambient occlusion is baked, with the fraction done
+    sigc::signal<void, float> signal_bake_progress();
+    // time taken to bake ambient occlusion the last time the graph was built. 0 if it wasn't
+    double bake_seconds() const;
+    // stop building, baking ambient occlusion, or refining measurements, as soon as possible. can be called
+    // from any thread. build_mesh and measure return early, unfinished, so the graph should be thrown away
+    void cancel();
+
+    // OpenGL memory used by each section of the graph, and the time taken to build it, from the last build
+    struct Section_stats
+    {
+        size_t row_begin, row_end;
+        size_t vertex_bytes, index_bytes;
+        // set when the section uses another graph's index buffers, so its indexes take no extra memory
+        bool shared_indexes;
+        double build_seconds;
+        // vertex cache use of the section's strips. no triangles unless the index order was optimized
+        Vertex_cache_stats cache_stats;
+    };
+    std::vector<Section_stats> section_stats() const;
+
+    // light the surface with normals sampled on a finer grid than the verticies, so that a coarse
+    // mesh shades like a fine one. normals are stored in a texture over the column and row variables,
+    // read in the fragment shader. see graph_normal_map.cpp
+    // needs a grid of the column and row variables (not implicit)
+    struct Normal_map
+    {
+        bool enabled = false;
+        // cells of the texture per cell of the graph, along each axis
+        size_t scale = 10;
+        // largest size of the texture along either axis. scale is lowered to fit
+        size_t max_size = 4096;
+    };
+    Normal_map normal_map;
+
+    // true if the graph was last built with a normal map
+    bool has_normal_map() const;
 
 protected:
-    // calculate & build graph geometry
-    virtual void build_graph() = 0;
-
-    // helper function to build OpenGL objects from verticies
-    void build_graph_geometry(size_t num_rows, size_t num_columns,
-        const std::vector<glm::vec3> & coords,
-        const std::vector<glm::vec2> & tex_coords,
-        const std::vector<glm::vec3> & normals,
-        const std::vector<bool> & defined);
+    // receives geometry a tile at a time, in order
+    typedef std::function<void(Mesh_data &)> Tile_sink;
+
+    // calculate graph geometry
+    virtual void build_graph(const Tile_sink & sink) = 0;
+
+    // evaluate a point on the graph in cartesian coordinates, given the column and row variables
+    // returns false if the point is undefined
+    virtual bool eval_point(const double col_param, const double row_param, glm::dvec3 & pos) = 0;
+
+    // makes a function that evaluates points like eval_point, with its own copy of the equation's parser,
+    // so that one can be used on each thread. graphs that aren't a grid of the column and row variables
+    // return an empty function, which is what the default does
+    typedef std::function<bool(const double, const double, glm::dvec3 &)> Point_eval;
+    virtual Point_eval make_point_eval() const;
+
+    // sample a graph's equation and build geometry from it, a tile at a time
+    // defined in graph_sampler.hpp
+    template<typename Coord_sys, typename Eval>
+    void build_graph_mesh(const Coord_sys & sys, Eval && eval, const Tile_sink & sink);
+
+    // normals sampled for a normal map, row by row. zero where the graph is undefined
+    struct Normal_grid
+    {
+        size_t num_rows = 0, num_columns = 0;
+        std::vector<glm::vec3> normals;
+    };
+
+    // sample normals over the graph's range of the column and row variables, with scale times
+    // as many cells along each axis as the graph has. graphs that aren't a grid of the column and
+    // row variables leave grid empty, which is what the default does
+    virtual void build_normals(const size_t scale, Normal_grid & grid);
+
+    // sample normals on a grid scale times finer than sys's, with the same stages as build_graph_mesh
+    // points are evaluated on every thread at once, so make_eval is called to make an eval for each,
+    // which is called like build_graph_mesh's eval, and has its own copy of the equation's parser.
+    // defined in graph_sampler.hpp
+    template<typename Coord_sys, typename Make_eval>
+    void build_normal_grid(const Coord_sys & sys, Make_eval && make_eval, const size_t scale, Normal_grid & grid);
+
+    // pass on a whole graph whose vertices aren't a grid of the column and row variables (implicit surfaces)
+    // the vertices are still stored in rows, and the bvh is built over them for culling,
+    // but the graph can't be picked or intersected with others
+    void sink_unstructured_mesh(Mesh_data & mesh, const Tile_sink & sink);
+
+    // number of rows of verticies in each chunk
+    static size_t chunk_rows(const size_t num_columns);
+
+    // build index and grid data for a tile
+    // prev_row_defined holds the defined flags for the last row of the previous tile
+    // grid lines are only generated when grid_lines is set
+    static void index_graph_tile(Mesh_data & tile, std::vector<Defined_mask::Word> & prev_row_defined,
+        const bool optimize_order, const bool grid_lines);
+
+    // set by derived classes that can use an implicit grid
+    Implicit_grid _implicit_grid;
+    // set by derived classes where the graph's value is the z coordinate. only these have contours
+    bool _height_field;
 
     // OpenGL objects
     GLuint _tex;
-    GLuint _vao;
-    GLuint _vbo;
-    GLuint _ebo;
-    GLuint _num_indexes;
-
-    GLuint _grid_vao;
-    GLuint _grid_ebo;
-    GLuint _grid_num_indexes;
-
-    GLuint _normal_vao;
-    GLuint _normal_vbo;
-    GLuint _normal_num_indexes;
+    GLuint _normal_map;
+
+    // a band of rows of the graph, with its own OpenGL buffers
+    // graphs are split into sections so that no one buffer needs to hold the whole graph,
+    // and so that each can be finished as soon as its rows are built.
+    // sections are made of whole index chunks, and neighboring sections share a row
+    struct Section
+    {
+        size_t row_begin, row_end;
+
+        GLuint vao;
+        GLuint vbo;
+        GLuint grid_vao;
+        // baked ambient occlusion, if any
+        GLuint occlusion_vbo;
+
+        // index buffers, possibly shared with other graphs
+        std::shared_ptr<const Index_buffers> index_buffers;
+        // index buffers being uploaded, before they are handed to index_buffers
+        GLuint ebo;
+        GLuint grid_ebo;
+
+        // bounds of each index chunk, for culling against a slicing plane
+        std::vector<Graph_bvh::Box> chunk_bounds;
+
+        // OpenGL memory used, and time taken to build
+        size_t vertex_bytes, index_bytes;
+        bool shared_indexes;
+        double build_seconds;
+        // vertex cache use of the strips, summed over the section's chunks
+        Vertex_cache_stats cache_stats;
+    };
+    std::vector<Section> _sections;
 
     // signaled on cursor move
     sigc::signal<void, const std::string &> _signal_cursor_moved;
+    sigc::signal<void, float> _signal_bake_progress;
 
 private:
+    // state of a section's OpenGL buffers while tiles are being uploaded
+    struct Section_upload
+    {
+        GLsizeiptr index_size, index_capacity;
+        GLsizeiptr grid_size, grid_capacity;
+        std::vector<Mesh_chunk> chunks, grid_chunks;
+        GLenum index_mode;
+        uint64_t defined_hash;
+    };
+
+    // state of the OpenGL buffers while tiles are being uploaded
+    struct Geometry_upload
+    {
+        size_t num_rows, num_columns;
+        // rows in each section, not counting the row shared with the next section
+        size_t section_rows;
+        // sections before this are finished
+        size_t first_open_section;
+        std::vector<Section_upload> sections;
+        // when the current section was started, for timing. the first starts with the build
+        std::chrono::steady_clock::time_point section_start = std::chrono::steady_clock::now();
+    };
+
+    // size of each vertex in the VBO
+    size_t vertex_size() const;
+    // set attribute pointers for the bound VBO
+    void set_vertex_attribs() const;
+
+    // start uploading a graph of the given size
+    void begin_graph_geometry(Geometry_upload & upload, const size_t num_rows, const size_t num_columns);
+    // create OpenGL buffers for the next section
+    void begin_section(Geometry_upload & upload);
+    // copy a tile into the OpenGL buffers, finishing any sections it completes
+    void upload_graph_tile(Geometry_upload & upload, const Mesh_data & tile);
+    // set up vertex arrays for a section once all of its tiles are uploaded
+    void end_section(Geometry_upload & upload, const size_t section);
+    // finish any sections left once all tiles are uploaded
+    void end_graph_geometry(Geometry_upload & upload);
+    // free graph geometry OpenGL objects
+    void free_graph_geometry();
+    // send contour lines for the current levels to OpenGL
+    void upload_contours();
+    // find the bounds of each section's index chunks from the bvh
+    void find_chunk_bounds();
+
+    // evaluate the points of a bvh leaf. pts and defined are stored row by row
+    void eval_leaf(const Graph_bvh::Leaf & leaf, std::vector<glm::vec3> & pts, std::vector<char> & defined);
+
+    // fill in mesh.occlusion, casting rays against the bvh over the whole sampled graph
+    // defined in graph_occlusion.cpp
+    void bake_ambient_occlusion(Mesh_data & mesh);
+    double _bake_seconds;
+    // set by cancel, and checked while sampling, decimating, baking and measuring
+    std::atomic<bool> _cancelled;
+
+    // sample normals and upload them to the normal map texture, or delete it when not enabled.
+    // needs the graph to be built. defined in graph_normal_map.cpp
+    void build_normal_map();
+
+    // bounding boxes of the sampled surface, for intersect. built by build_graph_mesh
+    Graph_bvh _bvh;
+    // set when the bvh's rows and columns are a grid of the column and row variables
+    bool _param_grid;
+    // values of the column and row variables at column 0, row 0, and the change per column, row
+    glm::dvec2 _param_origin, _param_step;
+
+    // heights kept for finding contour lines, and the lines for the current levels
+    Graph_contours _contours;
+    GLuint _contour_vao;
+    GLuint _contour_vbo;
+    GLsizei _contour_num_verts;
+
+    // area and volume of the sampled surface, summed as it's built
+    Graph_measure _measure;
+
     // make non-copyable
     Graph(const Graph &) = delete;
     Graph(const Graph &&) = delete;
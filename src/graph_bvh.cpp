@@ -0,0 +1,347 @@
+// graph_bvh.cpp
+// bounding volume hierarchy over a graph's sampling grid
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <queue>
+
+#include "graph_bvh.hpp"
+#include "parallel.hpp"
+
+// start a new hierarchy for a grid of the given size
+void Graph_bvh::begin(const size_t num_rows, const size_t num_columns)
+{
+    _num_rows = num_rows;
+    _num_columns = num_columns;
+    _built = false;
+
+    // number of leaves needed to cover the quads along each axis
+    auto num_leaves = [](const size_t num_pts)
+    {
+        return std::max<size_t>(1, (num_pts + leaf_size - 2) / leaf_size);
+    };
+
+    _level_dims.assign(1, glm::uvec2(num_leaves(num_rows), num_leaves(num_columns)));
+    while(_level_dims.back().x > 1 || _level_dims.back().y > 1)
+        _level_dims.push_back((_level_dims.back() + 1u) / 2u);
+
+    _levels.resize(_level_dims.size());
+    for(size_t i = 0; i < _levels.size(); ++i)
+        _levels[i].assign(_level_dims[i].x * _level_dims[i].y, Box());
+}
+
+// add the defined points of rows [row_begin, row_end) to their leaves
+void Graph_bvh::add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined)
+{
+    const glm::uvec2 dims = _level_dims[0];
+    std::vector<Box> & leaves = _levels[0];
+
+    // a point on the edge between two leaves belongs to both
+    auto first_leaf = [](const size_t i) { return i == 0 ? 0 : (i - 1) / leaf_size; };
+    auto last_leaf = [](const size_t i, const size_t num_leaves) { return std::min(i / leaf_size, num_leaves - 1); };
+
+    // each leaf row is only written to by one thread
+    Thread_pool::get().parallel_for(first_leaf(row_begin), last_leaf(row_end - 1, dims.x) + 1, [&](const size_t leaf_row)
+    {
+        size_t begin = std::max(row_begin, leaf_row * leaf_size);
+        size_t end = std::min(row_end, leaf_row * leaf_size + leaf_size + 1);
+
+        for(size_t row = begin; row < end; ++row)
+        {
+            for(size_t col = 0; col < _num_columns; ++col)
+            {
+                if(!defined.get(row - row_begin, col))
+                    continue;
+
+                const glm::vec3 & pt = coords[(row - row_begin) * _num_columns + col];
+                for(size_t leaf_col = first_leaf(col); leaf_col <= last_leaf(col, dims.y); ++leaf_col)
+                    leaves[leaf_row * dims.y + leaf_col].add(pt);
+            }
+        }
+    });
+}
+
+// build the upper levels once all rows are added
+void Graph_bvh::end()
+{
+    for(size_t level = 1; level < _levels.size(); ++level)
+    {
+        const glm::uvec2 dims = _level_dims[level];
+        const glm::uvec2 child_dims = _level_dims[level - 1];
+        const std::vector<Box> & children = _levels[level - 1];
+        std::vector<Box> & boxes = _levels[level];
+
+        Thread_pool::get().parallel_for(0, dims.x, [&](const size_t row)
+        {
+            for(size_t col = 0; col < dims.y; ++col)
+            {
+                for(size_t child_row = row * 2; child_row < std::min<size_t>(row * 2 + 2, child_dims.x); ++child_row)
+                {
+                    for(size_t child_col = col * 2; child_col < std::min<size_t>(col * 2 + 2, child_dims.y); ++child_col)
+                        boxes[row * dims.y + col].add(children[child_row * child_dims.y + child_col]);
+                }
+            }
+        });
+    }
+
+    _built = true;
+}
+
+// each quad of the grid is split into 2 triangles
+const glm::uvec2 Graph_bvh::quad_triangles[2][3] =
+{
+    {{0, 0}, {1, 0}, {0, 1}},
+    {{1, 1}, {0, 1}, {1, 0}}
+};
+
+// bounds of the whole grid's defined points
+Graph_bvh::Box Graph_bvh::bounds() const
+{
+    return _built ? _levels.back()[0] : Box();
+}
+
+// bounds of the leaves holding rows [row_begin, row_end)
+Graph_bvh::Box Graph_bvh::rows_bounds(const size_t row_begin, const size_t row_end) const
+{
+    Box bounds;
+    if(!_built || row_begin >= row_end)
+        return bounds;
+
+    const glm::uvec2 dims = _level_dims[0];
+
+    // rows on the edge between two leaves belong to both
+    size_t first_leaf = row_begin == 0 ? 0 : (row_begin - 1) / leaf_size;
+    size_t last_leaf = std::min<size_t>((row_end - 1) / leaf_size, dims.x - 1);
+
+    for(size_t leaf_row = first_leaf; leaf_row <= last_leaf; ++leaf_row)
+    {
+        for(size_t leaf_col = 0; leaf_col < dims.y; ++leaf_col)
+            bounds.add(_levels[0][leaf_row * dims.y + leaf_col]);
+    }
+
+    return bounds;
+}
+
+// leaves are numbered row by row
+size_t Graph_bvh::num_leaves() const
+{
+    return _levels.empty() ? 0 : _levels[0].size();
+}
+
+Graph_bvh::Leaf Graph_bvh::leaf(const size_t index) const
+{
+    size_t row = index / _level_dims[0].y;
+    size_t col = index % _level_dims[0].y;
+
+    Leaf leaf;
+    leaf.row_begin = row * leaf_size;
+    leaf.row_end = std::min(leaf.row_begin + leaf_size + 1, _num_rows);
+    leaf.col_begin = col * leaf_size;
+    leaf.col_end = std::min(leaf.col_begin + leaf_size + 1, _num_columns);
+    return leaf;
+}
+
+const Graph_bvh::Box & Graph_bvh::leaf_box(const size_t index) const
+{
+    return _levels[0][index];
+}
+
+const Graph_bvh::Box & Graph_bvh::box(const Node & node) const
+{
+    return _levels[node.level][node.row * _level_dims[node.level].y + node.col];
+}
+
+// the up to 4 boxes in the level below that make up node
+size_t Graph_bvh::children(const Node & node, Node * out) const
+{
+    const glm::uvec2 child_dims = _level_dims[node.level - 1];
+
+    size_t count = 0;
+    for(size_t row = node.row * 2; row < std::min<size_t>(node.row * 2 + 2, child_dims.x); ++row)
+    {
+        for(size_t col = node.col * 2; col < std::min<size_t>(node.col * 2 + 2, child_dims.y); ++col)
+            out[count++] = {node.level - 1, row, col};
+    }
+    return count;
+}
+
+// find the nearest hit along a ray
+float Graph_bvh::intersect(const glm::vec3 & origin, const glm::vec3 & dir, const Leaf_test & leaf_test,
+    const float max_dist) const
+{
+    const float miss = std::numeric_limits<float>::infinity();
+    float nearest = max_dist;
+
+    if(!_built)
+        return miss;
+
+    const glm::vec3 inv_dir = 1.0f / dir;
+
+    // boxes waiting to be visited, nearest first
+    struct Queued
+    {
+        float dist;
+        Node node;
+        bool operator<(const Queued & other) const { return dist > other.dist; }
+    };
+    std::priority_queue<Queued> queue;
+
+    Node root = {_levels.size() - 1, 0, 0};
+    float root_dist = hit_box(box(root), origin, inv_dir);
+    if(root_dist < nearest)
+        queue.push({root_dist, root});
+
+    while(!queue.empty() && queue.top().dist < nearest)
+    {
+        Node node = queue.top().node;
+        queue.pop();
+
+        if(node.level == 0)
+        {
+            nearest = std::min(nearest, leaf_test(leaf(node.row * _level_dims[0].y + node.col)));
+            continue;
+        }
+
+        Node children[4];
+        size_t num_children = this->children(node, children);
+        for(size_t i = 0; i < num_children; ++i)
+        {
+            float dist = hit_box(box(children[i]), origin, inv_dir);
+            if(dist < nearest)
+                queue.push({dist, children[i]});
+        }
+    }
+
+    return nearest < max_dist ? nearest : miss;
+}
+
+// find pairs of leaves, one from each hierarchy, with overlapping boxes
+std::vector<std::pair<size_t, size_t>> Graph_bvh::overlapping_leaves(const Graph_bvh & a, const Graph_bvh & b)
+{
+    std::vector<std::pair<size_t, size_t>> pairs;
+
+    if(!a._built || !b._built)
+        return pairs;
+
+    auto overlap = [](const Box & box_a, const Box & box_b)
+    {
+        return !box_a.empty() && !box_b.empty()
+            && glm::all(glm::lessThanEqual(box_a.min, box_b.max))
+            && glm::all(glm::lessThanEqual(box_b.min, box_a.max));
+    };
+
+    // split the larger box of an overlapping pair, until both are leaves
+    auto split = [&a, &b, &overlap](const std::pair<Node, Node> & pair, std::vector<std::pair<Node, Node>> & out)
+    {
+        Node children[4];
+        if(pair.first.level >= pair.second.level)
+        {
+            size_t num_children = a.children(pair.first, children);
+            for(size_t i = 0; i < num_children; ++i)
+            {
+                if(overlap(a.box(children[i]), b.box(pair.second)))
+                    out.emplace_back(children[i], pair.second);
+            }
+        }
+        else
+        {
+            size_t num_children = b.children(pair.second, children);
+            for(size_t i = 0; i < num_children; ++i)
+            {
+                if(overlap(a.box(pair.first), b.box(children[i])))
+                    out.emplace_back(pair.first, children[i]);
+            }
+        }
+    };
+
+    auto is_leaf_pair = [](const std::pair<Node, Node> & pair)
+    {
+        return pair.first.level == 0 && pair.second.level == 0;
+    };
+
+    auto leaf_index = [](const Graph_bvh & bvh, const Node & node)
+    {
+        return node.row * bvh._level_dims[0].y + node.col;
+    };
+
+    // split breadth first on this thread until there are enough branches to spread over the pool
+    std::vector<std::pair<Node, Node>> branches;
+    Node root_a = {a._levels.size() - 1, 0, 0};
+    Node root_b = {b._levels.size() - 1, 0, 0};
+    if(overlap(a.box(root_a), b.box(root_b)))
+        branches.emplace_back(root_a, root_b);
+
+    const size_t min_branches = Thread_pool::get().num_threads() * 16;
+    while(branches.size() < min_branches && !std::all_of(branches.begin(), branches.end(), is_leaf_pair))
+    {
+        std::vector<std::pair<Node, Node>> next;
+        for(const auto & pair: branches)
+        {
+            if(is_leaf_pair(pair))
+                next.push_back(pair);
+            else
+                split(pair, next);
+        }
+        branches = std::move(next);
+    }
+
+    // search each branch depth first
+    std::vector<std::vector<std::pair<size_t, size_t>>> branch_pairs(branches.size());
+    Thread_pool::get().parallel_for(0, branches.size(), [&](const size_t i)
+    {
+        std::vector<std::pair<Node, Node>> stack(1, branches[i]);
+        while(!stack.empty())
+        {
+            std::pair<Node, Node> pair = stack.back();
+            stack.pop_back();
+
+            if(is_leaf_pair(pair))
+                branch_pairs[i].emplace_back(leaf_index(a, pair.first), leaf_index(b, pair.second));
+            else
+                split(pair, stack);
+        }
+    });
+
+    for(const auto & p: branch_pairs)
+        pairs.insert(pairs.end(), p.begin(), p.end());
+
+    return pairs;
+}
+
+// distance along the ray to where it enters box, or infinity if it misses
+// slab test. a ray starting inside the box enters it at 0
+float Graph_bvh::hit_box(const Box & box, const glm::vec3 & origin, const glm::vec3 & inv_dir)
+{
+    const float miss = std::numeric_limits<float>::infinity();
+
+    if(box.empty())
+        return miss;
+
+    glm::vec3 t0 = (box.min - origin) * inv_dir;
+    glm::vec3 t1 = (box.max - origin) * inv_dir;
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far = glm::max(t0, t1);
+
+    float enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+    float exit = std::min(std::min(t_far.x, t_far.y), t_far.z);
+
+    return enter <= exit ? enter : miss;
+}
@@ -0,0 +1,132 @@
+// graph_bvh.hpp
+// bounding volume hierarchy over a graph's sampling grid
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef GRAPH_BVH_H
+#define GRAPH_BVH_H
+
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "defined_mask.hpp"
+
+// bounding volume hierarchy over a graph's sampling grid, for picking points with a ray
+// leaves are blocks of leaf_size x leaf_size quads, and each level above merges 2x2 boxes
+// of the level below, like a mipmap, so no tree structure needs to be stored.
+// only the boxes are kept - points are re-evaluated when a ray reaches a leaf
+class Graph_bvh
+{
+public:
+    static const size_t leaf_size = 8;
+
+    // axis aligned bounding box. empty until a point is added
+    struct Box
+    {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+        bool empty() const { return min.x > max.x; }
+        void add(const glm::vec3 & pt) { min = glm::min(min, pt); max = glm::max(max, pt); }
+        void add(const Box & box) { min = glm::min(min, box.min); max = glm::max(max, box.max); }
+    };
+
+    // the points of a leaf: rows [row_begin, row_end) and columns [col_begin, col_end)
+    // neighboring leaves share their edge points
+    struct Leaf
+    {
+        size_t row_begin, row_end;
+        size_t col_begin, col_end;
+    };
+
+    // each quad of the grid is split into 2 triangles, given as (column, row) offsets
+    // from its top left corner
+    static const glm::uvec2 quad_triangles[2][3];
+
+    Graph_bvh() = default;
+
+    // start a new hierarchy for a grid of the given size
+    void begin(const size_t num_rows, const size_t num_columns);
+    // add the defined points of rows [row_begin, row_end) to their leaves
+    // coords and defined start at row_begin
+    void add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined);
+    // build the upper levels once all rows are added
+    void end();
+
+    // false until end is called
+    bool built() const { return _built; }
+
+    size_t num_rows() const { return _num_rows; }
+    size_t num_columns() const { return _num_columns; }
+
+    // bounds of the whole grid's defined points
+    Box bounds() const;
+    // bounds of the leaves holding rows [row_begin, row_end). may be larger than the rows themselves
+    Box rows_bounds(const size_t row_begin, const size_t row_end) const;
+
+    // leaves are numbered row by row
+    size_t num_leaves() const;
+    Leaf leaf(const size_t index) const;
+    const Box & leaf_box(const size_t index) const;
+
+    // find pairs of leaves, one from each hierarchy, with overlapping boxes
+    // both trees are descended together, and split into branches that are searched in parallel
+    static std::vector<std::pair<size_t, size_t>> overlapping_leaves(const Graph_bvh & a, const Graph_bvh & b);
+
+    // called for each leaf the ray might hit. returns the distance along the ray to the
+    // nearest hit inside the leaf, or infinity for none
+    typedef std::function<float(const Leaf &)> Leaf_test;
+
+    // find the nearest hit along a ray. leaves are visited nearest box first, and the
+    // search stops once the remaining boxes are all further than the nearest hit found.
+    // hits at max_dist or further are ignored.
+    // returns the distance to the hit, or infinity if there is none
+    float intersect(const glm::vec3 & origin, const glm::vec3 & dir, const Leaf_test & leaf_test,
+        const float max_dist = std::numeric_limits<float>::infinity()) const;
+
+    // distance along the ray to where it enters box, or infinity if it misses
+    static float hit_box(const Box & box, const glm::vec3 & origin, const glm::vec3 & inv_dir);
+
+private:
+    // a box in one of the levels
+    struct Node
+    {
+        size_t level, row, col;
+    };
+
+    const Box & box(const Node & node) const;
+    // the up to 4 boxes in the level below that make up node
+    size_t children(const Node & node, Node * out) const;
+
+    size_t _num_rows = 0, _num_columns = 0;
+    bool _built = false;
+
+    // boxes for each level, from the leaves up to a single root, stored row by row
+    std::vector<std::vector<Box>> _levels;
+    // rows, columns of boxes in each level
+    std::vector<glm::uvec2> _level_dims;
+};
+
+#endif // GRAPH_BVH_H
@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <iomanip>
+#include <memory>
 #include <sstream>
 
 #include "graph_cartesian.hpp"
@@ -90,7 +91,23 @@ Graph_cartesian::Graph_cartesian(const std::string & eqn,
     _p.DefineVar("y", &_y);
     _p.SetExpr(eqn);
 
-    build_graph();
+    // z is the graph's value, so it can have contour lines
+    _height_field = true;
+
+    // x, y, and tex coords can be calculated from the row and column on the GPU
+    Cartesian_coords sys(_x_min, _x_max, _x_res, _y_min, _y_max, _y_res);
+    _implicit_grid.enabled = true;
+    _implicit_grid.num_columns = _x_res;
+    _implicit_grid.origin = glm::vec2(sys.columns.start, sys.rows.start);
+    _implicit_grid.step = glm::vec2(sys.columns.step, sys.rows.step);
+    _implicit_grid.tex_step = glm::vec2(_x_res > 1 ? 1.0f / (_x_res - 1) : 0.0f, _y_res > 1 ? 1.0f / (_y_res - 1) : 0.0f);
+
+    // initialize cursor
+    _cursor_pos.x = (_x_max - _x_min) / 2.0 + _x_min;
+    _cursor_pos.y = (_y_max - _y_min) / 2.0 + _y_min;
+    _cursor_pos.z = eval(_cursor_pos.x, _cursor_pos.y);
+    _cursor_defined = is_defined(_cursor_pos.z);
+    _signal_cursor_moved.emit(cursor_text());
 }
 
 // evaluate a point on the graph
@@ -109,150 +126,43 @@ double Graph_cartesian::eval(const double x, const double y)
 }
 
 // calculate & build graph geometry
-void Graph_cartesian::build_graph()
+void Graph_cartesian::build_graph(const Tile_sink & sink)
 {
-    // OpenGL needs to be initialized before this is run, hence it's not in the ctor
-    std::vector<glm::vec3> coords(_y_res * _x_res);
-    std::vector<glm::vec2> tex_coords(_y_res * _x_res);
-    std::vector<glm::vec3> normals(_y_res * _x_res);
-    std::vector<bool> defined(_y_res * _x_res);
-
-    // small offsets for calculating normals
-    float h_x = 1e-3f * (_x_max - _x_min) / (float)_x_res;
-    float h_y = 1e-3f * (_y_max - _y_min) / (float)_y_res;
-
-    // calculate coords, texture cords, and normals
-    double y = _y_max;
-    for(size_t y_i = 0; y_i < _y_res; ++y_i, y -= (_y_max - _y_min) / (double)(_y_res - 1))
+    // calculate coords, texture cords, and normals, and pass them on to sink a tile at a time
+    Cartesian_coords sys(_x_min, _x_max, _x_res, _y_min, _y_max, _y_res);
+    build_graph_mesh(sys, [this](const double x, const double y) { return eval(x, y); }, sink);
+}
+
+// sample normals on a finer grid, for a normal map
+void Graph_cartesian::build_normals(const size_t scale, Normal_grid & grid)
+{
+    Cartesian_coords sys(_x_min, _x_max, _x_res, _y_min, _y_max, _y_res);
+    // each thread gets its own parser
+    build_normal_grid(sys, [this]()
     {
-        double x = _x_min;
-        for(size_t x_i = 0; x_i < _x_res; ++x_i,  x += (_x_max - _x_min) / (double)(_x_res - 1))
-        {
-            double z = eval(x, y);
-
-            // check for undefined / infinity
-            if(std::fpclassify(z) != FP_NORMAL &&
-                std::fpclassify(z) != FP_ZERO)
-            {
-                // fallback values
-                coords[y_i * _x_res + x_i] = glm::vec3(0.0f);
-                tex_coords[y_i * _x_res + x_i] = glm::vec2(0.0f);
-                normals[y_i * _x_res + x_i] = glm::vec3(0.0f, 0.0f, 1.0f);
-                // set undefined
-                defined[y_i * _x_res + x_i] = false;
-                continue;
-            }
-
-            // add vertex to lists
-            coords[y_i * _x_res + x_i] = glm::vec3((float)x, (float)y, (float)z);
-            tex_coords[y_i * _x_res + x_i] = glm::vec2((float)((x - _x_min) / (_x_max - _x_min)), (float)((_y_max - y) / (_y_max - _y_min)));
-            defined[y_i * _x_res + x_i] = true;
-
-            // calculate surrounding points for normal calculation
-            glm::vec3 up, dn, lf, rt, ul, ur, ll, lr;
-            bool up_def = false, dn_def = false, lf_def = false, rt_def = false,
-                 ul_def = false, ur_def = false, ll_def = false, lr_def = false;
-
-            // add offsets
-            float l_x = (float)x - h_x;
-            float r_x = (float)x + h_x;
-            float u_y = (float)y + h_y;
-            float d_y = (float)y - h_y;
-
-            // ul
-            z = eval(l_x, u_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ul_def = true;
-                ul = glm::vec3(l_x, u_y, z);
-            }
-
-            // up
-            z = eval(x, u_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                up_def = true;
-                up = glm::vec3(x, u_y, z);
-            }
-
-            // ur
-            z = eval(r_x, u_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ur_def = true;
-                ur = glm::vec3(r_x, u_y, z);
-            }
-
-            // rt
-            z = eval(r_x, y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                rt_def = true;
-                rt = glm::vec3(r_x, y, z);
-            }
-
-            // lr
-            z = eval(r_x, d_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                lr_def = true;
-                lr = glm::vec3(r_x, d_y, z);
-            }
-
-            // dn
-            z = eval(x, d_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                dn_def = true;
-                dn = glm::vec3(x, d_y, z);
-            }
-
-            // ll
-            z = eval(l_x, d_y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ll_def = true;
-                ll = glm::vec3(l_x, d_y, z);
-            }
-
-            // lf
-            z = eval(l_x, y);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                lf_def = true;
-                lf = glm::vec3(l_x, y, z);
-            }
-
-            // get normal
-            normals[y_i * _x_res + x_i] = get_normal(coords[y_i * _x_res + x_i],
-                up, up_def,
-                ur, ur_def,
-                rt, rt_def,
-                lr, lr_def,
-                dn, dn_def,
-                ll, ll_def,
-                lf, lf_def,
-                ul, ul_def);
-        }
-    }
+        std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "x", "y", Graph_exception::EQN));
+        return [p](const double x, const double y) { return p->eval(x, y); };
+    }, scale, grid);
+}
 
-    // build OpenGL geometry data from vertexes
-    build_graph_geometry(_y_res, _x_res, coords, tex_coords, normals, defined);
+// evaluate a point on the graph in cartesian coordinates
+bool Graph_cartesian::eval_point(const double x, const double y, glm::dvec3 & pos)
+{
+    double z = eval(x, y);
+    pos = glm::dvec3(x, y, z);
+    return is_defined(z);
+}
 
-    // initialize cursor
-    _cursor_pos.x = (_x_max - _x_min) / 2.0 + _x_min;
-    _cursor_pos.y = (_y_max - _y_min) / 2.0 + _y_min;
-    _cursor_pos.z = eval(_cursor_pos.x, _cursor_pos.y);
-    _cursor_defined = std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO;
-    _signal_cursor_moved.emit(cursor_text());
+// evaluate points like eval_point, with a parser of its own
+Graph::Point_eval Graph_cartesian::make_point_eval() const
+{
+    std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "x", "y", Graph_exception::EQN));
+    return [p](const double x, const double y, glm::dvec3 & pos)
+    {
+        double z = p->eval(x, y);
+        pos = glm::dvec3(x, y, z);
+        return is_defined(z);
+    };
 }
 
 // cursor funcs
@@ -286,7 +196,19 @@ void Graph_cartesian::move_cursor(const Cursor_dir dir)
 
     // evaluate cursors new position
     _cursor_pos.z = eval(_cursor_pos.x, _cursor_pos.y);
-    _cursor_defined = std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO;
+    _cursor_defined = is_defined(_cursor_pos.z);
+
+    // signal the move
+    _signal_cursor_moved.emit(cursor_text());
+}
+
+void Graph_cartesian::set_cursor(const double x, const double y)
+{
+    // evaluate cursors new position
+    _cursor_pos.x = x;
+    _cursor_pos.y = y;
+    _cursor_pos.z = eval(_cursor_pos.x, _cursor_pos.y);
+    _cursor_defined = is_defined(_cursor_pos.z);
 
     // signal the move
     _signal_cursor_moved.emit(cursor_text());
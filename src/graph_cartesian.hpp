@@ -24,6 +24,37 @@
 #define GRAPH_CARTESIAN_H
 
 #include "graph.hpp"
+#include "graph_sampler.hpp"
+
+// Cartesian coordinate system policy for sample_graph
+// columns are x, rows are y (top to bottom)
+struct Cartesian_coords
+{
+    typedef double Value;
+    typedef float Col_data;
+    typedef float Row_data;
+
+    Cartesian_coords(const double x_min, const double x_max, const size_t x_res,
+        const double y_min, const double y_max, const size_t y_res):
+        columns(x_min, x_max, x_res), rows(y_max, y_min, y_res)
+    {}
+
+    static Col_data col_data(const double x) { return (float)x; }
+    static Row_data row_data(const double y) { return (float)y; }
+
+    static glm::vec3 transform(const Col_data x, const Row_data y, const Value z)
+    {
+        return glm::vec3(x, y, (float)z);
+    }
+
+    glm::vec2 tex_coord(const double x, const double y, const glm::vec3 & pos) const
+    {
+        return glm::vec2((float)((x - columns.start) / (columns.end - columns.start)),
+            (float)((rows.start - y) / (rows.start - rows.end)));
+    }
+
+    Grid_axis columns, rows;
+};
 
 // Cartesian graph class - z(x,y)
 class Graph_cartesian final: public Graph
@@ -36,10 +67,17 @@ public:
     // evaluate a point on the graph
     double eval(const double x, const double y);
     // calculate & build graph geometry
-    void build_graph() override;
+    void build_graph(const Tile_sink & sink) override;
+    // sample normals on a finer grid, for a normal map
+    void build_normals(const size_t scale, Normal_grid & grid) override;
+    // evaluate a point on the graph in cartesian coordinates
+    bool eval_point(const double x, const double y, glm::dvec3 & pos) override;
+    // evaluate points like eval_point, with a parser of its own, for use on other threads
+    Point_eval make_point_eval() const override;
 
     // cursor funcs
     void move_cursor(const Cursor_dir dir) override;
+    void set_cursor(const double x, const double y) override;
     glm::vec3 cursor_pos() const override;
     bool cursor_defined() const override;
     // return cursor position as a string
@@ -0,0 +1,224 @@
+// graph_contours.cpp
+// contour lines over a graph's sampled height grid
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "graph_contours.hpp"
+#include "parallel.hpp"
+
+// start storing a new grid of the given size. drops the old grid and its lines
+void Graph_contours::begin(const size_t num_rows, const size_t num_columns, const Grid_point & grid_point)
+{
+    _num_rows = num_rows;
+    _num_columns = num_columns;
+    _heights.assign(num_rows * num_columns, 0.0f);
+    _defined = Defined_mask(num_rows, num_columns);
+    _grid_point = grid_point;
+    _lines.clear();
+}
+
+// store the heights of rows [row_begin, row_end)
+void Graph_contours::add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined)
+{
+    for(size_t row = row_begin; row < row_end; ++row)
+    {
+        const glm::vec3 * row_coords = coords + (row - row_begin) * _num_columns;
+        float * row_heights = &_heights[row * _num_columns];
+        for(size_t col = 0; col < _num_columns; ++col)
+            row_heights[col] = row_coords[col].z;
+
+        std::copy(defined.row(row - row_begin), defined.row(row - row_begin) + defined.words_per_row(), _defined.row(row));
+    }
+}
+
+// drop the grid and its lines
+void Graph_contours::clear()
+{
+    _num_rows = _num_columns = 0;
+    _heights.clear();
+    _heights.shrink_to_fit();
+    _defined = Defined_mask();
+    _grid_point = nullptr;
+    _lines.clear();
+}
+
+// set the heights to find lines at. lines for levels no longer in the set are dropped
+void Graph_contours::set_levels(const std::vector<float> & levels)
+{
+    _levels = levels;
+    std::sort(_levels.begin(), _levels.end());
+    _levels.erase(std::unique(_levels.begin(), _levels.end()), _levels.end());
+
+    for(auto i = _lines.begin(); i != _lines.end();)
+    {
+        if(std::binary_search(_levels.begin(), _levels.end(), i->first))
+            ++i;
+        else
+            i = _lines.erase(i);
+    }
+}
+
+// line segments for all levels, as pairs of points
+std::vector<glm::vec3> Graph_contours::lines()
+{
+    std::vector<glm::vec3> all_lines;
+    if(!has_grid())
+        return all_lines;
+
+    // find lines for all new levels at once
+    std::vector<float> new_levels;
+    for(auto level: _levels)
+    {
+        if(_lines.count(level) == 0)
+            new_levels.push_back(level);
+    }
+
+    if(!new_levels.empty())
+    {
+        std::vector<std::vector<glm::vec3>> new_lines = march(new_levels);
+        for(size_t i = 0; i < new_levels.size(); ++i)
+            _lines[new_levels[i]] = std::move(new_lines[i]);
+    }
+
+    for(auto level: _levels)
+    {
+        const std::vector<glm::vec3> & lines = _lines[level];
+        all_lines.insert(all_lines.end(), lines.begin(), lines.end());
+    }
+
+    return all_lines;
+}
+
+// find the line segments for each of a sorted set of levels
+// each quad with all 4 corners defined is split by where each level crosses its edges.
+// where opposite corners are on the same side (a saddle), the center decides which way they connect
+std::vector<std::vector<glm::vec3>> Graph_contours::march(const std::vector<float> & levels) const
+{
+    std::vector<std::vector<glm::vec3>> level_lines(levels.size());
+    if(_num_rows < 2 || _num_columns < 2)
+        return level_lines;
+
+    // corners go clockwise from the top left, as (row, column) offsets
+    static const size_t corner_rows[4] = {0, 0, 1, 1};
+    static const size_t corner_cols[4] = {0, 1, 1, 0};
+    // corners at the ends of each edge, lowest index first, so neighboring quads agree on shared edges
+    static const int edge_corners[4][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3}};
+
+    // each row of quads is done separately, and joined at the end. indexed [row][level]
+    std::vector<std::vector<std::vector<glm::vec3>>> row_lines(_num_rows - 1);
+
+    Thread_pool::get().parallel_for(0, _num_rows - 1, [&](const size_t row)
+    {
+        row_lines[row].resize(levels.size());
+
+        for(size_t col = 0; col < _num_columns - 1; ++col)
+        {
+            float h[4];
+            bool all_defined = true;
+            for(int i = 0; i < 4; ++i)
+            {
+                size_t r = row + corner_rows[i], c = col + corner_cols[i];
+                if(!_defined.get(r, c))
+                {
+                    all_defined = false;
+                    break;
+                }
+                h[i] = _heights[r * _num_columns + c];
+            }
+
+            if(!all_defined)
+                continue;
+
+            // a level crosses the quad when some corners are below it, and some are at or above it
+            float low = std::min(std::min(h[0], h[1]), std::min(h[2], h[3]));
+            float high = std::max(std::max(h[0], h[1]), std::max(h[2], h[3]));
+            auto level_begin = std::upper_bound(levels.begin(), levels.end(), low);
+            auto level_end = std::upper_bound(level_begin, levels.end(), high);
+
+            for(auto l = level_begin; l != level_end; ++l)
+            {
+                const float level = *l;
+                std::vector<glm::vec3> & lines = row_lines[row][l - levels.begin()];
+
+                int above = 0;
+                for(int i = 0; i < 4; ++i)
+                {
+                    if(h[i] >= level)
+                        above |= 1 << i;
+                }
+
+                auto crossing = [&](const int edge)
+                {
+                    int a = edge_corners[edge][0], b = edge_corners[edge][1];
+                    float t = (level - h[a]) / (h[b] - h[a]);
+                    return glm::mix(_grid_point(row + corner_rows[a], col + corner_cols[a], level),
+                        _grid_point(row + corner_rows[b], col + corner_cols[b], level), t);
+                };
+
+                // the level crosses every edge whose corners are on different sides
+                int crossed[4], num_crossed = 0;
+                for(int edge = 0; edge < 4; ++edge)
+                {
+                    int a = edge_corners[edge][0], b = edge_corners[edge][1];
+                    if(((above >> a) & 1) != ((above >> b) & 1))
+                        crossed[num_crossed++] = edge;
+                }
+
+                if(num_crossed == 2)
+                {
+                    lines.push_back(crossing(crossed[0]));
+                    lines.push_back(crossing(crossed[1]));
+                }
+                else
+                {
+                    // saddle: cut off the pair of corners on the other side from the center
+                    bool center_above = (h[0] + h[1] + h[2] + h[3]) * 0.25f >= level;
+                    if(((above & 1) != 0) == center_above)
+                    {
+                        // corners 1 and 3
+                        lines.push_back(crossing(0)); lines.push_back(crossing(1));
+                        lines.push_back(crossing(2)); lines.push_back(crossing(3));
+                    }
+                    else
+                    {
+                        // corners 0 and 2
+                        lines.push_back(crossing(3)); lines.push_back(crossing(0));
+                        lines.push_back(crossing(1)); lines.push_back(crossing(2));
+                    }
+                }
+            }
+        }
+    });
+
+    for(size_t l = 0; l < levels.size(); ++l)
+    {
+        size_t total = 0;
+        for(const auto & lines: row_lines)
+            total += lines[l].size();
+
+        level_lines[l].reserve(total);
+        for(const auto & lines: row_lines)
+            level_lines[l].insert(level_lines[l].end(), lines[l].begin(), lines[l].end());
+    }
+
+    return level_lines;
+}
@@ -0,0 +1,84 @@
+// graph_contours.hpp
+// contour lines over a graph's sampled height grid
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef GRAPH_CONTOURS_H
+#define GRAPH_CONTOURS_H
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "defined_mask.hpp"
+
+// contour lines of a height field graph (z for cartesian and cylindrical), found with marching squares
+// the heights are kept once the graph is built, so lines for new levels can be found
+// without evaluating the graph again. lines are kept for each level,
+// so changing the set of levels only finds lines for levels that weren't already there
+class Graph_contours
+{
+public:
+    // position of a grid point at a given height
+    typedef std::function<glm::vec3(const size_t row, const size_t col, const float height)> Grid_point;
+
+    Graph_contours() = default;
+
+    // start storing a new grid of the given size. drops the old grid and its lines
+    void begin(const size_t num_rows, const size_t num_columns, const Grid_point & grid_point);
+    // store the heights of rows [row_begin, row_end). coords and defined start at row_begin
+    void add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined);
+    // drop the grid and its lines
+    void clear();
+
+    // true once a grid has been stored
+    bool has_grid() const { return !_heights.empty(); }
+
+    // set the heights to find lines at. lines for levels no longer in the set are dropped
+    void set_levels(const std::vector<float> & levels);
+    const std::vector<float> & levels() const { return _levels; }
+
+    // line segments for all levels, as pairs of points.
+    // lines are found for any levels that don't have them yet, in parallel over rows
+    std::vector<glm::vec3> lines();
+
+private:
+    // find the line segments for each of a sorted set of levels, in one pass over the grid
+    std::vector<std::vector<glm::vec3>> march(const std::vector<float> & levels) const;
+
+    size_t _num_rows = 0, _num_columns = 0;
+    std::vector<float> _heights;
+    Defined_mask _defined;
+    Grid_point _grid_point;
+
+    std::vector<float> _levels;
+    std::map<float, std::vector<glm::vec3>> _lines;
+
+    // make non-copyable
+    Graph_contours(const Graph_contours &) = delete;
+    Graph_contours(const Graph_contours &&) = delete;
+    Graph_contours & operator=(const Graph_contours &) = delete;
+    Graph_contours & operator=(const Graph_contours &&) = delete;
+};
+
+#endif // GRAPH_CONTOURS_H
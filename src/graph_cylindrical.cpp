@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <iomanip>
+#include <memory>
 #include <sstream>
 
 #include "graph_cylindrical.hpp"
@@ -90,7 +91,17 @@ Graph_cylindrical::Graph_cylindrical(const std::string & eqn,
     _p.DefineVar("theta", &_theta);
     _p.SetExpr(eqn);
 
-    build_graph();
+    // z is the graph's value, so it can have contour lines
+    _height_field = true;
+
+    // initialize cursor
+    _cursor_r =  (_r_max - _r_min) / 2.0 + _r_min;
+    _cursor_theta =  (_theta_max - _theta_min) / 2.0 + _theta_min;
+    _cursor_pos.x = _cursor_r * cosf(_cursor_theta);
+    _cursor_pos.y = _cursor_r * sinf(_cursor_theta);
+    _cursor_pos.z = eval(_cursor_r, _cursor_theta);
+    _cursor_defined = is_defined(_cursor_pos.z);
+    _signal_cursor_moved.emit(cursor_text());
 }
 
 // evaluate a point on the graph
@@ -109,154 +120,43 @@ double Graph_cylindrical::eval(const double r, const double theta)
 }
 
 // calculate & build graph geometry
-void Graph_cylindrical::build_graph()
+void Graph_cylindrical::build_graph(const Tile_sink & sink)
 {
-    // OpenGL needs to be initialized before this is run, hence it's not in the ctor
-    std::vector<glm::vec3> coords(_theta_res * _r_res);
-    std::vector<glm::vec2> tex_coords(_theta_res * _r_res);
-    std::vector<glm::vec3> normals(_theta_res * _r_res);
-    std::vector<bool> defined(_theta_res * _r_res);
-
-    // small offsets for calculating normals
-    float h_r = 1e-3f * (_r_max - _r_min) / (float)_r_res;
-    float h_theta = 1e-3f * (_theta_max - _theta_min) / (float)_theta_res;
+    // calculate coords, texture cords, and normals, and pass them on to sink a tile at a time
+    Cylindrical_coords sys(_r_min, _r_max, _r_res, _theta_min, _theta_max, _theta_res);
+    build_graph_mesh(sys, [this](const double r, const double theta) { return eval(r, theta); }, sink);
+}
 
-    // calculate coords, texture cords, and normals
-    double theta = _theta_max;
-    for(size_t theta_i = 0; theta_i < _theta_res; ++theta_i, theta -= (_theta_max - _theta_min) / (double)(_theta_res - 1))
+// sample normals on a finer grid, for a normal map
+void Graph_cylindrical::build_normals(const size_t scale, Normal_grid & grid)
+{
+    Cylindrical_coords sys(_r_min, _r_max, _r_res, _theta_min, _theta_max, _theta_res);
+    // each thread gets its own parser
+    build_normal_grid(sys, [this]()
     {
-        double r = _r_min;
-        for(size_t r_i = 0; r_i < _r_res; ++r_i,  r += (_r_max - _r_min) / (double)(_r_res - 1))
-        {
-            double z = eval(r, theta);
-
-            // check for undefined / infinity
-            if(std::fpclassify(z) != FP_NORMAL &&
-                std::fpclassify(z) != FP_ZERO)
-            {
-                // fallback values
-                coords[theta_i * _r_res + r_i] = glm::vec3(0.0f);
-                tex_coords[theta_i * _r_res + r_i] = glm::vec2(0.0f);
-                normals[theta_i * _r_res + r_i] = glm::vec3(0.0f, 0.0f, 1.0f);
-                // set undefined
-                defined[theta_i * _r_res + r_i] = false;
-                continue;
-            }
-
-            // convert into cartesian coordinates
-            // add vertex to lists
-            coords[theta_i * _r_res + r_i] = glm::vec3((float)r * cosf(theta), (float)r * sinf(theta), (float)z);
-            tex_coords[theta_i * _r_res + r_i] = glm::vec2((coords[theta_i * _r_res + r_i].x + _r_max) / (float)(2 * _r_max),
-                (_r_max - coords[theta_i * _r_res + r_i].y) / (float)(2 * _r_max));
-            defined[theta_i * _r_res + r_i] = true;
-
-            // calculate surrounding points for normal calculation
-            glm::vec3 up, dn, lf, rt, ul, ur, ll, lr;
-            bool up_def = false, dn_def = false, lf_def = false, rt_def = false,
-                 ul_def = false, ur_def = false, ll_def = false, lr_def = false;
-
-            // add offsets
-            float l_r = (float)r - h_r;
-            float r_r = (float)r + h_r;
-            float u_theta = (float)theta + h_theta;
-            float d_theta = (float)theta - h_theta;
-
-            // ul
-            z = eval(l_r, u_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ul_def = true;
-                ul = glm::vec3(l_r * cosf(u_theta), l_r * sinf(u_theta), z);
-            }
-
-            // up
-            z = eval(r, u_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                up_def = true;
-                up = glm::vec3(r * cosf(u_theta), r * sinf(u_theta), z);
-            }
-
-            // ur
-            z = eval(r_r, u_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ur_def = true;
-                ur = glm::vec3(r_r * cosf(u_theta), r_r * sinf(u_theta), z);
-            }
-
-            // rt
-            z = eval(r_r, theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                rt_def = true;
-                rt = glm::vec3(r_r * cosf(theta), r_r * sinf(theta), z);
-            }
-
-            // lr
-            z = eval(r_r, d_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                lr_def = true;
-                lr = glm::vec3(r_r * cosf(d_theta), r_r * sinf(d_theta), z);
-            }
-
-            // dn
-            z = eval(r, d_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                dn_def = true;
-                dn = glm::vec3(r * cosf(d_theta), r * sinf(d_theta), z);
-            }
-
-            // ll
-            z = eval(l_r, d_theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                ll_def = true;
-                ll = glm::vec3(l_r * cosf(d_theta), l_r * sinf(d_theta), z);
-            }
-
-            // lf
-            z = eval(l_r, theta);
-            if(std::fpclassify(z) == FP_NORMAL ||
-                std::fpclassify(z) == FP_ZERO)
-            {
-                lf_def = true;
-                lf = glm::vec3(l_r * cosf(theta), l_r * sinf(theta), z);
-            }
-
-            // get normal
-            normals[theta_i * _r_res + r_i] = get_normal(coords[theta_i * _r_res + r_i],
-                up, up_def,
-                ur, ur_def,
-                rt, rt_def,
-                lr, lr_def,
-                dn, dn_def,
-                ll, ll_def,
-                lf, lf_def,
-                ul, ul_def);
-        }
-    }
+        std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "r", "theta", Graph_exception::EQN));
+        return [p](const double r, const double theta) { return p->eval(r, theta); };
+    }, scale, grid);
+}
 
-    // build OpenGL geometry data from vertexes
-    build_graph_geometry(_theta_res, _r_res, coords, tex_coords, normals, defined);
+// evaluate a point on the graph in cartesian coordinates
+bool Graph_cylindrical::eval_point(const double r, const double theta, glm::dvec3 & pos)
+{
+    double z = eval(r, theta);
+    pos = glm::dvec3(r * cos(theta), r * sin(theta), z);
+    return is_defined(z);
+}
 
-    // initialize cursor
-    _cursor_r =  (_r_max - _r_min) / 2.0 + _r_min;
-    _cursor_theta =  (_theta_max - _theta_min) / 2.0 + _theta_min;
-    _cursor_pos.x = _cursor_r * cosf(_cursor_theta);
-    _cursor_pos.y = _cursor_r * sinf(_cursor_theta);
-    _cursor_pos.z = eval(_cursor_r, _cursor_theta);
-    _cursor_defined = std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO;
-    _signal_cursor_moved.emit(cursor_text());
+// evaluate points like eval_point, with a parser of its own
+Graph::Point_eval Graph_cylindrical::make_point_eval() const
+{
+    std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "r", "theta", Graph_exception::EQN));
+    return [p](const double r, const double theta, glm::dvec3 & pos)
+    {
+        double z = p->eval(r, theta);
+        pos = glm::dvec3(r * cos(theta), r * sin(theta), z);
+        return is_defined(z);
+    };
 }
 
 // cursor funcs
@@ -292,7 +192,21 @@ void Graph_cylindrical::move_cursor(const Cursor_dir dir)
     _cursor_pos.x = _cursor_r * cosf(_cursor_theta);
     _cursor_pos.y = _cursor_r * sinf(_cursor_theta);
     _cursor_pos.z = eval(_cursor_r, _cursor_theta);
-    _cursor_defined = std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO;
+    _cursor_defined = is_defined(_cursor_pos.z);
+
+    // signal the move
+    _signal_cursor_moved.emit(cursor_text());
+}
+
+void Graph_cylindrical::set_cursor(const double r, const double theta)
+{
+    // evaluate cursors new position
+    _cursor_r = r;
+    _cursor_theta = theta;
+    _cursor_pos.x = _cursor_r * cosf(_cursor_theta);
+    _cursor_pos.y = _cursor_r * sinf(_cursor_theta);
+    _cursor_pos.z = eval(_cursor_r, _cursor_theta);
+    _cursor_defined = is_defined(_cursor_pos.z);
 
     // signal the move
     _signal_cursor_moved.emit(cursor_text());
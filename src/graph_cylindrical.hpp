@@ -24,6 +24,38 @@
 #define GRAPH_CYLINDRICAL_H
 
 #include "graph.hpp"
+#include "graph_sampler.hpp"
+
+// Cylindrical coordinate system policy for sample_graph
+// columns are r, rows are theta (decreasing)
+struct Cylindrical_coords
+{
+    typedef double Value;
+    typedef float Col_data;
+    typedef Sin_cos Row_data;
+
+    Cylindrical_coords(const double r_min, const double r_max, const size_t r_res,
+        const double theta_min, const double theta_max, const size_t theta_res):
+        columns(r_min, r_max, r_res), rows(theta_max, theta_min, theta_res)
+    {}
+
+    static Col_data col_data(const double r) { return (float)r; }
+    static Row_data row_data(const double theta) { return sin_cos(theta); }
+
+    static glm::vec3 transform(const Col_data r, const Row_data & theta, const Value z)
+    {
+        return glm::vec3(r * theta.c, r * theta.s, (float)z);
+    }
+
+    glm::vec2 tex_coord(const double r, const double theta, const glm::vec3 & pos) const
+    {
+        // texture is laid flat over the x-y plane
+        return glm::vec2((pos.x + columns.end) / (float)(2 * columns.end),
+            (columns.end - pos.y) / (float)(2 * columns.end));
+    }
+
+    Grid_axis columns, rows;
+};
 
 // Cylindrical graph class - z(r,θ)
 class Graph_cylindrical final: public Graph
@@ -36,10 +68,17 @@ public:
     // evaluate a point on the graph
     double eval(const double r, const double theta);
     // calculate & build graph geometry
-    void build_graph() override;
+    void build_graph(const Tile_sink & sink) override;
+    // sample normals on a finer grid, for a normal map
+    void build_normals(const size_t scale, Normal_grid & grid) override;
+    // evaluate a point on the graph in cartesian coordinates
+    bool eval_point(const double r, const double theta, glm::dvec3 & pos) override;
+    // evaluate points like eval_point, with a parser of its own, for use on other threads
+    Point_eval make_point_eval() const override;
 
     // cursor funcs
     void move_cursor(const Cursor_dir dir) override;
+    void set_cursor(const double r, const double theta) override;
     glm::vec3 cursor_pos() const override;
     bool cursor_defined() const override;
     // return cursor position as a string
@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <iostream>
+#include <iterator>
 
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/window.h>
@@ -30,6 +31,7 @@
 
 #include "config.hpp"
 #include "graph_disp.hpp"
+#include "packed_vertex.hpp"
 
 extern int return_code; // from main.cpp
 
@@ -98,20 +100,16 @@ void Cursor::build(const std::string & tex_file_name)
         glm::vec3(0.5f, 0.5f, 0.0f),
         glm::vec3(0.5f, -0.5f, 0.0f)
     };
-    std::vector<glm::vec2> tex_coords;
-    std::vector<glm::vec3> normals;
+    std::vector<Packed_vertex> verts;
 
     // assign texture coords and normals
     for(size_t i = 0; i < coords.size(); i += 3)
     {
-        tex_coords.push_back(glm::vec2(0.5f, 1.0f - sqrtf(3.0f) / 2.0f));
-        tex_coords.push_back(glm::vec2(0.0f, 1.0f));
-        tex_coords.push_back(glm::vec2(1.0f, 1.0f));
-
         glm::vec3 norm = glm::normalize(glm::cross(coords[i + 1] - coords[i], coords[i + 2] - coords[i]));
 
-        for(int j = 0; j < 3; ++j)
-            normals.push_back(norm);
+        verts.push_back(pack_vertex(coords[i], glm::vec2(0.5f, 1.0f - sqrtf(3.0f) / 2.0f), norm));
+        verts.push_back(pack_vertex(coords[i + 1], glm::vec2(0.0f, 1.0f), norm));
+        verts.push_back(pack_vertex(coords[i + 2], glm::vec2(1.0f, 1.0f), norm));
     }
 
     // create OpenGL vertex objects
@@ -120,24 +118,10 @@ void Cursor::build(const std::string & tex_file_name)
 
     glGenBuffers(1, &_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size() +
-        sizeof(glm::vec3) * normals.size(), NULL, GL_STATIC_DRAW);
-
-    // store vertex data
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * coords.size(), coords.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size(), sizeof(glm::vec2) * tex_coords.size(), tex_coords.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size(),
-        sizeof(glm::vec3) * normals.size(), normals.data());
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Packed_vertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
 
     // set pointers to coordinates, texture coords, normals
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size()));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(sizeof(glm::vec3) * coords.size() + sizeof(glm::vec2) * tex_coords.size()));
-    glEnableVertexAttribArray(2);
+    set_packed_vertex_attribs();
 
     _num_indexes = coords.size();
 
@@ -189,12 +173,52 @@ void Axes::build()
     glBindVertexArray(0);
 }
 
+Line_strips::Line_strips(): _vao(0), _vbo(0)
+{}
+
+Line_strips::~Line_strips()
+{
+    if(_vao)
+        glDeleteVertexArrays(1, &_vao);
+    if(_vbo)
+        glDeleteBuffers(1, &_vbo);
+}
+
+void Line_strips::build(const std::vector<std::vector<glm::vec3>> & strips)
+{
+    std::vector<glm::vec3> coords;
+    _first.clear();
+    _count.clear();
+
+    for(const auto & strip: strips)
+    {
+        _first.push_back(coords.size());
+        _count.push_back(strip.size());
+        coords.insert(coords.end(), strip.begin(), strip.end());
+    }
+
+    // create OpenGL vertex objects
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+
+    glGenBuffers(1, &_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * coords.size(), coords.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
 Graph_disp::Graph_disp(const sf::VideoMode & mode, const int size_request, const sf::ContextSettings & context_settings):
     SFMLWidget(mode, size_request, context_settings),
-    draw_cursor_flag(true), draw_axes_flag(true), use_orbit_cam(true),
+    draw_cursor_flag(true), draw_axes_flag(true), draw_intersections_flag(false), use_orbit_cam(true),
+    slice_flag(false), slice_normal(0.0f, 0.0f, 1.0f), slice_offset(0.0f),
     cam_light(glm::vec3(1.0f), 0.2f, glm::vec3(0.0f), 1.0f, 0.5f, 0.0f),
     dir_light(glm::vec3(0.5f), 0.2f, glm::vec3(-1.0f)),
-    bkg_color(0.25f, 0.25f, 0.25f), ambient_color(0.4f, 0.4f, 0.4f),
+    bkg_color(0.25f, 0.25f, 0.25f), ambient_color(0.4f, 0.4f, 0.4f), intersection_color(1.0f, 1.0f, 0.0f),
+    slice_color(1.0f, 0.5f, 0.0f),
     _cam(glm::vec3(0.0f, -10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
     _orbit_cam({10.0f, 0.0f, (float)M_PI / 2.0f}), _scale(1.0f), _perspective(1.0f),
     _active_graph(nullptr)
@@ -225,16 +249,47 @@ void Graph_disp::set_active_graph(Graph * graph)
 }
 
 // give and take graphs from the display
-void Graph_disp::add_graph(const Graph * graph)
+void Graph_disp::add_graph(Graph * graph)
 {
     _graphs.insert(graph);
+    update_intersections();
 }
 
-void Graph_disp::remove_graph(const Graph * graph)
+void Graph_disp::remove_graph(Graph * graph)
 {
     if(graph == _active_graph)
         _active_graph = nullptr;
     _graphs.erase(graph);
+
+    // drop any intersections with the graph
+    for(auto i = _intersections.begin(); i != _intersections.end();)
+    {
+        if(i->first.first == graph || i->first.second == graph)
+            i = _intersections.erase(i);
+        else
+            ++i;
+    }
+}
+
+// find the curves where each pair of graphs meet, for any pairs that don't have them yet
+// hidden graphs are included, so that showing them again doesn't need the curves found again
+void Graph_disp::update_intersections()
+{
+    if(!draw_intersections_flag)
+        return;
+
+    for(auto a = _graphs.begin(); a != _graphs.end(); ++a)
+    {
+        for(auto b = std::next(a); b != _graphs.end(); ++b)
+        {
+            auto & curves = _intersections[std::make_pair(*a, *b)];
+            if(!curves)
+            {
+                curves.reset(new Line_strips);
+                curves->build((*a)->intersection_curves(**b));
+            }
+        }
+    }
 }
 
 // reset camera to starting position / orientation
@@ -316,6 +371,9 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     glBlendColor(1.0f, 1.0f, 1.0f, 0.1f);
     glEnable(GL_BLEND);
 
+    // graphs without baked ambient occlusion leave its attribute disabled, and get full light
+    glVertexAttrib2f(3, 1.0f, 1.0f);
+
     // build shader programs
     GLuint graph_vert = compile_shader(check_in_pwd("shaders/graph.vert"), GL_VERTEX_SHADER);
     GLuint line_vert = compile_shader(check_in_pwd("shaders/line.vert"), GL_VERTEX_SHADER);
@@ -323,8 +381,11 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     GLuint tex_frag = compile_shader(check_in_pwd("shaders/tex.frag"), GL_FRAGMENT_SHADER);
     GLuint color_frag = compile_shader(check_in_pwd("shaders/color.frag"), GL_FRAGMENT_SHADER);
     GLuint flat_color_frag = compile_shader(check_in_pwd("shaders/flat_color.frag"), GL_FRAGMENT_SHADER);
+    GLuint slice_geom = compile_shader(check_in_pwd("shaders/slice.geom"), GL_GEOMETRY_SHADER);
+    GLuint normal_geom = compile_shader(check_in_pwd("shaders/normal.geom"), GL_GEOMETRY_SHADER);
 
-    if(graph_vert == 0 || line_vert == 0 || tex_frag == 0 || color_frag == 0 || flat_color_frag == 0)
+    if(graph_vert == 0 || line_vert == 0 || tex_frag == 0 || color_frag == 0 || flat_color_frag == 0 || slice_geom == 0
+        || normal_geom == 0)
     {
         // error messages are displayed by the compile_shader function
         Gtk::MessageDialog error_dialog("Error compiling shaders", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
@@ -342,8 +403,11 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     _prog_tex.prog = link_shader_prog(std::vector<GLuint> {graph_vert, tex_frag, common_frag});
     _prog_color.prog = link_shader_prog(std::vector<GLuint> {graph_vert, color_frag, common_frag});
     _prog_line.prog = link_shader_prog(std::vector<GLuint> {line_vert, flat_color_frag});
+    _prog_slice.prog = link_shader_prog(std::vector<GLuint> {line_vert, slice_geom, flat_color_frag});
+    _prog_normal.prog = link_shader_prog(std::vector<GLuint> {line_vert, normal_geom, flat_color_frag});
 
-    if(_prog_tex.prog == 0 || _prog_color.prog == 0 || _prog_line.prog == 0)
+    if(_prog_tex.prog == 0 || _prog_color.prog == 0 || _prog_line.prog == 0 || _prog_slice.prog == 0
+        || _prog_normal.prog == 0)
     {
         // error messages are displayed by the link_shader_prog function
         Gtk::MessageDialog error_dialog("Error linking shaders", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
@@ -366,6 +430,8 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     glDeleteShader(tex_frag);
     glDeleteShader(color_frag);
     glDeleteShader(flat_color_frag);
+    glDeleteShader(slice_geom);
+    glDeleteShader(normal_geom);
 
     // get uniform locations for each shader
     bool uniform_success = true;
@@ -386,6 +452,20 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     uniform_success &= _prog_tex.add_uniform("dir_light.dir");
     uniform_success &= _prog_tex.add_uniform("dir_light.half_vec");
     uniform_success &= _prog_tex.add_uniform("light_forward");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.enabled");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.num_columns");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.first_row");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.origin");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.step");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.tex_step");
+    uniform_success &= _prog_tex.add_uniform("implicit_grid.line_step");
+    uniform_success &= _prog_tex.add_uniform("grid_lines.enabled");
+    uniform_success &= _prog_tex.add_uniform("grid_lines.density");
+    uniform_success &= _prog_tex.add_uniform("grid_lines.width");
+    uniform_success &= _prog_tex.add_uniform("grid_lines.color");
+    uniform_success &= _prog_tex.add_uniform("use_normal_map");
+    uniform_success &= _prog_tex.add_uniform("normal_map");
+    uniform_success &= _prog_tex.add_uniform("clip_plane");
     check_error("_prog_tex GetUniformLocation");
 
     if(!uniform_success)
@@ -433,6 +513,20 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     uniform_success &= _prog_color.add_uniform("dir_light.dir");
     uniform_success &= _prog_color.add_uniform("dir_light.half_vec");
     uniform_success &= _prog_color.add_uniform("light_forward");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.enabled");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.num_columns");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.first_row");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.origin");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.step");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.tex_step");
+    uniform_success &= _prog_color.add_uniform("implicit_grid.line_step");
+    uniform_success &= _prog_color.add_uniform("grid_lines.enabled");
+    uniform_success &= _prog_color.add_uniform("grid_lines.density");
+    uniform_success &= _prog_color.add_uniform("grid_lines.width");
+    uniform_success &= _prog_color.add_uniform("grid_lines.color");
+    uniform_success &= _prog_color.add_uniform("use_normal_map");
+    uniform_success &= _prog_color.add_uniform("normal_map");
+    uniform_success &= _prog_color.add_uniform("clip_plane");
     check_error("_prog_color GetUniformLocation");
 
     if(!uniform_success)
@@ -465,6 +559,12 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
     uniform_success &= _prog_line.add_uniform("perspective");
     uniform_success &= _prog_line.add_uniform("view_model");
     uniform_success &= _prog_line.add_uniform("color");
+    uniform_success &= _prog_line.add_uniform("implicit_grid.enabled");
+    uniform_success &= _prog_line.add_uniform("implicit_grid.num_columns");
+    uniform_success &= _prog_line.add_uniform("implicit_grid.first_row");
+    uniform_success &= _prog_line.add_uniform("implicit_grid.origin");
+    uniform_success &= _prog_line.add_uniform("implicit_grid.step");
+    uniform_success &= _prog_line.add_uniform("clip_plane");
     check_error("_prog_line GetUniformLocation");
 
     if(!uniform_success)
@@ -493,18 +593,98 @@ bool Graph_disp::initiaize(const Cairo::RefPtr<Cairo::Context> & unused)
         return true;
     }
 
+    uniform_success = true;
+    uniform_success &= _prog_slice.add_uniform("perspective");
+    uniform_success &= _prog_slice.add_uniform("view_model");
+    uniform_success &= _prog_slice.add_uniform("color");
+    uniform_success &= _prog_slice.add_uniform("implicit_grid.enabled");
+    uniform_success &= _prog_slice.add_uniform("implicit_grid.num_columns");
+    uniform_success &= _prog_slice.add_uniform("implicit_grid.first_row");
+    uniform_success &= _prog_slice.add_uniform("implicit_grid.origin");
+    uniform_success &= _prog_slice.add_uniform("implicit_grid.step");
+    uniform_success &= _prog_slice.add_uniform("slice_plane");
+    check_error("_prog_slice GetUniformLocation");
+
+    if(!uniform_success)
+    {
+        std::string missing_uniforms;
+
+        for(auto const & uniform: _prog_slice.uniforms)
+        {
+            if(uniform.second == -1)
+            {
+                missing_uniforms += uniform.first + "\n";
+            }
+        }
+
+        std::cerr<<"Error finding slice shader uniforms:\n"<<missing_uniforms<<std::endl;
+
+        Gtk::MessageDialog error_dialog("Error finding slice shader uniforms", false,
+            Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
+        error_dialog.set_title("Fatal Error");
+        error_dialog.set_secondary_text(missing_uniforms + "Aborting...");
+        error_dialog.run();
+
+        dynamic_cast<Gtk::Window *>(get_toplevel())->hide();
+        return_code = EXIT_FAILURE;
+        return true;
+    }
+
+    uniform_success = true;
+    uniform_success &= _prog_normal.add_uniform("perspective");
+    uniform_success &= _prog_normal.add_uniform("view_model");
+    uniform_success &= _prog_normal.add_uniform("color");
+    uniform_success &= _prog_normal.add_uniform("implicit_grid.enabled");
+    uniform_success &= _prog_normal.add_uniform("implicit_grid.num_columns");
+    uniform_success &= _prog_normal.add_uniform("implicit_grid.first_row");
+    uniform_success &= _prog_normal.add_uniform("implicit_grid.origin");
+    uniform_success &= _prog_normal.add_uniform("implicit_grid.step");
+    uniform_success &= _prog_normal.add_uniform("clip_plane");
+    uniform_success &= _prog_normal.add_uniform("normal_length");
+    check_error("_prog_normal GetUniformLocation");
+
+    if(!uniform_success)
+    {
+        std::string missing_uniforms;
+
+        for(auto const & uniform: _prog_normal.uniforms)
+        {
+            if(uniform.second == -1)
+            {
+                missing_uniforms += uniform.first + "\n";
+            }
+        }
+
+        std::cerr<<"Error finding normal shader uniforms:\n"<<missing_uniforms<<std::endl;
+
+        Gtk::MessageDialog error_dialog("Error finding normal shader uniforms", false,
+            Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
+        error_dialog.set_title("Fatal Error");
+        error_dialog.set_secondary_text(missing_uniforms + "Aborting...");
+        error_dialog.run();
+
+        dynamic_cast<Gtk::Window *>(get_toplevel())->hide();
+        return_code = EXIT_FAILURE;
+        return true;
+    }
+
     // set up un-changing lighting values (in eye space)
     glm::vec3 cam_light_pos_eye(0.0f);
     glm::vec3 light_forward(0.0f, 0.0f, 1.0f);
 
+    // graphs bind their normal maps to texture unit 1. see Graph::draw
     glUseProgram(_prog_tex.prog);
     glUniform3fv(_prog_tex.uniforms["cam_light.pos_eye"], 1, &cam_light_pos_eye[0]);
     glUniform3fv(_prog_tex.uniforms["light_forward"], 1, &light_forward[0]);
+    glUniform1i(_prog_tex.uniforms["normal_map"], 1);
     check_error("_prog_tex uniforms static");
 
     glUseProgram(_prog_color.prog);
     glUniform3fv(_prog_color.uniforms["cam_light.pos_eye"], 1, &cam_light_pos_eye[0]);
     glUniform3fv(_prog_color.uniforms["light_forward"], 1, &light_forward[0]);
+    glUniform1i(_prog_color.uniforms["normal_map"], 1);
     check_error("_prog_color uniforms static");
 
     // create static geometry objects - cursor, axes
@@ -23,9 +23,11 @@
 #ifndef GRAPH_DISP_H
 #define GRAPH_DISP_H
 
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <GL/glew.h>
@@ -129,6 +131,31 @@ private:
     Axes & operator=(const Axes &&) = delete;
 };
 
+// set of line strips, for curves like where graphs intersect
+class Line_strips
+{
+public:
+    Line_strips();
+    ~Line_strips();
+
+    void draw() const;
+    void build(const std::vector<std::vector<glm::vec3>> & strips);
+
+private:
+    // OpenGL stuff
+    GLuint _vao;
+    GLuint _vbo;
+    // first vertex and number of verticies in each strip
+    std::vector<GLint> _first;
+    std::vector<GLsizei> _count;
+
+    // make non-copyable
+    Line_strips(const Line_strips &) = delete;
+    Line_strips(const Line_strips &&) = delete;
+    Line_strips & operator=(const Line_strips &) = delete;
+    Line_strips & operator=(const Line_strips &&) = delete;
+};
+
 // main OpenGL display class
 // all graphics code is done here or in sub-classes
 // is a hybrid of a GTK widget and SFML window
@@ -143,8 +170,13 @@ public:
     void set_active_graph(Graph * graph);
 
     // give and take graphs from the display
-    void add_graph(const Graph * graph);
-    void remove_graph(const Graph * graph);
+    void add_graph(Graph * graph);
+    void remove_graph(Graph * graph);
+
+    // find the curves where each pair of graphs meet, for any pairs that don't have them yet
+    // does nothing unless draw_intersections_flag is set. called when graphs are added,
+    // and needs calling when draw_intersections_flag is turned on
+    void update_intersections();
 
     // reset camera to starting position / orientation
     void reset_cam();
@@ -155,14 +187,24 @@ public:
     // display settings
     bool draw_cursor_flag;
     bool draw_axes_flag;
+    bool draw_intersections_flag;
     bool use_orbit_cam;
 
+    // plane cutting through all graphs, where dot(slice_normal, pos) == slice_offset
+    // graphs are hidden on the side the normal points to, and drawn in outline where they cross it.
+    // dragging with the right mouse button moves it. hold ctrl to turn it instead
+    bool slice_flag;
+    glm::vec3 slice_normal;
+    float slice_offset;
+
     // lighting vars
     Point_light cam_light;
     Dir_light dir_light;
 
     glm::vec3 bkg_color;
     glm::vec3 ambient_color;
+    glm::vec3 intersection_color;
+    glm::vec3 slice_color;
 
 private:
     // called when OpenGL context is ready and GTK widget is ready
@@ -172,10 +214,17 @@ private:
     // drawing setup code
     void graph_draw_setup(std::unordered_map<std::string, GLint> & uniforms,
         const Graph & graph);
+    // set implicit grid uniforms. a default constructed grid disables it
+    void implicit_grid_setup(std::unordered_map<std::string, GLint> & uniforms,
+        const Graph::Implicit_grid & grid, const bool use_tex_coords);
+    // camera & zoom transformation
+    glm::mat4 view_model() const;
     // main drawing code
     bool draw(const Cairo::RefPtr<Cairo::Context> & unused);
     // main input processing
     bool input();
+    // move the active graph's cursor to the point under the mouse, if it's the nearest graph there
+    void pick(const sf::Vector2i & mouse_pos);
     // GTK key press handler
     bool key_press(GdkEventKey * e);
 
@@ -183,6 +232,8 @@ private:
     Shader_prog _prog_tex;
     Shader_prog _prog_color;
     Shader_prog _prog_line;
+    Shader_prog _prog_slice;
+    Shader_prog _prog_normal;
 
     // static geometry
     Cursor _cursor;
@@ -196,7 +247,10 @@ private:
 
     // storage for graphs (we do not own them here)
     Graph * _active_graph;
-    std::set<const Graph *> _graphs;
+    std::set<Graph *> _graphs;
+
+    // curves where each pair of graphs meet, built by update_intersections
+    std::map<std::pair<Graph *, Graph *>, std::unique_ptr<Line_strips>> _intersections;
 
     // used for initializing, and then drawing
     sigc::connection _draw_connection;
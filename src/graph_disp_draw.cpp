@@ -34,6 +34,13 @@ void Cursor::draw() const
     glBindVertexArray(0);
 }
 
+void Line_strips::draw() const
+{
+    glBindVertexArray(_vao);
+    glMultiDrawArrays(GL_LINE_STRIP, _first.data(), _count.data(), _first.size());
+    glBindVertexArray(0);
+}
+
 void Axes::draw() const
 {
     // load the vertices and texture
@@ -54,20 +61,43 @@ void Graph_disp::graph_draw_setup(std::unordered_map<std::string, GLint> & unifo
     }
     glUniform1f(uniforms["material.shininess"], graph.shininess);
     glUniform3fv(uniforms["material.specular"], 1, &graph.specular[0]);
+
+    // gridlines drawn along with the surface
+    glUniform1i(uniforms["grid_lines.enabled"], graph.draw_grid_flag && graph.shader_grid_flag);
+    glUniform1f(uniforms["grid_lines.density"], graph.grid_density);
+    glUniform1f(uniforms["grid_lines.width"], graph.grid_width);
+    glUniform3fv(uniforms["grid_lines.color"], 1, &graph.grid_color[0]);
+
+    glUniform1i(uniforms["use_normal_map"], graph.has_normal_map());
 }
 
-// main drawing code
-bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
+void Graph_disp::implicit_grid_setup(std::unordered_map<std::string, GLint> & uniforms,
+    const Graph::Implicit_grid & grid, const bool use_tex_coords)
 {
-    // set up global lights
-    glClearColor(bkg_color.r, bkg_color.g, bkg_color.b, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUniform1i(uniforms["implicit_grid.enabled"], grid.enabled);
 
-    // set restart marker
-    glEnable(GL_PRIMITIVE_RESTART);
-    glPrimitiveRestartIndex(0xFFFFFFFF);
+    // programs with tex coords draw gridlines too, which only need the vertex's row and column
+    bool line_coords = use_tex_coords && grid.line_step != glm::vec2(0.0f);
+    if(use_tex_coords)
+        glUniform2fv(uniforms["implicit_grid.line_step"], 1, &grid.line_step[0]);
 
-    // set up viewmodel matrices
+    if(!grid.enabled && !line_coords)
+        return;
+
+    glUniform1i(uniforms["implicit_grid.num_columns"], grid.num_columns);
+    glUniform1i(uniforms["implicit_grid.first_row"], grid.first_row);
+    if(!grid.enabled)
+        return;
+
+    glUniform2fv(uniforms["implicit_grid.origin"], 1, &grid.origin[0]);
+    glUniform2fv(uniforms["implicit_grid.step"], 1, &grid.step[0]);
+    if(use_tex_coords)
+        glUniform2fv(uniforms["implicit_grid.tex_step"], 1, &grid.tex_step[0]);
+}
+
+// camera & zoom transformation
+glm::mat4 Graph_disp::view_model() const
+{
     glm::mat4 view_model;
     if(use_orbit_cam)
     {
@@ -78,7 +108,22 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
     {
         view_model = _cam.view_mat();
     }
-    view_model = glm::scale(view_model, glm::vec3(_scale));
+    return glm::scale(view_model, glm::vec3(_scale));
+}
+
+// main drawing code
+bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
+{
+    // set up global lights
+    glClearColor(bkg_color.r, bkg_color.g, bkg_color.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // set restart marker
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(restart_index);
+
+    // set up viewmodel matrices
+    glm::mat4 view_model = this->view_model();
 
     glm::mat4 view_model_perspective = _perspective * view_model;
     glm::mat3 normal_transform = glm::transpose(glm::inverse(glm::mat3(view_model)));
@@ -89,6 +134,9 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
     glm::vec3 dir_light_dir = normal_transform * glm::normalize(-dir_light.dir);
     glm::vec3 dir_half_vec = glm::normalize(light_forward + dir_light_dir);
 
+    // the side of the slicing plane that the normal points to is clipped away
+    glm::vec4 clip_plane(-slice_normal, slice_offset);
+
     // send per-frame (view and light) uniforms to GPU
     glUseProgram(_prog_tex.prog);
     glUniformMatrix4fv(_prog_tex.uniforms["view_model_perspective"], 1, GL_FALSE, &view_model_perspective[0][0]);
@@ -104,6 +152,7 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
     glUniform1f(_prog_tex.uniforms["dir_light.base.strength"], dir_light.strength);
     glUniform3fv(_prog_tex.uniforms["dir_light.dir"], 1, &dir_light_dir[0]);
     glUniform3fv(_prog_tex.uniforms["dir_light.half_vec"], 1, &dir_half_vec[0]);
+    glUniform4fv(_prog_tex.uniforms["clip_plane"], 1, &clip_plane[0]);
 
     glUseProgram(_prog_color.prog);
     glUniformMatrix4fv(_prog_color.uniforms["view_model_perspective"], 1, GL_FALSE, &view_model_perspective[0][0]);
@@ -119,10 +168,24 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
     glUniform1f(_prog_color.uniforms["dir_light.base.strength"], dir_light.strength);
     glUniform3fv(_prog_color.uniforms["dir_light.dir"], 1, &dir_light_dir[0]);
     glUniform3fv(_prog_color.uniforms["dir_light.half_vec"], 1, &dir_half_vec[0]);
+    glUniform4fv(_prog_color.uniforms["clip_plane"], 1, &clip_plane[0]);
 
     glUseProgram(_prog_line.prog);
     glUniformMatrix4fv(_prog_line.uniforms["perspective"], 1, GL_FALSE, &_perspective[0][0]);
     glUniformMatrix4fv(_prog_line.uniforms["view_model"], 1, GL_FALSE, &view_model[0][0]);
+    glUniform4fv(_prog_line.uniforms["clip_plane"], 1, &clip_plane[0]);
+
+    glm::vec4 slice_plane(slice_normal, -slice_offset);
+    glUseProgram(_prog_slice.prog);
+    glUniformMatrix4fv(_prog_slice.uniforms["perspective"], 1, GL_FALSE, &_perspective[0][0]);
+    glUniformMatrix4fv(_prog_slice.uniforms["view_model"], 1, GL_FALSE, &view_model[0][0]);
+    glUniform4fv(_prog_slice.uniforms["slice_plane"], 1, &slice_plane[0]);
+    glUniform3fv(_prog_slice.uniforms["color"], 1, &slice_color[0]);
+
+    glUseProgram(_prog_normal.prog);
+    glUniformMatrix4fv(_prog_normal.uniforms["perspective"], 1, GL_FALSE, &_perspective[0][0]);
+    glUniformMatrix4fv(_prog_normal.uniforms["view_model"], 1, GL_FALSE, &view_model[0][0]);
+    glUniform4fv(_prog_normal.uniforms["clip_plane"], 1, &clip_plane[0]);
 
     // draw axes
     if(draw_axes_flag)
@@ -130,12 +193,17 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
         glUseProgram(_prog_line.prog);
 
         glUniform3fv(_prog_line.uniforms["color"], 1, &_axes.color[0]);
+        implicit_grid_setup(_prog_line.uniforms, Graph::Implicit_grid(), false);
 
         _axes.draw();
 
         check_error("draw axes");
     }
 
+    // graphs are clipped by the slicing plane
+    if(slice_flag)
+        glEnable(GL_CLIP_DISTANCE0);
+
     // draw opaque graphs
     for(auto &graph: _graphs)
     {
@@ -158,17 +226,24 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
                 }
                 check_error("draw geometry");
 
-                graph->draw();
+                auto & uniforms = graph->use_tex && graph->valid_tex ? _prog_tex.uniforms : _prog_color.uniforms;
+                graph->draw([this, &uniforms](const Graph::Implicit_grid & grid)
+                {
+                    implicit_grid_setup(uniforms, grid, true);
+                });
             }
 
-            // draw grid
-            if(graph->draw_grid_flag)
+            // draw grid, unless the surface's shader already has
+            if(graph->draw_grid_flag && !graph->shader_grid_flag)
             {
                 // switch to line shader
                 glUseProgram(_prog_line.prog);
                 glUniform3fv(_prog_line.uniforms["color"], 1, &graph->grid_color[0]);
 
-                graph->draw_grid();
+                graph->draw_grid([this](const Graph::Implicit_grid & grid)
+                {
+                    implicit_grid_setup(_prog_line.uniforms, grid, false);
+                });
                 check_error("draw grid");
             }
         }
@@ -176,13 +251,72 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
         // draw normal vectors
         if(graph->draw_normals_flag)
         {
-            // switch to line shader
-            glUseProgram(_prog_line.prog);
-            glUniform3fv(_prog_line.uniforms["color"], 1, &graph->normal_color[0]);
+            // switch to normal shader
+            glUseProgram(_prog_normal.prog);
+            glUniform3fv(_prog_normal.uniforms["color"], 1, &graph->normal_color[0]);
+            glUniform1f(_prog_normal.uniforms["normal_length"], graph->normal_length);
 
-            graph->draw_normals();
+            graph->draw_normals([this](const Graph::Implicit_grid & grid)
+            {
+                implicit_grid_setup(_prog_normal.uniforms, grid, false);
+            });
             check_error("draw normals");
         }
+
+        // draw contour lines
+        if(graph->draw_contours_flag)
+        {
+            glUseProgram(_prog_line.prog);
+            glUniform3fv(_prog_line.uniforms["color"], 1, &graph->contour_color[0]);
+            implicit_grid_setup(_prog_line.uniforms, Graph::Implicit_grid(), false);
+
+            graph->draw_contours();
+            check_error("draw contours");
+        }
+    }
+
+    // draw curves where graphs meet
+    if(draw_intersections_flag)
+    {
+        glUseProgram(_prog_line.prog);
+        glUniform3fv(_prog_line.uniforms["color"], 1, &intersection_color[0]);
+        implicit_grid_setup(_prog_line.uniforms, Graph::Implicit_grid(), false);
+
+        for(auto a = _graphs.begin(); a != _graphs.end(); ++a)
+        {
+            for(auto b = std::next(a); b != _graphs.end(); ++b)
+            {
+                if(!(*a)->draw_flag || !(*b)->draw_flag)
+                    continue;
+
+                // curves are found ahead of time by update_intersections
+                auto curves = _intersections.find(std::make_pair(*a, *b));
+                if(curves != _intersections.end())
+                    curves->second->draw();
+            }
+        }
+        check_error("draw intersections");
+    }
+
+    // the cursor and the slice outlines aren't clipped
+    glDisable(GL_CLIP_DISTANCE0);
+
+    // draw where graphs cross the slicing plane
+    if(slice_flag)
+    {
+        glUseProgram(_prog_slice.prog);
+
+        for(auto & graph: _graphs)
+        {
+            if(!graph->draw_flag)
+                continue;
+
+            graph->draw_slice(slice_normal, slice_offset, [this](const Graph::Implicit_grid & grid)
+            {
+                implicit_grid_setup(_prog_slice.uniforms, grid, false);
+            });
+        }
+        check_error("draw slice");
     }
 
     // draw cursor
@@ -201,6 +335,9 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
         // material properties
         glUniform1f(_prog_tex.uniforms["material.shininess"], _cursor.shininess);
         glUniform3fv(_prog_tex.uniforms["material.specular"], 1, &_cursor.specular[0]);
+        glUniform1i(_prog_tex.uniforms["grid_lines.enabled"], false);
+        glUniform1i(_prog_tex.uniforms["use_normal_map"], false);
+        implicit_grid_setup(_prog_tex.uniforms, Graph::Implicit_grid(), true);
 
         _cursor.draw();
         check_error("draw cursor");
@@ -222,6 +359,9 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
     glDepthMask(GL_FALSE);
     glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE);
 
+    if(slice_flag)
+        glEnable(GL_CLIP_DISTANCE0);
+
     // 2nd pass to draw transparent graphs
     for(auto &graph: _graphs)
     {
@@ -246,23 +386,31 @@ bool Graph_disp::draw(const Cairo::RefPtr<Cairo::Context> & unused)
                 }
                 check_error("draw transparent geometry");
 
-                graph->draw();
+                auto & uniforms = graph->use_tex && graph->valid_tex ? _prog_tex.uniforms : _prog_color.uniforms;
+                graph->draw([this, &uniforms](const Graph::Implicit_grid & grid)
+                {
+                    implicit_grid_setup(uniforms, grid, true);
+                });
             }
 
-            // draw grid
-            if(graph->draw_grid_flag)
+            // draw grid, unless the surface's shader already has
+            if(graph->draw_grid_flag && !graph->shader_grid_flag)
             {
                 // switch to line shader
                 glUseProgram(_prog_line.prog);
                 glUniform3fv(_prog_line.uniforms["color"], 1, &graph->grid_color[0]);
 
-                graph->draw_grid();
+                graph->draw_grid([this](const Graph::Implicit_grid & grid)
+                {
+                    implicit_grid_setup(_prog_line.uniforms, grid, false);
+                });
                 check_error("draw grid");
             }
         }
     }
 
     // restore settings
+    glDisable(GL_CLIP_DISTANCE0);
     glDepthMask(old_depth_mask);
     glBlendFunc(old_blend_func_src, old_blend_func_dst);
     glBlendColor(old_blend_color.r, old_blend_color.g, old_blend_color.b, old_blend_color.a);
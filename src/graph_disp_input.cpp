@@ -20,6 +20,8 @@
 // IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <cstdlib>
+
 #include "graph_disp.hpp"
 
 // main input processing
@@ -30,6 +32,8 @@ bool Graph_disp::input()
     static sf::Vector2i old_mouse_pos = sf::Mouse::getPosition(glWindow);
     static sf::Clock cursor_delay;
     static sf::Clock zoom_delay;
+    static bool mouse_down = false;
+    static sf::Vector2i mouse_down_pos;
 
     // the neat thing about having this in a timeout func is that we
     // don't need to calculate dt for movement controls.
@@ -224,6 +228,32 @@ bool Graph_disp::input()
                 invalidate();
             }
 
+            // drag the slicing plane along its normal with the right mouse button
+            if(slice_flag && sf::Mouse::isButtonPressed(sf::Mouse::Right))
+            {
+                int d_x = new_mouse_pos.x - old_mouse_pos.x;
+                int d_y = new_mouse_pos.y - old_mouse_pos.y;
+
+                if(d_x != 0 || d_y != 0)
+                {
+                    if(sf::Keyboard::isKeyPressed(sf::Keyboard::LControl))
+                    {
+                        // turn it around the z axis, and tilt it towards or away from the z axis
+                        glm::vec3 tilt_axis = glm::cross(slice_normal, glm::vec3(0.0f, 0.0f, 1.0f));
+                        if(glm::length(tilt_axis) < 1e-3f)
+                            tilt_axis = glm::vec3(1.0f, 0.0f, 0.0f);
+
+                        glm::mat4 rot = glm::rotate(glm::rotate(glm::mat4(1.0f), 0.005f * d_x, glm::vec3(0.0f, 0.0f, 1.0f)),
+                            0.005f * d_y, glm::normalize(tilt_axis));
+                        slice_normal = glm::normalize(glm::vec3(rot * glm::vec4(slice_normal, 0.0f)));
+                    }
+                    else
+                        slice_offset -= mov_scale * 0.1f * d_y / _scale;
+
+                    invalidate();
+                }
+            }
+
             // move cursor with arrow keys
             if(draw_cursor_flag && _active_graph)
             {
@@ -256,12 +286,65 @@ bool Graph_disp::input()
                     invalidate();
                 }
             }
+
+            // place cursor by clicking on the graph. clicks that drag rotate the view instead
+            bool mouse_pressed = sf::Mouse::isButtonPressed(sf::Mouse::Left);
+            if(mouse_pressed && !mouse_down)
+            {
+                mouse_down_pos = new_mouse_pos;
+            }
+            else if(!mouse_pressed && mouse_down && draw_cursor_flag && _active_graph)
+            {
+                const int click_radius = 2;
+                if(std::abs(new_mouse_pos.x - mouse_down_pos.x) <= click_radius &&
+                    std::abs(new_mouse_pos.y - mouse_down_pos.y) <= click_radius)
+                {
+                    pick(new_mouse_pos);
+                }
+            }
+            mouse_down = mouse_pressed;
         }
         old_mouse_pos = new_mouse_pos;
     }
     return true;
 }
 
+// move the active graph's cursor to the point under the mouse, if it's the nearest graph there
+void Graph_disp::pick(const sf::Vector2i & mouse_pos)
+{
+    // un-project the mouse position onto the near and far planes to get a ray in graph coordinates
+    glm::mat4 inv_view_model_perspective = glm::inverse(_perspective * view_model());
+    glm::vec2 screen_pos(2.0f * (mouse_pos.x + 0.5f) / (float)get_allocated_width() - 1.0f,
+        1.0f - 2.0f * (mouse_pos.y + 0.5f) / (float)get_allocated_height());
+
+    glm::vec4 near_pos = inv_view_model_perspective * glm::vec4(screen_pos, -1.0f, 1.0f);
+    glm::vec4 far_pos = inv_view_model_perspective * glm::vec4(screen_pos, 1.0f, 1.0f);
+
+    glm::vec3 origin = glm::vec3(near_pos) / near_pos.w;
+    glm::vec3 dir = glm::normalize(glm::vec3(far_pos) / far_pos.w - origin);
+
+    // find the nearest hit over all visible graphs, so graphs in front block the ones behind
+    Graph * nearest_graph = nullptr;
+    Graph::Ray_hit nearest_hit;
+    for(auto & graph: _graphs)
+    {
+        Graph::Ray_hit hit;
+        if(graph->draw_flag && graph->intersect(origin, dir, hit) &&
+            (!nearest_graph || hit.dist < nearest_hit.dist))
+        {
+            nearest_graph = graph;
+            nearest_hit = hit;
+        }
+    }
+
+    // the cursor only moves on the active graph
+    if(nearest_graph && nearest_graph == _active_graph)
+    {
+        _active_graph->set_cursor(nearest_hit.col_param, nearest_hit.row_param);
+        invalidate();
+    }
+}
+
 // GTK key press handler
 bool Graph_disp::key_press(GdkEventKey * e)
 {
@@ -0,0 +1,445 @@
+// graph_implicit.cpp
+// implicit surface graph class (F(X, Y, Z) = 0)
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "graph_implicit.hpp"
+#include "marching_cubes.hpp"
+#include "parallel.hpp"
+
+// cells along each side of a block. blocks are what the coarse pass finds near the surface,
+// and what is handed out to threads
+static const size_t block_cells = 8;
+
+// a parser for the equation, with its own variables, so that each thread can have one
+// the parser holds pointers to the variables, so this can't be moved once created
+struct Field_parser
+{
+    explicit Field_parser(const std::string & eqn)
+    {
+        p.DefineConst("pi", M_PI);
+        p.DefineConst("e", M_E);
+        p.DefineVar("x", &x);
+        p.DefineVar("y", &y);
+        p.DefineVar("z", &z);
+        p.SetExpr(eqn);
+    }
+
+    double eval(const glm::dvec3 & pos)
+    {
+        x = pos.x; y = pos.y; z = pos.z;
+        try
+        {
+            return p.Eval();
+        }
+        catch(const mu::Parser::exception_type & e)
+        {
+            Graph_exception ge(e, Graph_exception::EQN);
+            throw ge;
+        }
+    }
+
+    mu::Parser p;
+    double x = 0.0, y = 0.0, z = 0.0;
+};
+
+// call func(parser, i) for each i in [0, count), split over the thread pool
+// muparser objects can't be shared between threads, so each call gets a parser to itself
+template<typename Func>
+static void parallel_eval(std::vector<std::unique_ptr<Field_parser>> & parsers, const size_t count, const Func & func)
+{
+    Thread_pool::get().parallel_for(parsers, 0, count, [&func](std::unique_ptr<Field_parser> & parser, const size_t i)
+    {
+        func(*parser, i);
+    });
+}
+
+// the lattice of samples filling the graph's box
+struct Sample_grid
+{
+    glm::dvec3 origin, step;
+    // cells along each axis, and the same in blocks, rounded up
+    size_t cells, blocks;
+
+    glm::dvec3 pos(const glm::uvec3 & sample) const
+    {
+        return origin + step * glm::dvec3(sample);
+    }
+
+    // first sample of a block. the last block along each axis may be cut short
+    glm::uvec3 block_sample(const glm::uvec3 & block) const
+    {
+        return glm::min(block * (unsigned int)block_cells, glm::uvec3(cells));
+    }
+
+    glm::uvec3 block_coords(const size_t block) const
+    {
+        return glm::uvec3(block % blocks, (block / blocks) % blocks, block / (blocks * blocks));
+    }
+};
+
+// surface found in one block, with indexes relative to its first vertex
+struct Block_mesh
+{
+    std::vector<glm::vec3> coords;
+    std::vector<glm::vec3> normals;
+    std::vector<GLushort> index;
+};
+
+// find which blocks may hold part of the surface, from the field at their corners
+// a block is kept when the corner nearest 0 could reach it within the block's diagonal, going by the
+// steepest slope along the block's edges. features smaller than a block that don't cross its edges can be missed
+static std::vector<size_t> find_active_blocks(const Sample_grid & grid, std::vector<std::unique_ptr<Field_parser>> & parsers)
+{
+    const size_t corners = grid.blocks + 1;
+    std::vector<double> vals(corners * corners * corners);
+
+    parallel_eval(parsers, corners, [&](Field_parser & parser, const size_t z)
+    {
+        for(size_t y = 0; y < corners; ++y)
+        {
+            for(size_t x = 0; x < corners; ++x)
+                vals[(z * corners + y) * corners + x] = parser.eval(grid.pos(grid.block_sample(glm::uvec3(x, y, z))));
+        }
+    });
+
+    const size_t num_blocks = grid.blocks * grid.blocks * grid.blocks;
+    std::vector<char> active(num_blocks);
+
+    Thread_pool::get().parallel_for(0, num_blocks, [&](const size_t block)
+    {
+        glm::uvec3 coords = grid.block_coords(block);
+        glm::dvec3 size = glm::dvec3(grid.block_sample(coords + 1u) - grid.block_sample(coords)) * grid.step;
+
+        double corner_vals[8];
+        double min_abs = std::numeric_limits<double>::infinity();
+        for(int c = 0; c < 8; ++c)
+        {
+            glm::uvec3 corner = coords + glm::uvec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+            corner_vals[c] = vals[(corner.z * corners + corner.y) * corners + corner.x];
+
+            // search blocks with undefined corners, in case the surface is near
+            if(!std::isfinite(corner_vals[c]))
+            {
+                active[block] = true;
+                return;
+            }
+            min_abs = std::min(min_abs, std::abs(corner_vals[c]));
+        }
+
+        glm::dvec3 slope(0.0);
+        for(int e = 0; e < 12; ++e)
+        {
+            const int axis = e / 4;
+            double diff = std::abs(corner_vals[marching_cubes_edges[e][1]] - corner_vals[marching_cubes_edges[e][0]]);
+            slope[axis] = std::max(slope[axis], diff / size[axis]);
+        }
+
+        active[block] = min_abs <= glm::length(slope) * glm::length(size);
+    });
+
+    std::vector<size_t> active_blocks;
+    for(size_t block = 0; block < num_blocks; ++block)
+    {
+        if(active[block])
+            active_blocks.push_back(block);
+    }
+
+    return active_blocks;
+}
+
+// run marching cubes over one block's cells. inside the surface is where the field is negative,
+// so the gradient points out of it, and is used for the normals
+static void march_block(const Sample_grid & grid, const size_t block, Field_parser & parser, Block_mesh & mesh)
+{
+    const auto & table = marching_cubes_table();
+
+    const glm::uvec3 first = grid.block_sample(grid.block_coords(block));
+    const glm::uvec3 dims = grid.block_sample(grid.block_coords(block) + 1u) - first + 1u;
+
+    auto sample_index = [&dims](const glm::uvec3 & s)
+    {
+        return ((size_t)s.z * dims.y + s.y) * dims.x + s.x;
+    };
+
+    std::vector<double> vals(dims.x * dims.y * dims.z);
+    for(unsigned int z = 0; z < dims.z; ++z)
+    {
+        for(unsigned int y = 0; y < dims.y; ++y)
+        {
+            for(unsigned int x = 0; x < dims.x; ++x)
+                vals[sample_index(glm::uvec3(x, y, z))] = parser.eval(grid.pos(first + glm::uvec3(x, y, z)));
+        }
+    }
+
+    // vertex on each edge, indexed by the edge's first sample * 3 + axis. neighboring cells share these
+    std::vector<int> edge_verts(vals.size() * 3, -1);
+
+    auto edge_vert = [&](const glm::uvec3 & cell, const int edge)
+    {
+        const int axis = edge / 4;
+        const unsigned char c = marching_cubes_edges[edge][0];
+        const glm::uvec3 a = cell + glm::uvec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+        glm::uvec3 b = a;
+        ++b[axis];
+
+        int & vert = edge_verts[sample_index(a) * 3 + axis];
+        if(vert >= 0)
+            return (GLushort)vert;
+
+        vert = (int)mesh.coords.size();
+
+        // positions are found from the grid position, so neighboring blocks agree on shared edges
+        const double val_a = vals[sample_index(a)], val_b = vals[sample_index(b)];
+        const glm::dvec3 pos_a = grid.pos(first + a), pos_b = grid.pos(first + b);
+        const glm::dvec3 pos = pos_a + (pos_b - pos_a) * (val_a / (val_a - val_b));
+
+        // central differences, with a step well inside a cell
+        glm::dvec3 gradient;
+        for(int i = 0; i < 3; ++i)
+        {
+            glm::dvec3 h(0.0);
+            h[i] = 0.25 * grid.step[i];
+            gradient[i] = (parser.eval(pos + h) - parser.eval(pos - h)) / (2.0 * h[i]);
+        }
+
+        // fall back to the direction the field increases along the edge
+        double length = glm::length(gradient);
+        glm::vec3 normal;
+        if(std::isfinite(length) && length > 0.0)
+            normal = glm::vec3(gradient / length);
+        else
+            normal = glm::vec3(glm::normalize(pos_b - pos_a) * (val_b > val_a ? 1.0 : -1.0));
+
+        mesh.coords.push_back(glm::vec3(pos));
+        mesh.normals.push_back(normal);
+        return (GLushort)vert;
+    };
+
+    for(unsigned int z = 0; z + 1 < dims.z; ++z)
+    {
+        for(unsigned int y = 0; y + 1 < dims.y; ++y)
+        {
+            for(unsigned int x = 0; x + 1 < dims.x; ++x)
+            {
+                const glm::uvec3 cell(x, y, z);
+
+                unsigned int inside = 0;
+                bool defined = true;
+                for(int c = 0; c < 8; ++c)
+                {
+                    double val = vals[sample_index(cell + glm::uvec3(c & 1, (c >> 1) & 1, (c >> 2) & 1))];
+                    defined &= std::isfinite(val);
+                    inside |= (val < 0.0) << c;
+                }
+
+                if(!defined)
+                    continue;
+
+                const Marching_cubes_case & cube = table[inside];
+                for(int t = 0; t < cube.num_triangles; ++t)
+                {
+                    for(int i = 0; i < 3; ++i)
+                        mesh.index.push_back(edge_vert(cell, cube.edges[t][i]));
+                }
+            }
+        }
+    }
+}
+
+Graph_implicit::Graph_implicit(const std::string & eqn,
+    const std::string & x_min, const std::string & x_max,
+    const std::string & y_min, const std::string & y_max,
+    const std::string & z_min, const std::string & z_max, size_t res):
+    _eqn(eqn), _res(std::max<size_t>(2, std::min(res, max_samples)))
+{
+    mu::Parser p;
+    p.DefineConst("pi", M_PI);
+    p.DefineConst("e", M_E);
+
+    // try to evaluate mins and maxes strings
+    auto eval_bound = [&p](const std::string & expr, const Graph_exception::Location location)
+    {
+        p.SetExpr(expr);
+        try
+        {
+            return p.Eval();
+        }
+        catch(const mu::Parser::exception_type & e)
+        {
+            Graph_exception ge(e, location);
+            throw ge;
+        }
+    };
+
+    glm::dvec3 min(eval_bound(x_min, Graph_exception::ROW_MIN), eval_bound(y_min, Graph_exception::COL_MIN),
+        eval_bound(z_min, Graph_exception::Z_MIN));
+    glm::dvec3 max(eval_bound(x_max, Graph_exception::ROW_MAX), eval_bound(y_max, Graph_exception::COL_MAX),
+        eval_bound(z_max, Graph_exception::Z_MAX));
+
+    _min = glm::min(min, max);
+    _max = glm::max(min, max);
+
+    _signal_cursor_moved.emit(cursor_text());
+}
+
+// calculate & build graph geometry
+// blocks near the surface are found from a coarse grid of their corners, and then each is
+// marched on its own, in parallel. the results are packed into rows, for Graph's buffers
+void Graph_implicit::build_graph(const Tile_sink & sink)
+{
+    Sample_grid grid;
+    grid.cells = _res - 1;
+    grid.blocks = (grid.cells + block_cells - 1) / block_cells;
+    grid.origin = _min;
+    grid.step = (_max - _min) / (double)grid.cells;
+
+    std::vector<std::unique_ptr<Field_parser>> parsers;
+    for(size_t i = 0; i < Thread_pool::get().num_threads(); ++i)
+        parsers.emplace_back(new Field_parser(_eqn));
+
+    std::vector<size_t> active_blocks = find_active_blocks(grid, parsers);
+
+    std::vector<Block_mesh> block_meshes(active_blocks.size());
+    parallel_eval(parsers, active_blocks.size(), [&](Field_parser & parser, const size_t i)
+    {
+        march_block(grid, active_blocks[i], parser, block_meshes[i]);
+    });
+
+    // vertices are stored in rows, and each index chunk gets all but the last of its rows to itself,
+    // so that indexes stay within 16 bits. blocks are packed into chunks in order, and never split
+    const size_t num_columns = 1024;
+    const size_t slot_rows = chunk_rows(num_columns) - 1;
+    const size_t slot_verts = slot_rows * num_columns;
+
+    std::vector<size_t> block_vert_begin(block_meshes.size()), block_index_begin(block_meshes.size());
+    size_t num_verts = 0, num_indexes = 0;
+
+    Mesh_data mesh;
+    mesh.index_mode = GL_TRIANGLES;
+
+    for(size_t i = 0; i < block_meshes.size(); ++i)
+    {
+        const Block_mesh & block = block_meshes[i];
+        if(block.index.empty())
+            continue;
+
+        // start a new chunk at the next slot if this block doesn't fit in the current one
+        if(mesh.chunks.empty() || num_verts + block.coords.size() > (size_t)mesh.chunks.back().base_vertex + slot_verts)
+        {
+            num_verts = mesh.chunks.size() * slot_verts;
+            mesh.chunks.push_back(Mesh_chunk{(GLint)num_verts, num_indexes, 0});
+        }
+
+        block_vert_begin[i] = num_verts;
+        block_index_begin[i] = num_indexes;
+        num_verts += block.coords.size();
+        num_indexes += block.index.size();
+        mesh.chunks.back().index_count += block.index.size();
+    }
+
+    // keep a row even when there's no surface, so the graph has somewhere to put its buffers
+    mesh.num_columns = num_columns;
+    mesh.num_rows = mesh.row_end = std::max<size_t>(1, mesh.chunks.size() * slot_rows);
+    mesh.row_begin = 0;
+
+    mesh.coords.resize(mesh.num_rows * num_columns);
+    mesh.tex_coords.resize(mesh.coords.size());
+    mesh.normals.resize(mesh.coords.size());
+    mesh.defined = Defined_mask(mesh.num_rows, num_columns);
+    mesh.index.resize(num_indexes);
+
+    const glm::vec2 tex_scale(1.0 / (_max.x - _min.x), 1.0 / (_max.y - _min.y));
+
+    Thread_pool::get().parallel_for(0, block_meshes.size(), [&](const size_t i)
+    {
+        const Block_mesh & block = block_meshes[i];
+        if(block.index.empty())
+            return;
+
+        const size_t vert_begin = block_vert_begin[i];
+        const size_t chunk_base = vert_begin / slot_verts * slot_verts;
+
+        for(size_t v = 0; v < block.coords.size(); ++v)
+        {
+            const glm::vec3 & pos = block.coords[v];
+            mesh.coords[vert_begin + v] = pos;
+            mesh.normals[vert_begin + v] = block.normals[v];
+            mesh.tex_coords[vert_begin + v] = (glm::vec2(pos) - glm::vec2(_min)) * tex_scale;
+        }
+
+        for(size_t j = 0; j < block.index.size(); ++j)
+            mesh.index[block_index_begin[i] + j] = (GLushort)(vert_begin - chunk_base + block.index[j]);
+    });
+
+    // blocks share words of the mask, so this isn't split between threads
+    for(size_t i = 0; i < block_meshes.size(); ++i)
+    {
+        for(size_t v = 0; v < block_meshes[i].coords.size(); ++v)
+        {
+            size_t vert = block_vert_begin[i] + v;
+            mesh.defined.set(vert / num_columns, vert % num_columns, true);
+        }
+    }
+
+    sink_unstructured_mesh(mesh, sink);
+}
+
+// there are no column and row variables, so this is never defined
+bool Graph_implicit::eval_point(const double col_param, const double row_param, glm::dvec3 & pos)
+{
+    return false;
+}
+
+// cursor funcs. implicit graphs have no cursor
+void Graph_implicit::move_cursor(const Cursor_dir dir)
+{}
+
+void Graph_implicit::set_cursor(const double col_param, const double row_param)
+{}
+
+glm::vec3 Graph_implicit::cursor_pos() const
+{
+    return glm::vec3(0.0f);
+}
+
+bool Graph_implicit::cursor_defined() const
+{
+    return false;
+}
+
+// return the equation as a string
+std::string Graph_implicit::cursor_text() const
+{
+    std::string eqn = _eqn;
+
+    // limit to 50 chars
+    if(_eqn.size() > 50)
+        eqn = _eqn.substr(0, 49) + "…";
+
+    return "f(x, y, z) = " + eqn + " = 0";
+}
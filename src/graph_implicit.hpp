@@ -0,0 +1,65 @@
+// graph_implicit.hpp
+// implicit surface graph class (F(X, Y, Z) = 0)
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef GRAPH_IMPLICIT_H
+#define GRAPH_IMPLICIT_H
+
+#include "graph.hpp"
+
+// Implicit graph class - f(x,y,z) = 0
+// the surface is found with marching cubes over a grid of samples filling a box,
+// but only in the blocks of cells that a coarse pass finds near the surface.
+// vertices don't form a grid of column and row variables, so there's no cursor
+class Graph_implicit final: public Graph
+{
+public:
+    explicit Graph_implicit(const std::string & eqn,
+        const std::string & x_min, const std::string & x_max,
+        const std::string & y_min, const std::string & y_max,
+        const std::string & z_min, const std::string & z_max, size_t res);
+
+    // calculate & build graph geometry
+    void build_graph(const Tile_sink & sink) override;
+    // there are no column and row variables, so this is never defined
+    bool eval_point(const double col_param, const double row_param, glm::dvec3 & pos) override;
+
+    // cursor funcs
+    void move_cursor(const Cursor_dir dir) override;
+    void set_cursor(const double col_param, const double row_param) override;
+    glm::vec3 cursor_pos() const override;
+    bool cursor_defined() const override;
+    // return the equation as a string
+    std::string cursor_text() const override;
+
+    // largest number of samples along each axis. the number of samples grows with its cube
+    static const size_t max_samples = 1024;
+
+private:
+    std::string _eqn;
+
+    // bounds
+    glm::dvec3 _min, _max;
+    // samples along each axis
+    size_t _res;
+};
+
+#endif // GRAPH_IMPLICIT_H
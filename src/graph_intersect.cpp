@@ -0,0 +1,292 @@
+// graph_intersect.cpp
+// curves where two graphs meet
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+
+#include "graph.hpp"
+#include "parallel.hpp"
+
+// a triangle of the sampling grid, with everything needed to intersect it
+struct Grid_triangle
+{
+    // triangle number, unique over the whole graph
+    uint64_t id;
+    glm::vec3 pts[3];
+    // grid index of each point, for identifying edges
+    uint64_t vert_ids[3];
+};
+
+// one end of a segment of an intersection curve
+// ends lie where an edge of one graph's triangle crosses the other graph's triangle.
+// the segments on either side of the edge end at the same point, which is how they're joined up
+struct Segment_end
+{
+    glm::vec3 pos;
+    // the edge, as the grid indexes of its points, lowest first
+    uint64_t edge_a, edge_b;
+    // the triangle crossed
+    uint64_t tri;
+    // 0 when the edge belongs to the first graph, 1 for the second
+    int side;
+
+    bool operator<(const Segment_end & other) const
+    {
+        return std::tie(side, edge_a, edge_b, tri) < std::tie(other.side, other.edge_a, other.edge_b, other.tri);
+    }
+    bool operator==(const Segment_end & other) const
+    {
+        return side == other.side && edge_a == other.edge_a && edge_b == other.edge_b && tri == other.tri;
+    }
+};
+
+struct Segment
+{
+    Segment_end ends[2];
+};
+
+// find where the edges of triangle a cross the plane of triangle b
+// returns false unless exactly 2 edges cross. points on the plane count as in front of it
+static bool cross_plane(const Grid_triangle & a, const Grid_triangle & b, const int side, Segment_end * ends)
+{
+    glm::vec3 normal = glm::cross(b.pts[1] - b.pts[0], b.pts[2] - b.pts[0]);
+
+    float dist[3];
+    for(int i = 0; i < 3; ++i)
+        dist[i] = glm::dot(normal, a.pts[i] - b.pts[0]);
+
+    int num_ends = 0;
+    for(int i = 0; i < 3; ++i)
+    {
+        int j = (i + 1) % 3;
+        if((dist[i] >= 0.0f) == (dist[j] >= 0.0f))
+            continue;
+
+        // always interpolate from the lower index, so both triangles sharing the edge get the same point
+        int lo = a.vert_ids[i] < a.vert_ids[j] ? i : j;
+        int hi = lo == i ? j : i;
+
+        Segment_end & end = ends[num_ends++];
+        end.pos = a.pts[lo] + (a.pts[hi] - a.pts[lo]) * (dist[lo] / (dist[lo] - dist[hi]));
+        end.edge_a = a.vert_ids[lo];
+        end.edge_b = a.vert_ids[hi];
+        end.tri = b.id;
+        end.side = side;
+    }
+
+    return num_ends == 2;
+}
+
+// intersect two triangles. the segment where they meet is the overlap of the
+// parts of the line where their planes meet that lie inside each triangle
+static bool intersect_triangles(const Grid_triangle & a, const Grid_triangle & b, Segment & segment)
+{
+    Segment_end ends_a[2], ends_b[2];
+    if(!cross_plane(a, b, 0, ends_a) || !cross_plane(b, a, 1, ends_b))
+        return false;
+
+    glm::vec3 line = glm::cross(glm::cross(a.pts[1] - a.pts[0], a.pts[2] - a.pts[0]),
+        glm::cross(b.pts[1] - b.pts[0], b.pts[2] - b.pts[0]));
+
+    // sort each triangle's interval along the line
+    auto pos_on_line = [&line](const Segment_end & end) { return glm::dot(line, end.pos); };
+
+    if(pos_on_line(ends_a[0]) > pos_on_line(ends_a[1]))
+        std::swap(ends_a[0], ends_a[1]);
+    if(pos_on_line(ends_b[0]) > pos_on_line(ends_b[1]))
+        std::swap(ends_b[0], ends_b[1]);
+
+    segment.ends[0] = pos_on_line(ends_a[0]) >= pos_on_line(ends_b[0]) ? ends_a[0] : ends_b[0];
+    segment.ends[1] = pos_on_line(ends_a[1]) <= pos_on_line(ends_b[1]) ? ends_a[1] : ends_b[1];
+
+    return pos_on_line(segment.ends[0]) < pos_on_line(segment.ends[1]);
+}
+
+// join segments that share an end into polylines
+// where a curve passes exactly through grid points, the ends don't match up, and it's left in pieces
+static std::vector<std::vector<glm::vec3>> chain_segments(const std::vector<Segment> & segments)
+{
+    const size_t none = std::numeric_limits<size_t>::max();
+
+    // sort the ends, so matching ends are next to each other
+    // ends are numbered segment * 2 + end
+    std::vector<size_t> order(segments.size() * 2);
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    auto end = [&segments](const size_t i) -> const Segment_end & { return segments[i / 2].ends[i % 2]; };
+    std::sort(order.begin(), order.end(), [&end](const size_t a, const size_t b) { return end(a) < end(b); });
+
+    // the end each end is joined to
+    std::vector<size_t> joined(order.size(), none);
+    for(size_t i = 0; i + 1 < order.size(); ++i)
+    {
+        if(end(order[i]) == end(order[i + 1]))
+        {
+            joined[order[i]] = order[i + 1];
+            joined[order[i + 1]] = order[i];
+            ++i;
+        }
+    }
+
+    std::vector<std::vector<glm::vec3>> curves;
+    std::vector<char> used(segments.size(), false);
+
+    // walk from an end along the chain of segments until it ends or loops back around
+    auto walk = [&](const size_t start)
+    {
+        std::vector<glm::vec3> curve(1, end(start).pos);
+        for(size_t i = start; i != none && !used[i / 2]; i = joined[i ^ 1])
+        {
+            used[i / 2] = true;
+            curve.push_back(end(i ^ 1).pos);
+        }
+        curves.push_back(std::move(curve));
+    };
+
+    // open curves first, starting from their unjoined ends, then closed loops
+    for(size_t i = 0; i < joined.size(); ++i)
+    {
+        if(joined[i] == none && !used[i / 2])
+            walk(i);
+    }
+    for(size_t i = 0; i < joined.size(); i += 2)
+    {
+        if(!used[i / 2])
+            walk(i);
+    }
+
+    return curves;
+}
+
+// find the curves where this graph's surface meets another's
+std::vector<std::vector<glm::vec3>> Graph::intersection_curves(Graph & other)
+{
+    // triangles are rebuilt from the bvh's grid, so they need to be a grid of the column and row variables
+    if(!_param_grid || !other._param_grid)
+        return {};
+
+    std::vector<std::pair<size_t, size_t>> leaf_pairs = Graph_bvh::overlapping_leaves(_bvh, other._bvh);
+
+    // evaluate each leaf that's in a pair once. eval isn't thread safe, so this is done here
+    auto leaf_triangles = [](Graph & graph, std::vector<size_t> & leaves, std::vector<std::vector<Grid_triangle>> & triangles)
+    {
+        std::sort(leaves.begin(), leaves.end());
+        leaves.erase(std::unique(leaves.begin(), leaves.end()), leaves.end());
+        triangles.resize(leaves.size());
+
+        std::vector<glm::vec3> pts;
+        std::vector<char> defined;
+        const size_t grid_columns = graph._bvh.num_columns();
+
+        for(size_t i = 0; i < leaves.size(); ++i)
+        {
+            Graph_bvh::Leaf leaf = graph._bvh.leaf(leaves[i]);
+            const size_t num_columns = leaf.col_end - leaf.col_begin;
+            graph.eval_leaf(leaf, pts, defined);
+
+            for(size_t row = leaf.row_begin; row + 1 < leaf.row_end; ++row)
+            {
+                for(size_t col = leaf.col_begin; col + 1 < leaf.col_end; ++col)
+                {
+                    for(int t = 0; t < 2; ++t)
+                    {
+                        Grid_triangle tri;
+                        tri.id = (row * grid_columns + col) * 2 + t;
+
+                        bool tri_defined = true;
+                        for(int j = 0; j < 3; ++j)
+                        {
+                            glm::uvec2 offset = Graph_bvh::quad_triangles[t][j];
+                            size_t local = (row - leaf.row_begin + offset.y) * num_columns + col - leaf.col_begin + offset.x;
+                            tri_defined &= (bool)defined[local];
+                            tri.pts[j] = pts[local];
+                            tri.vert_ids[j] = (row + offset.y) * grid_columns + col + offset.x;
+                        }
+
+                        if(tri_defined)
+                            triangles[i].push_back(tri);
+                    }
+                }
+            }
+        }
+    };
+
+    std::vector<size_t> leaves_a(leaf_pairs.size()), leaves_b(leaf_pairs.size());
+    for(size_t i = 0; i < leaf_pairs.size(); ++i)
+    {
+        leaves_a[i] = leaf_pairs[i].first;
+        leaves_b[i] = leaf_pairs[i].second;
+    }
+
+    std::vector<std::vector<Grid_triangle>> triangles_a, triangles_b;
+    leaf_triangles(*this, leaves_a, triangles_a);
+    leaf_triangles(other, leaves_b, triangles_b);
+
+    // test the triangles of each pair of leaves, in parallel
+    std::vector<std::vector<Segment>> pair_segments(leaf_pairs.size());
+    Thread_pool::get().parallel_for(0, leaf_pairs.size(), [&](const size_t i)
+    {
+        size_t leaf_a = std::lower_bound(leaves_a.begin(), leaves_a.end(), leaf_pairs[i].first) - leaves_a.begin();
+        size_t leaf_b = std::lower_bound(leaves_b.begin(), leaves_b.end(), leaf_pairs[i].second) - leaves_b.begin();
+
+        // skip triangles that are outside of the other leaf's box
+        auto in_box = [](const Grid_triangle & tri, const Graph_bvh::Box & box)
+        {
+            Graph_bvh::Box tri_box;
+            for(const auto & pt: tri.pts)
+                tri_box.add(pt);
+            return glm::all(glm::lessThanEqual(tri_box.min, box.max)) && glm::all(glm::lessThanEqual(box.min, tri_box.max));
+        };
+
+        const Graph_bvh::Box & box_a = _bvh.leaf_box(leaf_pairs[i].first);
+        const Graph_bvh::Box & box_b = other._bvh.leaf_box(leaf_pairs[i].second);
+
+        std::vector<const Grid_triangle *> candidates_b;
+        for(const auto & tri: triangles_b[leaf_b])
+        {
+            if(in_box(tri, box_a))
+                candidates_b.push_back(&tri);
+        }
+
+        for(const auto & tri_a: triangles_a[leaf_a])
+        {
+            if(!in_box(tri_a, box_b))
+                continue;
+
+            for(const auto * tri_b: candidates_b)
+            {
+                Segment segment;
+                if(intersect_triangles(tri_a, *tri_b, segment))
+                    pair_segments[i].push_back(segment);
+            }
+        }
+    });
+
+    std::vector<Segment> segments;
+    for(const auto & s: pair_segments)
+        segments.insert(segments.end(), s.begin(), s.end());
+
+    return chain_segments(segments);
+}
@@ -0,0 +1,461 @@
+// graph_measure.cpp
+// surface area and volume of a sampled graph
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include "graph.hpp"
+#include "graph_measure.hpp"
+#include "parallel.hpp"
+
+void Compensated_sum::add(const double term)
+{
+    double sum = _sum + term;
+
+    // whichever is smaller lost its low bits in the addition
+    if(std::abs(_sum) >= std::abs(term))
+        _compensation += (_sum - sum) + term;
+    else
+        _compensation += (term - sum) + _sum;
+
+    _sum = sum;
+}
+
+void Compensated_sum::add(const Compensated_sum & other)
+{
+    add(other._sum);
+    _compensation += other._compensation;
+}
+
+void Surface_sums::add_triangle(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c)
+{
+    glm::dvec3 ab = glm::dvec3(b) - glm::dvec3(a);
+    glm::dvec3 ac = glm::dvec3(c) - glm::dvec3(a);
+    glm::dvec3 normal = glm::cross(ab, ac);
+
+    // the volume of the prism under the triangle is its projected area times its average height
+    double projected = 0.5 * std::abs(normal.z);
+    area.add(0.5 * glm::length(normal));
+    projected_area.add(projected);
+    volume.add(projected * ((double)a.z + (double)b.z + (double)c.z) / 3.0);
+}
+
+void Surface_sums::add(const Surface_sums & other)
+{
+    area.add(other.area);
+    projected_area.add(other.projected_area);
+    volume.add(other.volume);
+}
+
+// add the triangles of a quad with all of their corners defined, split as in Graph_bvh::quad_triangles
+// corners are indexed [row][column] from the top left
+static void add_quad(Surface_sums & sums, const glm::vec3 * const (&pts)[2][2], const bool (&defined)[2][2])
+{
+    for(const auto & tri: Graph_bvh::quad_triangles)
+    {
+        if(defined[tri[0].y][tri[0].x] && defined[tri[1].y][tri[1].x] && defined[tri[2].y][tri[2].x])
+            sums.add_triangle(*pts[tri[0].y][tri[0].x], *pts[tri[1].y][tri[1].x], *pts[tri[2].y][tri[2].x]);
+    }
+}
+
+// start measuring a grid of the given size
+void Graph_measure::begin(const size_t num_rows, const size_t num_columns)
+{
+    _num_rows = num_rows;
+    _num_columns = num_columns;
+    _measured = true;
+    _grid = true;
+    _fine = _coarse = Surface_sums();
+
+    _coarse_columns.clear();
+    for(size_t col = 0; col < num_columns; col += 2)
+        _coarse_columns.push_back(col);
+    if(num_columns > 0 && _coarse_columns.back() != num_columns - 1)
+        _coarse_columns.push_back(num_columns - 1);
+
+    _last_row = _last_coarse_row = Saved_row();
+}
+
+// rows of the coarse grid are every other row, and the last
+bool Graph_measure::coarse_row(const size_t row) const
+{
+    return row % 2 == 0 || row == _num_rows - 1;
+}
+
+// add the quads of rows [row_begin, row_end)
+// each row of quads is summed on its own, in parallel, and the sums are added up in order
+void Graph_measure::add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined)
+{
+    if(row_end <= row_begin)
+        return;
+
+    // rows before this call come from the saved rows
+    auto row_coords = [&](const size_t row) -> const glm::vec3 *
+    {
+        if(row >= row_begin)
+            return coords + (row - row_begin) * _num_columns;
+        return row == _last_row.row ? _last_row.coords.data() : _last_coarse_row.coords.data();
+    };
+    auto row_defined = [&](const size_t row, const size_t col) -> bool
+    {
+        if(row >= row_begin)
+            return defined.get(row - row_begin, col);
+        return (row == _last_row.row ? _last_row.defined[col] : _last_coarse_row.defined[col]);
+    };
+
+    // sum the quads between the given pairs of rows, over the given columns
+    auto add_quads = [&](Surface_sums & total, const std::vector<std::pair<size_t, size_t>> & row_pairs,
+        const size_t num_cols, const std::function<size_t(size_t)> & column)
+    {
+        std::vector<Surface_sums> row_sums(row_pairs.size());
+        Thread_pool::get().parallel_for(0, row_pairs.size(), [&](const size_t i)
+        {
+            const size_t rows[2] = {row_pairs[i].first, row_pairs[i].second};
+            const glm::vec3 * pts[2] = {row_coords(rows[0]), row_coords(rows[1])};
+
+            for(size_t c = 0; c + 1 < num_cols; ++c)
+            {
+                const size_t cols[2] = {column(c), column(c + 1)};
+                const glm::vec3 * corners[2][2] = {{&pts[0][cols[0]], &pts[0][cols[1]]}, {&pts[1][cols[0]], &pts[1][cols[1]]}};
+                const bool corners_defined[2][2] =
+                {
+                    {row_defined(rows[0], cols[0]), row_defined(rows[0], cols[1])},
+                    {row_defined(rows[1], cols[0]), row_defined(rows[1], cols[1])}
+                };
+                add_quad(row_sums[i], corners, corners_defined);
+            }
+        });
+
+        for(const auto & sums: row_sums)
+            total.add(sums);
+    };
+
+    // quads between each row and the one before it
+    std::vector<std::pair<size_t, size_t>> fine_rows;
+    for(size_t row = std::max<size_t>(row_begin, 1); row < row_end; ++row)
+        fine_rows.emplace_back(row - 1, row);
+    add_quads(_fine, fine_rows, _num_columns, [](const size_t c) { return c; });
+
+    // quads between each coarse row and the coarse row before it
+    std::vector<std::pair<size_t, size_t>> coarse_rows;
+    for(size_t row = std::max<size_t>(row_begin, 1); row < row_end; ++row)
+    {
+        if(coarse_row(row))
+            coarse_rows.emplace_back(row % 2 == 0 ? row - 2 : row - 1, row);
+    }
+    add_quads(_coarse, coarse_rows, _coarse_columns.size(), [this](const size_t c) { return _coarse_columns[c]; });
+
+    // keep the last row, and the last coarse row, for the next call
+    auto save_row = [&](const size_t row, Saved_row & saved)
+    {
+        const glm::vec3 * pts = row_coords(row);
+        std::vector<char> flags(_num_columns);
+        for(size_t col = 0; col < _num_columns; ++col)
+            flags[col] = row_defined(row, col);
+
+        saved.coords.assign(pts, pts + _num_columns);
+        saved.defined = std::move(flags);
+        saved.row = row;
+    };
+
+    size_t last_coarse = row_end - 1;
+    while(last_coarse > row_begin && !coarse_row(last_coarse))
+        --last_coarse;
+    if(coarse_row(last_coarse))
+        save_row(last_coarse, _last_coarse_row);
+
+    save_row(row_end - 1, _last_row);
+}
+
+// measure a whole triangle list
+void Graph_measure::set_triangles(const glm::vec3 * coords, const std::vector<GLushort> & index, const std::vector<Mesh_chunk> & chunks)
+{
+    _num_rows = _num_columns = 0;
+    _measured = true;
+    _grid = false;
+    _fine = _coarse = Surface_sums();
+    _coarse_columns.clear();
+    _last_row = _last_coarse_row = Saved_row();
+
+    std::vector<Surface_sums> chunk_sums(chunks.size());
+    Thread_pool::get().parallel_for(0, chunks.size(), [&](const size_t i)
+    {
+        const Mesh_chunk & chunk = chunks[i];
+        for(size_t j = chunk.index_begin; j + 2 < chunk.index_begin + chunk.index_count; j += 3)
+        {
+            chunk_sums[i].add_triangle(coords[chunk.base_vertex + index[j]],
+                coords[chunk.base_vertex + index[j + 1]], coords[chunk.base_vertex + index[j + 2]]);
+        }
+    });
+
+    for(const auto & sums: chunk_sums)
+        _fine.add(sums);
+}
+
+// the sampled surface is a piecewise linear approximation, whose error shrinks with the square
+// of the grid spacing. with S_h the sum over the grid, and S_2h the sum over every other row
+// and column, the error of S_h is about |S_h - S_2h| / 3 (Richardson extrapolation)
+Graph_measure::Result Graph_measure::result() const
+{
+    Result result;
+    result.area = _fine.area.value();
+    result.projected_area = _fine.projected_area.value();
+    result.volume = _fine.volume.value();
+
+    if(_grid)
+    {
+        result.area_error = std::abs(result.area - _coarse.area.value()) / 3.0;
+        result.projected_area_error = std::abs(result.projected_area - _coarse.projected_area.value()) / 3.0;
+        result.volume_error = std::abs(result.volume - _coarse.volume.value()) / 3.0;
+    }
+    else
+    {
+        result.area_error = result.projected_area_error = result.volume_error = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    return result;
+}
+
+// graphs that aren't a grid of the column and row variables can't be refined
+Graph::Point_eval Graph::make_point_eval() const
+{
+    return Point_eval();
+}
+
+// measure the graph, optionally refining the integrals by adaptive quadrature
+// the integrals are over the column and row variables (u, v), of the surface's point p(u, v):
+//     area: |p_u x p_v|, projected area: |(p_u x p_v).z|, volume: p.z |(p_u x p_v).z|
+// with derivatives found by central differences. points where the graph is undefined add nothing.
+// the domain starts as a few cells, each integrated with a 2x2 Gauss-Legendre rule, and its 4 quarters
+// the same way. the difference between the two, over 15, estimates the error of the quarters' sum.
+// the cells with the largest errors (relative to the tolerance for each integral) are split into their
+// quarters, a batch at a time across the thread pool, until the total error is within tolerance,
+// or the budget of points runs out. each thread evaluates the equation with its own parser
+Graph::Measurements Graph::measure(const bool refine) const
+{
+    Measurements measurements;
+    if(!_measure.measured())
+        return measurements;
+
+    Graph_measure::Result sampled = _measure.result();
+    measurements.area = sampled.area;
+    measurements.area_error = sampled.area_error;
+    measurements.has_volume = _height_field;
+    measurements.volume = sampled.volume;
+    measurements.volume_error = sampled.volume_error;
+    measurements.projected_area = sampled.projected_area;
+    measurements.projected_area_error = sampled.projected_area_error;
+
+    Point_eval test_eval = refine ? make_point_eval() : Point_eval();
+    if(test_eval && _param_grid && _bvh.num_rows() > 1 && _bvh.num_columns() > 1)
+    {
+        // relative to the sampled values
+        const double rel_tolerance = 1e-7;
+        // number of points the integrand may be evaluated at. each evaluates the equation 5 times
+        const size_t max_points = 1 << 18;
+        // cells along each axis to start with
+        const size_t max_start_cells = 16;
+        // points evaluated for a cell's whole and quarters, and for splitting a cell
+        const size_t start_cell_points = 20, split_points = 64;
+
+        const glm::dvec2 num_cells(_bvh.num_columns() - 1, _bvh.num_rows() - 1);
+        const glm::dvec2 domain = _param_step * num_cells;
+        // offset for derivatives
+        const glm::dvec2 h = 1e-4 * _param_step;
+
+        Graph_bvh::Box bounds = _bvh.bounds();
+        double max_height = bounds.empty() ? 0.0 : std::max(std::abs(bounds.min.z), std::abs(bounds.max.z));
+        const glm::dvec3 tolerance = rel_tolerance * glm::dvec3(sampled.area, sampled.projected_area,
+            sampled.projected_area * max_height);
+
+        // one evaluator for each thread
+        std::vector<Point_eval> evals(Thread_pool::get().num_threads());
+        evals[0] = std::move(test_eval);
+        for(size_t i = 1; i < evals.size(); ++i)
+            evals[i] = make_point_eval();
+
+        // area, projected area, and volume per unit of u and v
+        auto integrand = [&h](const Point_eval & eval, const glm::dvec2 & param)
+        {
+            glm::dvec3 pos, pos_u[2], pos_v[2];
+            if(!eval(param.x, param.y, pos))
+                return glm::dvec3(0.0);
+
+            // use a one sided difference at the edges of defined areas
+            bool def_u[2] = {eval(param.x - h.x, param.y, pos_u[0]), eval(param.x + h.x, param.y, pos_u[1])};
+            bool def_v[2] = {eval(param.x, param.y - h.y, pos_v[0]), eval(param.x, param.y + h.y, pos_v[1])};
+            if((!def_u[0] && !def_u[1]) || (!def_v[0] && !def_v[1]))
+                return glm::dvec3(0.0);
+
+            glm::dvec3 d_u = ((def_u[1] ? pos_u[1] : pos) - (def_u[0] ? pos_u[0] : pos)) / (h.x * (def_u[0] + def_u[1]));
+            glm::dvec3 d_v = ((def_v[1] ? pos_v[1] : pos) - (def_v[0] ? pos_v[0] : pos)) / (h.y * (def_v[0] + def_v[1]));
+            glm::dvec3 normal = glm::cross(d_u, d_v);
+
+            double projected = std::abs(normal.z);
+            return glm::dvec3(glm::length(normal), projected, pos.z * projected);
+        };
+
+        // 2x2 Gauss-Legendre rule over a cell
+        auto gauss = [&integrand](const Point_eval & eval, const glm::dvec2 & corner, const glm::dvec2 & size)
+        {
+            const double node = 0.5 / std::sqrt(3.0);
+            glm::dvec3 sum(0.0);
+            for(int i = 0; i < 4; ++i)
+            {
+                glm::dvec2 offset(i % 2 ? 0.5 + node : 0.5 - node, i / 2 ? 0.5 + node : 0.5 - node);
+                sum += integrand(eval, corner + offset * size);
+            }
+            return sum * (std::abs(size.x * size.y) / 4.0);
+        };
+
+        struct Cell
+        {
+            glm::dvec2 corner, size;
+            // sum over the quarters, and each quarter
+            glm::dvec3 value, quarters[4];
+            glm::dvec3 error;
+            // largest error, relative to its tolerance
+            double priority;
+
+            bool operator<(const Cell & other) const { return priority < other.priority; }
+        };
+
+        // integrate a cell's quarters, given the value over the whole cell
+        auto make_cell = [&](const Point_eval & eval, const glm::dvec2 & corner, const glm::dvec2 & size, const glm::dvec3 & whole)
+        {
+            Cell cell;
+            cell.corner = corner;
+            cell.size = size;
+            cell.value = glm::dvec3(0.0);
+            for(int i = 0; i < 4; ++i)
+            {
+                cell.quarters[i] = gauss(eval, corner + 0.5 * size * glm::dvec2(i % 2, i / 2), 0.5 * size);
+                cell.value += cell.quarters[i];
+            }
+
+            cell.error = glm::abs(cell.value - whole) / 15.0;
+            cell.priority = 0.0;
+            for(int i = 0; i < (_height_field ? 3 : 1); ++i)
+            {
+                if(tolerance[i] > 0.0)
+                    cell.priority = std::max(cell.priority, cell.error[i] / tolerance[i]);
+            }
+            return cell;
+        };
+
+        std::priority_queue<Cell> cells;
+        glm::dvec3 total_error(0.0);
+
+        // cells made by the last batch, before they're added to the queue in order
+        std::vector<Cell> new_cells;
+        auto add_new_cells = [&]()
+        {
+            for(const auto & cell: new_cells)
+            {
+                total_error += cell.error;
+                cells.push(cell);
+            }
+        };
+
+        const glm::dvec2 start_cells(std::min<double>(num_cells.x, max_start_cells), std::min<double>(num_cells.y, max_start_cells));
+        const glm::dvec2 start_size = domain / start_cells;
+        const size_t num_start_cells = (size_t)start_cells.x * (size_t)start_cells.y;
+        new_cells.resize(num_start_cells);
+        Thread_pool::get().parallel_for(evals, 0, num_start_cells, [&](const Point_eval & eval, const size_t i)
+        {
+            glm::dvec2 corner = _param_origin + start_size * glm::dvec2(i % (size_t)start_cells.x, i / (size_t)start_cells.x);
+            new_cells[i] = make_cell(eval, corner, start_size, gauss(eval, corner, start_size));
+        });
+        add_new_cells();
+        size_t num_points = num_start_cells * start_cell_points;
+
+        auto within_tolerance = [&]()
+        {
+            for(int i = 0; i < (_height_field ? 3 : 1); ++i)
+            {
+                if(total_error[i] > tolerance[i])
+                    return false;
+            }
+            return true;
+        };
+
+        // a few cells per thread are split in each batch. this may split some cells that splitting
+        // one at a time wouldn't have reached, but keeps every thread busy
+        const size_t batch_size = evals.size() * 4;
+        std::vector<Cell> batch;
+        while(!within_tolerance() && num_points + split_points <= max_points && !_cancelled)
+        {
+            batch.clear();
+            while(batch.size() < batch_size && num_points + split_points <= max_points)
+            {
+                batch.push_back(cells.top());
+                cells.pop();
+                total_error -= batch.back().error;
+                num_points += split_points;
+            }
+
+            new_cells.resize(batch.size() * 4);
+            Thread_pool::get().parallel_for(evals, 0, new_cells.size(), [&](const Point_eval & eval, const size_t i)
+            {
+                const Cell & cell = batch[i / 4];
+                const size_t quarter = i % 4;
+                new_cells[i] = make_cell(eval, cell.corner + 0.5 * cell.size * glm::dvec2(quarter % 2, quarter / 2),
+                    0.5 * cell.size, cell.quarters[quarter]);
+            });
+            add_new_cells();
+        }
+
+        // the running total of the error drifts, so everything is added up again
+        Compensated_sum sums[3], errors[3];
+        while(!cells.empty())
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                sums[i].add(cells.top().value[i]);
+                errors[i].add(cells.top().error[i]);
+            }
+            cells.pop();
+        }
+
+        measurements.refined = true;
+        measurements.area = sums[0].value();
+        measurements.area_error = errors[0].value();
+        measurements.projected_area = sums[1].value();
+        measurements.projected_area_error = errors[1].value();
+        measurements.volume = sums[2].value();
+        measurements.volume_error = errors[2].value();
+    }
+
+    // the average height over the area where the graph is defined
+    if(_height_field && measurements.projected_area > 0.0)
+    {
+        measurements.average_height = measurements.volume / measurements.projected_area;
+        measurements.average_height_error = (measurements.volume_error
+            + std::abs(measurements.average_height) * measurements.projected_area_error) / measurements.projected_area;
+    }
+
+    return measurements;
+}
@@ -0,0 +1,119 @@
+// graph_measure.hpp
+// surface area and volume of a sampled graph
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef GRAPH_MEASURE_H
+#define GRAPH_MEASURE_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "defined_mask.hpp"
+#include "index_buffer.hpp"
+
+// sum of many terms, carrying the rounding error of each addition along (Neumaier's variant of
+// Kahan summation), so that adding millions of tiny quads onto a large total doesn't lose them
+class Compensated_sum
+{
+public:
+    void add(const double term);
+    // add another sum, along with its error
+    void add(const Compensated_sum & other);
+    double value() const { return _sum + _compensation; }
+
+private:
+    double _sum = 0.0, _compensation = 0.0;
+};
+
+// integrals over a graph's surface. volume and projected area are only meaningful for height fields
+struct Surface_sums
+{
+    Compensated_sum area;
+    // area of the surface projected onto the x-y plane
+    Compensated_sum projected_area;
+    // signed volume between the surface and z = 0
+    Compensated_sum volume;
+
+    void add_triangle(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c);
+    void add(const Surface_sums & other);
+};
+
+// area and volume of a graph's sampled surface, summed as its rows are built,
+// so that measuring doesn't need the surface to be kept or evaluated again.
+// for grids, the surface on every other row and column is summed too, for estimating the error
+class Graph_measure
+{
+public:
+    struct Result
+    {
+        double area, projected_area, volume;
+        // estimated error of each. NaN when there's no estimate (triangle lists)
+        double area_error, projected_area_error, volume_error;
+    };
+
+    Graph_measure() = default;
+
+    // start measuring a grid of the given size
+    void begin(const size_t num_rows, const size_t num_columns);
+    // add the quads of rows [row_begin, row_end), including those joining them to the rows before.
+    // must be called in order. coords and defined start at row_begin
+    void add_rows(const size_t row_begin, const size_t row_end, const glm::vec3 * coords, const Defined_mask & defined);
+    // measure a whole triangle list instead, given as 16 bit indexes relative to each chunk's base vertex
+    void set_triangles(const glm::vec3 * coords, const std::vector<GLushort> & index, const std::vector<Mesh_chunk> & chunks);
+
+    // true once anything has been measured
+    bool measured() const { return _measured; }
+    Result result() const;
+
+private:
+    // a row kept from the last call to add_rows, for quads reaching back into it
+    struct Saved_row
+    {
+        size_t row = 0;
+        std::vector<glm::vec3> coords;
+        std::vector<char> defined;
+    };
+
+    bool coarse_row(const size_t row) const;
+
+    size_t _num_rows = 0, _num_columns = 0;
+    bool _measured = false;
+    bool _grid = false;
+
+    // sums over every quad, and over the quads joining every other row and column
+    Surface_sums _fine, _coarse;
+    // columns of the coarse grid: every other column, and the last
+    std::vector<size_t> _coarse_columns;
+
+    Saved_row _last_row, _last_coarse_row;
+
+    // make non-copyable
+    Graph_measure(const Graph_measure &) = delete;
+    Graph_measure(const Graph_measure &&) = delete;
+    Graph_measure & operator=(const Graph_measure &) = delete;
+    Graph_measure & operator=(const Graph_measure &&) = delete;
+};
+
+#endif // GRAPH_MEASURE_H
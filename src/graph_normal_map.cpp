@@ -0,0 +1,102 @@
+// graph_normal_map.cpp
+// normal map baking
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_helpers.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+
+// true if the graph was last built with a normal map
+bool Graph::has_normal_map() const
+{
+    return _normal_map != 0;
+}
+
+// graphs that aren't a grid of the column and row variables have no normal map
+void Graph::build_normals(const size_t scale, Normal_grid & grid)
+{}
+
+// sample normals and upload them to the normal map texture
+// the texture covers the same rows and columns as the verticies, each texel
+// lining up with grid_coords in the shader, so no extra tex coords are needed.
+// normals are stored in graph coordinates, as 16 bit signed normalized values
+void Graph::build_normal_map()
+{
+    if(_normal_map)
+        glDeleteTextures(1, &_normal_map);
+    _normal_map = 0;
+
+    if(!normal_map.enabled || !_param_grid || _bvh.num_rows() < 2 || _bvh.num_columns() < 2)
+        return;
+
+    // lower the scale until the texture fits
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    const size_t max_size = std::min(normal_map.max_size, (size_t)std::max(max_texture_size, 1));
+    const size_t max_cells = std::max(_bvh.num_rows(), _bvh.num_columns()) - 1;
+    const size_t scale = std::min(normal_map.scale, (max_size - 1) / max_cells);
+
+    // no finer than the verticies
+    if(scale < 2)
+        return;
+
+    Normal_grid grid;
+    build_normals(scale, grid);
+    if(grid.normals.empty())
+        return;
+
+    std::vector<GLshort> texels(grid.normals.size() * 3);
+    Thread_pool::get().parallel_for(0, grid.normals.size(), [&grid, &texels](const size_t i)
+    {
+        glm::vec3 normal = grid.normals[i];
+        float length = glm::length(normal);
+        normal = std::isfinite(length) && length > 0.0f ? normal / length : glm::vec3(0.0f);
+
+        for(int j = 0; j < 3; ++j)
+            texels[i * 3 + j] = (GLshort)std::lround(normal[j] * 32767.0f);
+    });
+
+    const GLsizei width = grid.num_columns;
+    const GLsizei height = grid.num_rows;
+
+    glGenTextures(1, &_normal_map);
+    glBindTexture(GL_TEXTURE_2D, _normal_map);
+    glTexStorage2D(GL_TEXTURE_2D, (int)(log2(std::max(width, height))) + 1, GL_RGB16_SNORM, width, height);
+
+    // texels are 6 bytes, so rows aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_SHORT, texels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // averaged normals are shorter, and get normalized in the shader
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    check_error("build normal map");
+}
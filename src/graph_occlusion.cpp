@@ -0,0 +1,209 @@
+// graph_occlusion.cpp
+// ambient occlusion baking
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "graph.hpp"
+#include "parallel.hpp"
+
+// directions spread evenly over the hemisphere around +z, denser toward the pole,
+// so that the fraction of rays that get out is the ambient light reaching a diffuse surface.
+// points go around a spiral in golden angle steps, with equal area between them on the unit disk,
+// and are then lifted onto the hemisphere
+static std::vector<glm::vec3> hemisphere_dirs(const size_t count)
+{
+    const float golden_angle = (float)M_PI * (3.0f - std::sqrt(5.0f));
+
+    std::vector<glm::vec3> dirs(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        float r = std::sqrt(((float)i + 0.5f) / (float)count);
+        float theta = golden_angle * (float)i;
+        dirs[i] = glm::vec3(r * std::cos(theta), r * std::sin(theta), std::sqrt(std::max(0.0f, 1.0f - r * r)));
+    }
+    return dirs;
+}
+
+// tangent and bitangent perpendicular to a unit normal (Duff et al. 2017)
+static void tangent_frame(const glm::vec3 & normal, glm::vec3 & tangent, glm::vec3 & bitangent)
+{
+    float sign = std::copysign(1.0f, normal.z);
+    float a = -1.0f / (sign + normal.z);
+    float b = normal.x * normal.y * a;
+    tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+// fill in mesh.occlusion, casting rays against the bvh over the whole sampled graph
+// every vertex casts rays over the hemispheres on both sides of the surface, since either side may be seen.
+// leaves are tested against the sampled points in mesh, which is the whole graph, so nothing is
+// re-evaluated, and the rays can be cast from all threads at once. the spiral of directions is
+// turned by a different angle for each vertex, so neighbors miss different things, rather than
+// the same rays lining up into bands
+void Graph::bake_ambient_occlusion(Mesh_data & mesh)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    mesh.occlusion.assign(mesh.coords.size(), glm::vec2(1.0f));
+
+    // the bvh's leaves have to be a grid of the sampled points
+    Graph_bvh::Box bounds = _bvh.bounds();
+    if(!_param_grid || !_bvh.built() || bounds.empty() || mesh.row_begin != 0)
+        return;
+
+    const size_t num_rows = mesh.row_end - mesh.row_begin;
+    const size_t num_columns = mesh.num_columns;
+    const size_t num_rays = std::max<size_t>(1, ambient_occlusion.rays);
+
+    // hits closer than bias are the surface the ray started on
+    const float size = glm::length(bounds.max - bounds.min);
+    const float max_dist = ambient_occlusion.distance * size;
+    const float bias = 1e-4f * size;
+
+    const std::vector<glm::vec3> dirs = hemisphere_dirs(num_rays);
+
+    // leaves hold too many triangles to test them all for every ray, so they're split into cells
+    // of 2x2 quads, each with its own bounds. leaf_size is even, so leaves hold whole cells
+    const size_t cell_size = 2;
+    const size_t cell_rows = (num_rows + cell_size - 2) / cell_size;
+    const size_t cell_columns = (num_columns + cell_size - 2) / cell_size;
+
+    std::vector<Graph_bvh::Box> cells(cell_rows * cell_columns);
+    Thread_pool::get().parallel_for(0, cells.size(), [&](const size_t cell)
+    {
+        const size_t row_begin = cell / cell_columns * cell_size;
+        const size_t col_begin = cell % cell_columns * cell_size;
+        for(size_t row = row_begin; row <= std::min(row_begin + cell_size, num_rows - 1); ++row)
+        {
+            for(size_t col = col_begin; col <= std::min(col_begin + cell_size, num_columns - 1); ++col)
+            {
+                if(mesh.defined.get(row, col))
+                    cells[cell].add(mesh.coords[row * num_columns + col]);
+            }
+        }
+    });
+
+    // any hit within max_dist blocks the ray, so there's no need to find the nearest.
+    // returns 0 for a hit, which ends the bvh's search, or infinity for none
+    auto leaf_test = [&](const Graph_bvh::Leaf & leaf, const glm::vec3 & origin, const glm::vec3 & dir,
+        const glm::vec3 & inv_dir)
+    {
+        for(size_t cell_row = leaf.row_begin / cell_size; cell_row * cell_size + 1 < leaf.row_end; ++cell_row)
+        {
+            for(size_t cell_col = leaf.col_begin / cell_size; cell_col * cell_size + 1 < leaf.col_end; ++cell_col)
+            {
+                if(Graph_bvh::hit_box(cells[cell_row * cell_columns + cell_col], origin, inv_dir) >= max_dist)
+                    continue;
+
+                const size_t row_end = std::min((cell_row + 1) * cell_size, leaf.row_end - 1);
+                const size_t col_end = std::min((cell_col + 1) * cell_size, leaf.col_end - 1);
+                for(size_t row = cell_row * cell_size; row < row_end; ++row)
+                {
+                    for(size_t col = cell_col * cell_size; col < col_end; ++col)
+                    {
+                        for(const auto & tri: Graph_bvh::quad_triangles)
+                        {
+                            size_t i[3];
+                            bool tri_defined = true;
+                            for(int j = 0; j < 3; ++j)
+                            {
+                                i[j] = (row + tri[j].y) * num_columns + col + tri[j].x;
+                                tri_defined &= mesh.defined.get(row + tri[j].y, col + tri[j].x);
+                            }
+
+                            if(!tri_defined)
+                                continue;
+
+                            glm::vec2 bary;
+                            float dist = intersect_triangle(origin, dir,
+                                mesh.coords[i[0]], mesh.coords[i[1]], mesh.coords[i[2]], bary);
+                            if(dist > bias && dist < max_dist)
+                                return 0.0f;
+                        }
+                    }
+                }
+            }
+        }
+
+        return std::numeric_limits<float>::infinity();
+    };
+
+    // fraction of rays from one side of a vertex that get away
+    auto light = [&](const glm::vec3 & pos, const glm::vec3 & normal, const float turn)
+    {
+        glm::vec3 tangent, bitangent;
+        tangent_frame(normal, tangent, bitangent);
+
+        // spin the spiral around the normal
+        glm::vec3 u = std::cos(turn) * tangent + std::sin(turn) * bitangent;
+        glm::vec3 v = glm::cross(normal, u);
+
+        glm::vec3 origin = pos + bias * normal;
+        size_t blocked = 0;
+        for(const auto & d: dirs)
+        {
+            glm::vec3 dir = d.x * u + d.y * v + d.z * normal;
+            glm::vec3 inv_dir = 1.0f / dir;
+            float hit = _bvh.intersect(origin, dir, [&](const Graph_bvh::Leaf & leaf)
+            {
+                return leaf_test(leaf, origin, dir, inv_dir);
+            }, max_dist);
+
+            if(hit < max_dist)
+                ++blocked;
+        }
+
+        return 1.0f - (float)blocked / (float)dirs.size();
+    };
+
+    // work through the rows in batches, reporting progress from this thread between them,
+    // and stopping there if the bake is cancelled
+    const size_t num_batches = std::min<size_t>(num_rows, 100);
+    for(size_t batch = 0; batch < num_batches && !_cancelled; ++batch)
+    {
+        const size_t first = num_rows * batch / num_batches * num_columns;
+        const size_t last = num_rows * (batch + 1) / num_batches * num_columns;
+
+        Thread_pool::get().parallel_for(first, last, [&](const size_t i)
+        {
+            const size_t row = i / num_columns;
+            const size_t col = i % num_columns;
+            if(!mesh.defined.get(row, col))
+                return;
+
+            glm::vec3 normal = glm::normalize(mesh.normals[i]);
+            if(!std::isfinite(normal.x))
+                return;
+
+            // golden ratio steps go around the circle without repeating
+            float turn = (float)(2.0 * M_PI * std::fmod(0.6180339887 * (double)i, 1.0));
+            mesh.occlusion[i] = glm::vec2(light(mesh.coords[i], normal, turn), light(mesh.coords[i], -normal, turn));
+        });
+
+        _signal_bake_progress.emit((float)(batch + 1) / (float)num_batches);
+    }
+
+    _bake_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -20,6 +20,11 @@
 // IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/separator.h>
 
@@ -30,24 +35,37 @@
 #include "graph_cylindrical.hpp"
 #include "graph_spherical.hpp"
 #include "graph_parametric.hpp"
+#include "graph_implicit.hpp"
 
 const glm::vec3 Graph_page::start_color = glm::vec3(0.2f, 0.5f, 0.2f);
 
-Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nullptr),
+Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nullptr), _bake_progress(0.0f),
     _r_car("Cartesian"),
     _r_cyl("Cylindrical"),
     _r_sph("Spherical"),
     _r_par("Parametric"),
+    _r_imp("Implicit"),
     _row_res_l("x resolution"),
     _col_res_l("y resolution"),
-    _row_res(Gtk::Adjustment::create(50.0, 1.0, 1000.0)),
-    _col_res(Gtk::Adjustment::create(50.0, 1.0, 1000.0)),
+    _row_res(Gtk::Adjustment::create(50.0, 1.0, Graph::max_resolution)),
+    _col_res(Gtk::Adjustment::create(50.0, 1.0, Graph::max_resolution)),
     _use_color("Use Color"),
     _use_tex("Use Texture"),
     _draw("Draw Graph"),
     _transparent("Transparent Graph"),
     _draw_normals("Draw Normals"),
     _draw_grid("Draw Gridlines"),
+    _draw_contours("Draw Contours"),
+    _shader_grid("Shader Gridlines"),
+    _grid_density(Gtk::Adjustment::create(10.0, 1.0, 1000.0)),
+    _ambient_occlusion("Ambient Occlusion"),
+    _normal_map("Normal Map"),
+    _decimate("Decimate"),
+    _decimate_error(Gtk::Adjustment::create(0.001, 0.0001, 0.1, 0.0001, 0.001), 0.0, 4),
+    _decimate_target_l("Target triangles"),
+    _decimate_target(Gtk::Adjustment::create(0.0, 0.0, 100000000.0, 1000.0, 10000.0)),
+    _measure("_Measure", true),
+    _refine_measure("Refine"),
     _transparency_l("Opacity:"),
     _transparency(Gtk::Adjustment::create(0.5, 0.0, 1.0, 0.01), Gtk::ORIENTATION_HORIZONTAL),
     _color(start_color)
@@ -64,30 +82,45 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     attach(_r_cyl, 1, 1, 1, 1);
     attach(_r_sph, 0, 2, 1, 1);
     attach(_r_par, 1, 2, 1, 1);
-    attach(_eqn, 0, 3, 2, 1);
-    attach(_eqn_par_y, 0, 4, 2, 1);
-    attach(_eqn_par_z, 0, 5, 2, 1);
-    attach(_row_min, 0, 6, 1, 1);
-    attach(_row_max, 1, 6, 1, 1);
-    attach(_col_min, 0, 7, 1, 1);
-    attach(_col_max, 1, 7, 1, 1);
-    attach(_row_res_l, 0, 8, 1, 1);
-    attach(_row_res, 1, 8, 1, 1);
-    attach(_col_res_l, 0, 9, 1, 1);
-    attach(_col_res, 1, 9, 1, 1);
-    attach(*Gtk::manage(new Gtk::Separator), 0, 10, 2, 1);
-    attach(_use_color, 0, 11, 1, 1);
-    attach(_use_tex, 0, 12, 1, 1);
-    attach(_tex_butt, 1, 11, 1, 2);
-    attach(*Gtk::manage(new Gtk::Separator), 0, 13, 2, 1);
-    attach(_draw, 0, 14, 1, 1);
-    attach(_transparent, 1, 14, 1, 1);
-    attach(_draw_normals, 0, 15, 1, 1);
-    attach(_draw_grid, 1, 15, 1, 1);
-    attach(_transparency_l, 0, 16, 1, 1);
-    attach(_transparency, 1, 16, 1, 1);
-    attach(*Gtk::manage(new Gtk::Separator), 0, 17, 2, 1);
-    attach(*apply_butt, 0, 18, 2, 1);
+    attach(_r_imp, 0, 3, 1, 1);
+    attach(_eqn, 0, 4, 2, 1);
+    attach(_eqn_par_y, 0, 5, 2, 1);
+    attach(_eqn_par_z, 0, 6, 2, 1);
+    attach(_row_min, 0, 7, 1, 1);
+    attach(_row_max, 1, 7, 1, 1);
+    attach(_col_min, 0, 8, 1, 1);
+    attach(_col_max, 1, 8, 1, 1);
+    attach(_z_min, 0, 9, 1, 1);
+    attach(_z_max, 1, 9, 1, 1);
+    attach(_row_res_l, 0, 10, 1, 1);
+    attach(_row_res, 1, 10, 1, 1);
+    attach(_col_res_l, 0, 11, 1, 1);
+    attach(_col_res, 1, 11, 1, 1);
+    attach(*Gtk::manage(new Gtk::Separator), 0, 12, 2, 1);
+    attach(_use_color, 0, 13, 1, 1);
+    attach(_use_tex, 0, 14, 1, 1);
+    attach(_tex_butt, 1, 13, 1, 2);
+    attach(*Gtk::manage(new Gtk::Separator), 0, 15, 2, 1);
+    attach(_draw, 0, 16, 1, 1);
+    attach(_transparent, 1, 16, 1, 1);
+    attach(_draw_normals, 0, 17, 1, 1);
+    attach(_draw_grid, 1, 17, 1, 1);
+    attach(_shader_grid, 0, 18, 1, 1);
+    attach(_grid_density, 1, 18, 1, 1);
+    attach(_ambient_occlusion, 0, 19, 1, 1);
+    attach(_normal_map, 1, 19, 1, 1);
+    attach(_decimate, 0, 20, 1, 1);
+    attach(_decimate_error, 1, 20, 1, 1);
+    attach(_decimate_target_l, 0, 21, 1, 1);
+    attach(_decimate_target, 1, 21, 1, 1);
+    attach(_draw_contours, 0, 22, 1, 1);
+    attach(_contour_levels, 1, 22, 1, 1);
+    attach(_transparency_l, 0, 23, 1, 1);
+    attach(_transparency, 1, 23, 1, 1);
+    attach(_measure, 0, 24, 1, 1);
+    attach(_refine_measure, 1, 24, 1, 1);
+    attach(*Gtk::manage(new Gtk::Separator), 0, 25, 2, 1);
+    attach(*apply_butt, 0, 26, 2, 1);
 
     // set button properties
     _tex_butt.set_valign(Gtk::ALIGN_CENTER);
@@ -106,11 +139,13 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     _r_cyl.set_group(type_g);
     _r_sph.set_group(type_g);
     _r_par.set_group(type_g);
+    _r_imp.set_group(type_g);
 
     _r_car.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_type));
     _r_cyl.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_type));
     _r_sph.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_type));
     _r_par.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_type));
+    _r_imp.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_type));
 
     // set signal when Enter is pressed inside a text box
     _eqn.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
@@ -120,6 +155,8 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     _row_max.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
     _col_min.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
     _col_max.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
+    _z_min.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
+    _z_max.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
     _row_res.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
     _col_res.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::apply));
 
@@ -131,6 +168,12 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     _row_max.set_placeholder_text("x max");
     _col_min.set_placeholder_text("y min");
     _col_max.set_placeholder_text("y max");
+    _z_min.set_placeholder_text("z min");
+    _z_max.set_placeholder_text("z max");
+    _contour_levels.set_placeholder_text("z levels, eg: -1, 0, 1");
+
+    // contours are updated without re-building the graph
+    _contour_levels.signal_activate().connect(sigc::mem_fun(*this, &Graph_page::change_contours));
 
     // set color radio buttons
     Gtk::RadioButton::Group tex_g = _use_color.get_group();
@@ -163,6 +206,36 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     _transparent.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_flags));
     _draw_normals.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_flags));
     _draw_grid.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_flags));
+    _draw_contours.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_flags));
+
+    // gridline density is updated without re-building the graph, but switching to shader
+    // gridlines changes what's built, so that waits until the graph is applied
+    _grid_density.set_tooltip_text("Number of cells along each side for shader gridlines");
+    _grid_density.set_sensitive(false);
+    _shader_grid.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_grid));
+    _grid_density.signal_value_changed().connect(sigc::mem_fun(*this, &Graph_page::change_grid));
+
+    // baked when the graph is built, so it waits until the graph is applied
+    _ambient_occlusion.set_tooltip_text("Shade areas the graph hides from view. Applied when the graph is built");
+    _normal_map.set_tooltip_text("Light the graph as if it had 10 times the resolution. Applied when the graph is built");
+
+    // decimation is done when the graph is built, so it waits until the graph is applied
+    _decimate.set_tooltip_text("Simplify the surface where it is nearly flat. Applied when the graph is built");
+    _decimate_error.set_tooltip_text("Furthest the simplified surface may move, as a fraction of the size of the graph");
+    _decimate_target.set_tooltip_text("Stop simplifying once this many triangles are left. 0 for no limit");
+    _decimate_error.set_sensitive(false);
+    _decimate_target.set_sensitive(false);
+    _decimate.signal_toggled().connect(sigc::mem_fun(*this, &Graph_page::change_decimation));
+
+    // measurements are taken from the applied graph, and shown below the cursor position
+    _measure.set_tooltip_text("Show the area of the graph, and for cartesian and cylindrical graphs, its volume and average height");
+    _refine_measure.set_tooltip_text("Measure by evaluating the equation again, rather than from the sampled points. Slower, but more accurate");
+    _measure.signal_clicked().connect(sigc::mem_fun(*this, &Graph_page::measure));
+
+    // graphs built in the background report back to the main thread through these
+    _bake_progress_dispatcher.connect(sigc::mem_fun(*this, &Graph_page::show_bake_progress));
+    _build_dispatcher.connect(sigc::mem_fun(*this, &Graph_page::finish_build));
+    _measure_dispatcher.connect(sigc::mem_fun(*this, &Graph_page::finish_measure));
 
     // set opacity slider properties & signal
     _transparency.set_digits(2);
@@ -172,12 +245,27 @@ Graph_page::Graph_page(Graph_disp & gl_window): _gl_window(gl_window), _graph(nu
     show_all_children();
     _eqn_par_y.hide();
     _eqn_par_z.hide();
+    _z_min.hide();
+    _z_max.hide();
     _transparency_l.hide();
     _transparency.hide();
 }
 
 Graph_page::~Graph_page()
 {
+    // a graph still being built is thrown away, so don't wait for it to finish baking
+    if(_build_thread.joinable())
+    {
+        _building_graph->cancel();
+        _build_thread.join();
+    }
+    // the same for measurements
+    if(_measure_thread.joinable())
+    {
+        _graph->cancel();
+        _measure_thread.join();
+    }
+
     // tell the display to drop the graph from its records
     _gl_window.remove_graph(_graph.get());
     // trigger a re-draw
@@ -196,6 +284,9 @@ void Graph_page::set_active()
     else
         update_cursor("");
 
+    // show the last measurements
+    _signal_measured.emit(_measurement_text);
+
     // trigger a re-draw
     _gl_window.invalidate();
 }
@@ -206,6 +297,12 @@ sigc::signal<void, const std::string &> Graph_page::signal_cursor_moved() const
     return _signal_cursor_moved;
 }
 
+// signaled when the graph has been measured, or the measurements should be cleared
+sigc::signal<void, const std::string &> Graph_page::signal_measured() const
+{
+    return _signal_measured;
+}
+
 // signaled when the user selects a new texture
 sigc::signal<void, const Glib::RefPtr<Gdk::Pixbuf> &> Graph_page::signal_tex_changed() const
 {
@@ -249,6 +346,18 @@ void Graph_page::change_type()
         _row_res_l.set_text(u8"θ resolution");
         _col_res_l.set_text(u8"ϕ resolution");
     }
+    // only height fields have contours
+    if(_r_car.get_active() || _r_cyl.get_active())
+    {
+        _draw_contours.show();
+        _contour_levels.show();
+    }
+    else
+    {
+        _draw_contours.hide();
+        _contour_levels.hide();
+    }
+
     if(_r_par.get_active())
     {
         _eqn.set_placeholder_text("x(u,v)");
@@ -270,6 +379,33 @@ void Graph_page::change_type()
         _eqn_par_y.hide();
         _eqn_par_z.hide();
     }
+
+    if(_r_imp.get_active())
+    {
+        _eqn.set_placeholder_text("f(x,y,z) = 0");
+        _row_min.set_placeholder_text("x min");
+        _row_max.set_placeholder_text("x max");
+        _col_min.set_placeholder_text("y min");
+        _col_max.set_placeholder_text("y max");
+
+        // one resolution for all 3 axes, limited to what implicit graphs can sample
+        _row_res_l.set_text("resolution");
+        _row_res.set_range(2.0, Graph_implicit::max_samples);
+
+        // show extra bounds, hide the second resolution
+        _z_min.show();
+        _z_max.show();
+        _col_res_l.hide();
+        _col_res.hide();
+    }
+    else
+    {
+        _row_res.set_range(1.0, Graph::max_resolution);
+        _z_min.hide();
+        _z_max.hide();
+        _col_res_l.show();
+        _col_res.show();
+    }
 }
 
 // called when checkboxes for displaying grid, normals are pressed
@@ -282,6 +418,7 @@ void Graph_page::change_flags()
         _graph->transparent_flag = _transparent.get_active();
         _graph->draw_normals_flag = _draw_normals.get_active();
         _graph->draw_grid_flag = _draw_grid.get_active();
+        _graph->draw_contours_flag = _draw_contours.get_active();
         // redraw
         _gl_window.invalidate();
     }
@@ -309,12 +446,195 @@ void Graph_page::change_transparency()
     }
 }
 
+// called when the shader gridline settings are changed
+void Graph_page::change_grid()
+{
+    _grid_density.set_sensitive(_shader_grid.get_active());
+
+    if(_graph.get())
+    {
+        _graph->grid_density = _grid_density.get_value();
+        // redraw
+        _gl_window.invalidate();
+    }
+}
+
+// called when decimation is toggled
+void Graph_page::change_decimation()
+{
+    _decimate_error.set_sensitive(_decimate.get_active());
+    _decimate_target.set_sensitive(_decimate.get_active());
+}
+
+// called on the building thread while ambient occlusion is baked, with the fraction done
+void Graph_page::update_bake_progress(const float fraction)
+{
+    _bake_progress = fraction;
+    _bake_progress_dispatcher.emit();
+}
+
+// shows the bake progress. called on the main thread
+void Graph_page::show_bake_progress()
+{
+    // the build may have finished while this was waiting
+    if(!_build_thread.joinable())
+        return;
+
+    std::ostringstream text;
+    text<<"Baking ambient occlusion: "<<(int)(_bake_progress * 100.0f)<<"%";
+    update_cursor(text.str());
+}
+
+// called when the measure button is pressed
+void Graph_page::measure()
+{
+    if(!_graph.get() || _measure_thread.joinable())
+        return;
+
+    if(!_refine_measure.get_active())
+    {
+        _measurements = _graph->measure(false);
+        finish_measure();
+        return;
+    }
+
+    // refining can evaluate the equation over a million times, so it's done on its own thread,
+    // and the page is locked until it's done. the graph can still be drawn, and its cursor moved,
+    // since refining doesn't touch the graph's own parser
+    set_sensitive(false);
+    show_measurement("Measuring...");
+
+    _measure_thread = std::thread([this]()
+    {
+        try
+        {
+            _measurements = _graph->measure(true);
+        }
+        catch(...)
+        {
+            _measure_error = std::current_exception();
+        }
+        _measure_dispatcher.emit();
+    });
+}
+
+// show the measurements once they're taken
+void Graph_page::finish_measure()
+{
+    if(_measure_thread.joinable())
+    {
+        _measure_thread.join();
+        set_sensitive(true);
+    }
+
+    if(_measure_error)
+    {
+        std::exception_ptr error = _measure_error;
+        _measure_error = nullptr;
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch(const Graph_exception & e)
+        {
+            show_measurement("Measuring failed: " + e.GetMsg());
+            return;
+        }
+        catch(const std::exception & e)
+        {
+            show_measurement(std::string("Measuring failed: ") + e.what());
+            return;
+        }
+    }
+
+    const Graph::Measurements & m = _measurements;
+
+    // errors aren't known for implicit graphs
+    auto print = [](std::ostringstream & text, const double value, const double error)
+    {
+        text<<value;
+        if(!std::isnan(error))
+            text<<" \u00B1 "<<error;
+    };
+
+    std::ostringstream text;
+    text.precision(m.refined ? 9 : 6);
+    text<<"Area: ";
+    print(text, m.area, m.area_error);
+    if(m.has_volume)
+    {
+        text<<"  Volume: ";
+        print(text, m.volume, m.volume_error);
+        text<<"  Average height: ";
+        print(text, m.average_height, m.average_height_error);
+    }
+    show_measurement(text.str());
+}
+
+// set the measurement text, kept until the next measurement or apply
+void Graph_page::show_measurement(const std::string & text)
+{
+    _measurement_text = text;
+    _signal_measured.emit(_measurement_text);
+}
+
+// called when the contour levels are changed
+void Graph_page::change_contours()
+{
+    if(!_graph.get() || !_graph->has_contours())
+        return;
+
+    // levels are a comma separated list of expressions
+    std::vector<float> levels;
+    if(!_contour_levels.get_text().empty())
+    {
+        mu::Parser p;
+        p.DefineConst("pi", M_PI);
+        p.DefineConst("e", M_E);
+
+        try
+        {
+            p.SetExpr(_contour_levels.get_text());
+
+            int num_levels;
+            const double * vals = p.Eval(num_levels);
+            for(int i = 0; i < num_levels; ++i)
+            {
+                if(std::isfinite(vals[i]))
+                    levels.push_back((float)vals[i]);
+            }
+        }
+        catch(const mu::Parser::exception_type & e)
+        {
+            // show parsing error message
+            Gtk::MessageDialog error_dialog(e.GetMsg(), false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+            error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
+            error_dialog.set_title("Error");
+            error_dialog.set_secondary_text("In Expression: " + e.GetExpr());
+            error_dialog.run();
+
+            _contour_levels.grab_focus();
+            return;
+        }
+    }
+
+    // only lines for new levels are calculated
+    _graph->set_contour_levels(levels);
+    // redraw
+    _gl_window.invalidate();
+}
+
 // apply changes and create/update graph
 void Graph_page::apply()
 {
-    // destroy any existing graph
+    // wait for the graph being built or measured in the background
+    if(_build_thread.joinable() || _measure_thread.joinable())
+        return;
+
+    // destroy any existing graph, and its measurements
     _gl_window.remove_graph(_graph.get());
     _graph.reset();
+    show_measurement("");
 
     try
     {
@@ -343,84 +663,206 @@ void Graph_page::apply()
                         _row_min.get_text(), _row_max.get_text(), _row_res.get_value_as_int(),
                         _col_min.get_text(), _col_max.get_text(), _col_res.get_value_as_int()));
         }
-    }
-    catch(const Graph_exception &e)
-    {
-        // show parsing error message
-        Gtk::MessageDialog error_dialog(e.GetMsg(), false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
-        error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
-        error_dialog.set_title("Error");
-        error_dialog.set_secondary_text("In Expression: " + e.GetExpr());
-        error_dialog.run();
-
-        // highlight the location of the error
-        int start, end;
-        if(e.GetToken().size() > 0 && e.GetPos() < e.GetExpr().size())
+        else if(_r_imp.get_active())
         {
-            start = e.GetPos();
-            end = e.GetPos() + e.GetToken().size();
+            _graph = std::unique_ptr<Graph>(new Graph_implicit(_eqn.get_text(),
+                        _row_min.get_text(), _row_max.get_text(),
+                        _col_min.get_text(), _col_max.get_text(),
+                        _z_min.get_text(), _z_max.get_text(), _row_res.get_value_as_int()));
         }
-        else
+
+        // calculate geometry and send it to OpenGL
+        // gridline indexes are only built when the shader isn't drawing gridlines
+        if(_graph)
         {
-            start = 0;
-            end = -1;
+            _graph->shader_grid_flag = _shader_grid.get_active();
+            _graph->ambient_occlusion.enabled = _ambient_occlusion.get_active();
+            _graph->normal_map.enabled = _normal_map.get_active();
+            _graph->decimation.enabled = _decimate.get_active();
+            _graph->decimation.max_error = _decimate_error.get_value();
+            _graph->decimation.target_triangles = _decimate_target.get_value_as_int();
+
+            // baking ambient occlusion can take a while, so the mesh is built on its own thread,
+            // showing progress as it goes, and the page is locked until it's done.
+            // it's uploaded back on this thread, which has the OpenGL context, by finish_build
+            if(_graph->ambient_occlusion.enabled)
+            {
+                _building_graph = std::move(_graph);
+                _building_graph->signal_bake_progress().connect(sigc::mem_fun(*this, &Graph_page::update_bake_progress));
+                _bake_progress = 0.0f;
+                set_sensitive(false);
+
+                _build_thread = std::thread([this]()
+                {
+                    try
+                    {
+                        _built_mesh = _building_graph->build_mesh();
+                    }
+                    catch(...)
+                    {
+                        _build_error = std::current_exception();
+                    }
+                    _build_dispatcher.emit();
+                });
+
+                show_bake_progress();
+                return;
+            }
+
+            _graph->build();
         }
+    }
+    catch(const Graph_exception &e)
+    {
+        show_graph_error(e);
+        return;
+    }
 
-        switch(e.GetLocation())
+    finish_apply();
+}
+
+// upload the graph once it's been built in the background
+void Graph_page::finish_build()
+{
+    _build_thread.join();
+    set_sensitive(true);
+
+    _graph = std::move(_building_graph);
+    Mesh_data mesh = std::move(_built_mesh);
+    _built_mesh = Mesh_data();
+
+    try
+    {
+        if(_build_error)
         {
-        case Graph_exception::ROW_MIN:
-            _row_min.grab_focus();
-            _row_min.select_region(start, end);
-            break;
-
-        case Graph_exception::ROW_MAX:
-            _row_max.grab_focus();
-            _row_max.select_region(start, end);
-            break;
-
-        case Graph_exception::COL_MIN:
-            _col_min.grab_focus();
-            _col_min.select_region(start, end);
-            break;
-
-        case Graph_exception::COL_MAX:
-            _col_max.grab_focus();
-            _col_max.select_region(start, end);
-            break;
-
-        case Graph_exception::EQN:
-        case Graph_exception::EQN_X:
-            _eqn.grab_focus();
-            _eqn.select_region(start, end);
-            break;
-
-        case Graph_exception::EQN_Y:
-            _eqn_par_y.grab_focus();
-            _eqn_par_y.select_region(start, end);
-            break;
-
-        case Graph_exception::EQN_Z:
-            _eqn_par_z.grab_focus();
-            _eqn_par_z.select_region(start, end);
-            break;
-
-        default:
-            break;
+            std::exception_ptr error = _build_error;
+            _build_error = nullptr;
+            std::rethrow_exception(error);
         }
 
-        // remove and delete the partiall constructed graph object
-        _graph.reset();
-        update_cursor("");
-        _gl_window.invalidate();
-        _gl_window.set_active_graph(nullptr);
+        _graph->upload(mesh);
+    }
+    catch(const Graph_exception &e)
+    {
+        show_graph_error(e);
+        return;
+    }
+    catch(const std::exception &e)
+    {
+        show_graph_error(e);
         return;
     }
 
+    finish_apply();
+}
+
+// show an error from creating or building the graph, and throw the graph away
+void Graph_page::show_graph_error(const Graph_exception & e)
+{
+    // show parsing error message
+    Gtk::MessageDialog error_dialog(e.GetMsg(), false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+    error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
+    error_dialog.set_title("Error");
+    error_dialog.set_secondary_text("In Expression: " + e.GetExpr());
+    error_dialog.run();
+
+    // highlight the location of the error
+    int start, end;
+    if(e.GetToken().size() > 0 && e.GetPos() < e.GetExpr().size())
+    {
+        start = e.GetPos();
+        end = e.GetPos() + e.GetToken().size();
+    }
+    else
+    {
+        start = 0;
+        end = -1;
+    }
+
+    switch(e.GetLocation())
+    {
+    case Graph_exception::ROW_MIN:
+        _row_min.grab_focus();
+        _row_min.select_region(start, end);
+        break;
+
+    case Graph_exception::ROW_MAX:
+        _row_max.grab_focus();
+        _row_max.select_region(start, end);
+        break;
+
+    case Graph_exception::COL_MIN:
+        _col_min.grab_focus();
+        _col_min.select_region(start, end);
+        break;
+
+    case Graph_exception::COL_MAX:
+        _col_max.grab_focus();
+        _col_max.select_region(start, end);
+        break;
+
+    case Graph_exception::Z_MIN:
+        _z_min.grab_focus();
+        _z_min.select_region(start, end);
+        break;
+
+    case Graph_exception::Z_MAX:
+        _z_max.grab_focus();
+        _z_max.select_region(start, end);
+        break;
+
+    case Graph_exception::EQN:
+    case Graph_exception::EQN_X:
+        _eqn.grab_focus();
+        _eqn.select_region(start, end);
+        break;
+
+    case Graph_exception::EQN_Y:
+        _eqn_par_y.grab_focus();
+        _eqn_par_y.select_region(start, end);
+        break;
+
+    case Graph_exception::EQN_Z:
+        _eqn_par_z.grab_focus();
+        _eqn_par_z.select_region(start, end);
+        break;
+
+    default:
+        break;
+    }
+
+    // remove and delete the partially constructed graph object
+    _graph.reset();
+    update_cursor("");
+    _gl_window.invalidate();
+    _gl_window.set_active_graph(nullptr);
+}
+
+// show an error from building the graph that isn't from an equation, and throw the graph away
+void Graph_page::show_graph_error(const std::exception & e)
+{
+    Gtk::MessageDialog error_dialog(e.what(), false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+    error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
+    error_dialog.set_title("Error");
+    error_dialog.set_secondary_text("");
+    error_dialog.run();
+
+    _graph.reset();
+    update_cursor("");
+    _gl_window.invalidate();
+    _gl_window.set_active_graph(nullptr);
+}
+
+// set the graph's properties from the widgets, and show it
+void Graph_page::finish_apply()
+{
     // set graph properties
     _graph->draw_flag = _draw.get_active();
     _graph->transparent_flag = _transparent.get_active();
     _graph->draw_normals_flag = _draw_normals.get_active();
     _graph->draw_grid_flag = _draw_grid.get_active();
+    _graph->draw_contours_flag = _draw_contours.get_active();
+    _graph->grid_density = _grid_density.get_value();
     _graph->use_tex = _use_tex.get_active();
 
     // set the texture
@@ -442,8 +884,46 @@ void Graph_page::apply()
     }
     _graph->color = _color;
     _graph->transparency = _transparency.get_value();
+    change_contours();
+
+    // show memory used, build time, vertex cache use, and how long ambient occlusion took, until the cursor moves
+    std::string status = _graph->cursor_text();
+    std::ostringstream build_text;
+    build_text.precision(3);
+    build_text<<(status.empty() ? "" : "  ")<<"(";
+
+    // shared index buffers are counted by the graph that made them
+    std::vector<Graph::Section_stats> sections = _graph->section_stats();
+    size_t vertex_bytes = 0, index_bytes = 0;
+    double build_seconds = 0.0, slowest_section = 0.0;
+    Vertex_cache_stats cache_stats;
+    for(const auto & section: sections)
+    {
+        cache_stats.add(section.cache_stats);
+        vertex_bytes += section.vertex_bytes;
+        if(!section.shared_indexes)
+            index_bytes += section.index_bytes;
+        build_seconds += section.build_seconds;
+        slowest_section = std::max(slowest_section, section.build_seconds);
+    }
+
+    build_text<<sections.size()<<(sections.size() == 1 ? " section, " : " sections, ")
+        <<(double)vertex_bytes / (1024.0 * 1024.0)<<" MiB vertex data, "
+        <<(double)index_bytes / (1024.0 * 1024.0)<<" MiB indexes, built in "<<build_seconds<<" s";
+    if(sections.size() > 1)
+        build_text<<", slowest section "<<slowest_section<<" s";
+    // average vertex cache misses per triangle, for the strips as drawn and as full width rows
+    if(cache_stats.num_triangles > 0)
+    {
+        build_text<<", vertex cache ACMR "<<(double)cache_stats.misses / cache_stats.num_triangles<<" in column blocks, "
+            <<(double)cache_stats.row_misses / cache_stats.num_triangles<<" in rows";
+    }
+    if(_graph->bake_seconds() > 0.0)
+        build_text<<", ambient occlusion baked in "<<_graph->bake_seconds()<<" s";
+    build_text<<")";
+    status += build_text.str();
 
-    update_cursor(_graph->cursor_text());
+    update_cursor(status);
 
     // register and set active with display
     _gl_window.add_graph(_graph.get());
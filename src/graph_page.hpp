@@ -23,9 +23,15 @@
 #ifndef GRAPH_PAGE_H
 #define GRAPH_PAGE_H
 
+#include <atomic>
+#include <exception>
 #include <memory>
 #include <string>
+#include <thread>
 
+#include <glibmm/dispatcher.h>
+
+#include <gtkmm/button.h>
 #include <gtkmm/checkbutton.h>
 #include <gtkmm/entry.h>
 #include <gtkmm/grid.h>
@@ -61,6 +67,9 @@ public:
     // signaled when the cursor has moved and needs updating
     sigc::signal<void, const std::string &> signal_cursor_moved() const;
 
+    // signaled when the graph has been measured, or the measurements are out of date and should be cleared
+    sigc::signal<void, const std::string &> signal_measured() const;
+
     // signaled when the user selects a new texture
     sigc::signal<void, const Glib::RefPtr<Gdk::Pixbuf> &> signal_tex_changed() const;
 
@@ -73,12 +82,36 @@ private:
     void change_flags();
     // called when changing transparency
     void change_transparency();
+    // called when the shader gridline settings are changed
+    void change_grid();
+    // called when decimation is toggled
+    void change_decimation();
+    // called on the building thread while ambient occlusion is baked, with the fraction done
+    void update_bake_progress(const float fraction);
+    // shows the bake progress. called on the main thread, through _bake_progress_dispatcher
+    void show_bake_progress();
+    // called when the contour levels are changed
+    void change_contours();
+    // called when the measure button is pressed. refined measurements are taken on their own thread
+    void measure();
+    // show the measurements once they're taken. called through _measure_dispatcher when refining
+    void finish_measure();
+    // set the measurement text, kept until the next measurement or apply
+    void show_measurement(const std::string & text);
     // called when switching between color and texture
     void change_coloring();
     // called when the color or texture is changed
     void change_tex();
     // apply changes and create/update graph
     void apply();
+    // upload the graph once it's been built in the background. called through _build_dispatcher
+    void finish_build();
+    // set the graph's properties from the widgets, and show it
+    void finish_apply();
+    // show an error from creating or building the graph, and throw the graph away
+    void show_graph_error(const Graph_exception & e);
+    // the same for other errors from building the graph, like running out of memory
+    void show_graph_error(const std::exception & e);
     // called when the cursor needs changed
     void update_cursor(const std::string & text) const;
 
@@ -87,17 +120,46 @@ private:
     // the graph itself
     std::unique_ptr<Graph> _graph;
 
+    // graphs baking ambient occlusion are built on their own thread. the graph is kept here,
+    // out of reach of the rest of the page, until it's built and moved to _graph
+    std::unique_ptr<Graph> _building_graph;
+    std::thread _build_thread;
+    Mesh_data _built_mesh;
+    std::exception_ptr _build_error;
+    std::atomic<float> _bake_progress;
+    Glib::Dispatcher _bake_progress_dispatcher;
+    Glib::Dispatcher _build_dispatcher;
+
+    // refined measurements are taken on their own thread, with the page locked until they're done
+    std::thread _measure_thread;
+    Graph::Measurements _measurements;
+    std::exception_ptr _measure_error;
+    Glib::Dispatcher _measure_dispatcher;
+    std::string _measurement_text;
+
     // UI widgets
-    Gtk::RadioButton _r_car, _r_cyl, _r_sph, _r_par; // for selecting type
+    Gtk::RadioButton _r_car, _r_cyl, _r_sph, _r_par, _r_imp; // for selecting type
     Gtk::Entry _eqn; // equation entry
     Gtk::Entry _eqn_par_y, _eqn_par_z; // extra boxes for parametric graphs
     Gtk::Entry _row_min, _row_max; // bounds
     Gtk::Entry _col_min, _col_max;
+    Gtk::Entry _z_min, _z_max; // extra bounds for implicit graphs
     Gtk::Label _row_res_l, _col_res_l; // resolution
     Gtk::SpinButton _row_res, _col_res;
     Gtk::RadioButton _use_color, _use_tex; // color/texture selection
     Image_button _tex_butt; // color / texture chooser
-    Gtk::CheckButton _draw, _transparent, _draw_normals, _draw_grid; // selects what is drawn
+    Gtk::CheckButton _draw, _transparent, _draw_normals, _draw_grid, _draw_contours; // selects what is drawn
+    Gtk::CheckButton _shader_grid; // draw gridlines in the surface's shader. takes effect when applied
+    Gtk::SpinButton _grid_density; // number of cells for shader gridlines
+    Gtk::CheckButton _ambient_occlusion; // bake ambient occlusion. takes effect when applied
+    Gtk::CheckButton _normal_map; // shade with a finer normal map. takes effect when applied
+    Gtk::CheckButton _decimate; // simplify the surface. takes effect when applied
+    Gtk::SpinButton _decimate_error; // how far decimation may move the surface
+    Gtk::Label _decimate_target_l;
+    Gtk::SpinButton _decimate_target; // triangles to stop decimating at. 0 for no limit
+    Gtk::Button _measure; // measure area, volume of the graph
+    Gtk::CheckButton _refine_measure; // measure by evaluating the equation, instead of from the sampled points
+    Gtk::Entry _contour_levels; // heights to draw contours at
     Gtk::Label _transparency_l;
     Gtk::Scale _transparency;
 
@@ -109,6 +171,7 @@ private:
 
     // signal types
     sigc::signal<void, const std::string &> _signal_cursor_moved;
+    sigc::signal<void, const std::string &> _signal_measured;
     sigc::signal<void, const Glib::RefPtr<Gdk::Pixbuf> &> _signal_tex_changed;
 
     // make non-copyable
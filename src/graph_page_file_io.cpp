@@ -40,6 +40,7 @@ void Graph_page::save_graph(const std::string & filename)
     cfg_root.add("r_cyl", libconfig::Setting::TypeBoolean) = _r_cyl.get_active();
     cfg_root.add("r_sph", libconfig::Setting::TypeBoolean) = _r_sph.get_active();
     cfg_root.add("r_par", libconfig::Setting::TypeBoolean) = _r_par.get_active();
+    cfg_root.add("r_imp", libconfig::Setting::TypeBoolean) = _r_imp.get_active();
 
     cfg_root.add("eqn", libconfig::Setting::TypeString) = _eqn.get_text();
     cfg_root.add("eqn_par_y", libconfig::Setting::TypeString) = _eqn_par_y.get_text();
@@ -49,6 +50,8 @@ void Graph_page::save_graph(const std::string & filename)
     cfg_root.add("row_max", libconfig::Setting::TypeString) = _row_max.get_text();
     cfg_root.add("col_min", libconfig::Setting::TypeString) = _col_min.get_text();
     cfg_root.add("col_max", libconfig::Setting::TypeString) = _col_max.get_text();
+    cfg_root.add("z_min", libconfig::Setting::TypeString) = _z_min.get_text();
+    cfg_root.add("z_max", libconfig::Setting::TypeString) = _z_max.get_text();
 
     cfg_root.add("row_res", libconfig::Setting::TypeInt) = _row_res.get_value_as_int();
     cfg_root.add("col_res", libconfig::Setting::TypeInt) = _col_res.get_value_as_int();
@@ -57,6 +60,15 @@ void Graph_page::save_graph(const std::string & filename)
     cfg_root.add("transparent", libconfig::Setting::TypeBoolean) = _transparent.get_active();
     cfg_root.add("draw_normals", libconfig::Setting::TypeBoolean) = _draw_normals.get_active();
     cfg_root.add("draw_grid", libconfig::Setting::TypeBoolean) = _draw_grid.get_active();
+    cfg_root.add("draw_contours", libconfig::Setting::TypeBoolean) = _draw_contours.get_active();
+    cfg_root.add("shader_grid", libconfig::Setting::TypeBoolean) = _shader_grid.get_active();
+    cfg_root.add("grid_density", libconfig::Setting::TypeFloat) = _grid_density.get_value();
+    cfg_root.add("ambient_occlusion", libconfig::Setting::TypeBoolean) = _ambient_occlusion.get_active();
+    cfg_root.add("normal_map", libconfig::Setting::TypeBoolean) = _normal_map.get_active();
+    cfg_root.add("decimate", libconfig::Setting::TypeBoolean) = _decimate.get_active();
+    cfg_root.add("decimate_error", libconfig::Setting::TypeFloat) = _decimate_error.get_value();
+    cfg_root.add("decimate_target", libconfig::Setting::TypeInt) = _decimate_target.get_value_as_int();
+    cfg_root.add("contour_levels", libconfig::Setting::TypeString) = _contour_levels.get_text();
 
     cfg_root.add("use_color", libconfig::Setting::TypeBoolean) = _use_color.get_active();
     cfg_root.add("use_tex", libconfig::Setting::TypeBoolean) = _use_tex.get_active();
@@ -103,13 +115,18 @@ bool Graph_page::load_graph(const std::string & filename)
         bool r_cyl = cfg_root["r_cyl"];
         bool r_sph = cfg_root["r_sph"];
         bool r_par = cfg_root["r_par"];
+        // implicit graphs were added later, so older files won't have this
+        bool r_imp = false;
+        try { r_imp = cfg_root["r_imp"]; }
+        catch(const libconfig::SettingNotFoundException) {}
+
         // one and only one should be set
-        if((int)r_car + (int)r_cyl + (int)r_sph + (int)r_par != 1)
+        if((int)r_car + (int)r_cyl + (int)r_sph + (int)r_par + (int)r_imp != 1)
         {
             // show error message box
             Gtk::MessageDialog error_dialog("Error parsing " + filename, false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
             error_dialog.set_transient_for(*dynamic_cast<Gtk::Window *>(get_toplevel()));
-            error_dialog.set_secondary_text("Invalid combination of r_car, r_cyl, r_sph, r_par");
+            error_dialog.set_secondary_text("Invalid combination of r_car, r_cyl, r_sph, r_par, r_imp");
             error_dialog.set_title("Error");
             error_dialog.run();
             return false;
@@ -119,6 +136,7 @@ bool Graph_page::load_graph(const std::string & filename)
         _r_cyl.set_active(r_cyl);
         _r_sph.set_active(r_sph);
         _r_par.set_active(r_par);
+        _r_imp.set_active(r_imp);
 
         bool use_color = cfg_root["use_color"];
         bool use_tex = cfg_root["use_tex"];
@@ -168,6 +186,20 @@ bool Graph_page::load_graph(const std::string & filename)
         try { _col_max.set_text(static_cast<const char *>(cfg_root["col_max"])); }
         catch(const libconfig::SettingNotFoundException) { complete = false; }
 
+        try { _z_min.set_text(static_cast<const char *>(cfg_root["z_min"])); }
+        catch(const libconfig::SettingNotFoundException)
+        {
+            if(r_imp)
+                complete = false;
+        }
+
+        try { _z_max.set_text(static_cast<const char *>(cfg_root["z_max"])); }
+        catch(const libconfig::SettingNotFoundException)
+        {
+            if(r_imp)
+                complete = false;
+        }
+
         // non-required settings
         try { _row_res.get_adjustment()->set_value(static_cast<int>(cfg_root["row_res"])); }
         catch(const libconfig::SettingNotFoundException) {}
@@ -187,6 +219,33 @@ bool Graph_page::load_graph(const std::string & filename)
         try { _draw_grid.set_active(static_cast<bool>(cfg_root["draw_grid"])); }
         catch(const libconfig::SettingNotFoundException) {}
 
+        try { _draw_contours.set_active(static_cast<bool>(cfg_root["draw_contours"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _shader_grid.set_active(static_cast<bool>(cfg_root["shader_grid"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _grid_density.get_adjustment()->set_value(static_cast<float>(cfg_root["grid_density"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _ambient_occlusion.set_active(static_cast<bool>(cfg_root["ambient_occlusion"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _normal_map.set_active(static_cast<bool>(cfg_root["normal_map"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _decimate.set_active(static_cast<bool>(cfg_root["decimate"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _decimate_error.get_adjustment()->set_value(static_cast<float>(cfg_root["decimate_error"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _decimate_target.get_adjustment()->set_value(static_cast<int>(cfg_root["decimate_target"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
+        try { _contour_levels.set_text(static_cast<const char *>(cfg_root["contour_levels"])); }
+        catch(const libconfig::SettingNotFoundException) {}
+
         try { _tex_filename = static_cast<const char *>(cfg_root["tex_filename"]); }
         catch(const libconfig::SettingNotFoundException) {}
 
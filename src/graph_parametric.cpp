@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <iomanip>
+#include <memory>
 #include <sstream>
 
 #include "graph_parametric.hpp"
@@ -109,7 +110,12 @@ Graph_parametric::Graph_parametric(const std::string & eqn_x,
     _p_z.DefineVar("v", &_v);
     _p_z.SetExpr(_eqn_z);
 
-    build_graph();
+    // initialize cursor
+    _cursor_u = (_u_max - _u_min) / 2.0 + _u_min;
+    _cursor_v = (_v_max - _v_min) / 2.0 + _v_min;
+    _cursor_pos = eval(_cursor_u, _cursor_v);
+    _cursor_defined = is_defined(_cursor_pos);
+    _signal_cursor_moved.emit(cursor_text());
 }
 
 // evaluate a point on the graph
@@ -151,188 +157,49 @@ glm::vec3 Graph_parametric::eval(const double u, const double v)
 }
 
 // calculate & build graph geometry
-void Graph_parametric::build_graph()
+void Graph_parametric::build_graph(const Tile_sink & sink)
+{
+    // calculate coords, texture cords, and normals, and pass them on to sink a tile at a time
+    Parametric_coords sys(_u_min, _u_max, _u_res, _v_min, _v_max, _v_res);
+    build_graph_mesh(sys, [this](const double u, const double v) { return eval(u, v); }, sink);
+}
+
+// sample normals on a finer grid, for a normal map
+void Graph_parametric::build_normals(const size_t scale, Normal_grid & grid)
 {
-    // OpenGL needs to be initialized before this is run, hence it's not in the ctor
-    std::vector<glm::vec3> coords(_v_res * _u_res);
-    std::vector<glm::vec2> tex_coords(_v_res * _u_res);
-    std::vector<glm::vec3> normals(_v_res * _u_res);
-    std::vector<bool> defined(_v_res * _u_res);
-
-    // small offsets for calculating normals
-    float h_u = 1e-3f * (_u_max - _u_min) / (float)_u_res;
-    float h_v = 1e-3f * (_v_max - _v_min) / (float)_v_res;
-
-    // calculate coords, texture cords, and normals
-    double v = _v_max;
-    for(size_t v_i = 0; v_i < _v_res; ++v_i, v -= (_v_max - _v_min) / (double)(_v_res - 1))
+    Parametric_coords sys(_u_min, _u_max, _u_res, _v_min, _v_max, _v_res);
+    // each thread gets its own parsers
+    build_normal_grid(sys, [this]()
     {
-        double u = _u_min;
-        for(size_t u_i = 0; u_i < _u_res; ++u_i,  u += (_u_max - _u_min) / (double)(_u_res - 1))
+        std::shared_ptr<Equation_parser> p_x(new Equation_parser(_eqn_x, "u", "v", Graph_exception::EQN_X));
+        std::shared_ptr<Equation_parser> p_y(new Equation_parser(_eqn_y, "u", "v", Graph_exception::EQN_Y));
+        std::shared_ptr<Equation_parser> p_z(new Equation_parser(_eqn_z, "u", "v", Graph_exception::EQN_Z));
+        return [p_x, p_y, p_z](const double u, const double v)
         {
-            glm::vec3 pos = eval(u, v);
-
-            // check for undefined / infinity
-            if((std::fpclassify(pos.x) != FP_NORMAL &&
-                std::fpclassify(pos.x) != FP_ZERO) ||
-                (std::fpclassify(pos.y) != FP_NORMAL &&
-                std::fpclassify(pos.y) != FP_ZERO) ||
-                (std::fpclassify(pos.z) != FP_NORMAL &&
-                std::fpclassify(pos.z) != FP_ZERO))
-            {
-                // fallback values
-                coords[v_i * _u_res + u_i] = glm::vec3(0.0f);
-                tex_coords[v_i * _u_res + u_i] = glm::vec2(0.0f);
-                normals[v_i * _u_res + u_i] = glm::vec3(0.0f, 0.0f, 1.0f);
-                // set undefined
-                defined[v_i * _u_res + u_i] = false;
-                continue;
-            }
-
-            // add vertex to lists
-            coords[v_i * _u_res + u_i] = pos;
-            tex_coords[v_i * _u_res + u_i] = glm::vec2((float)((u - _u_min) / (_u_max - _u_min)), (float)((_v_max - v) / (_v_max - _v_min)));
-            defined[v_i * _u_res + u_i] = true;
-
-            // calculate surrounding points for normal calculation
-            glm::vec3 up, dn, lf, rt, ul, ur, ll, lr;
-            bool up_def = false, dn_def = false, lf_def = false, rt_def = false,
-                 ul_def = false, ur_def = false, ll_def = false, lr_def = false;
-
-            // add offsets
-            float l_u = (float)u - h_u;
-            float r_u = (float)u + h_u;
-            float u_v = (float)v + h_v;
-            float d_v = (float)v - h_v;
-
-            // ul
-            pos = eval(l_u, u_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                ul_def = true;
-                ul = pos;
-            }
-
-            // up
-            pos = eval(u, u_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                up_def = true;
-                up = pos;
-            }
-
-            // ur
-            pos = eval(r_u, u_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                ur_def = true;
-                ur = pos;
-            }
-
-            // rt
-            pos = eval(r_u, v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                rt_def = true;
-                rt = pos;
-            }
-
-            // lr
-            pos = eval(r_u, d_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                lr_def = true;
-                lr = pos;
-            }
-
-            // dn
-            pos = eval(u, d_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                dn_def = true;
-                dn = pos;
-            }
-
-            // ll
-            pos = eval(l_u, d_v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                ll_def = true;
-                ll = pos;
-            }
-
-            // lf
-            pos = eval(l_u, v);
-            if((std::fpclassify(pos.x) == FP_NORMAL ||
-                std::fpclassify(pos.x) == FP_ZERO) &&
-                (std::fpclassify(pos.y) == FP_NORMAL ||
-                std::fpclassify(pos.y) == FP_ZERO) &&
-                (std::fpclassify(pos.z) == FP_NORMAL ||
-                std::fpclassify(pos.z) == FP_ZERO))
-            {
-                lf_def = true;
-                lf = pos;
-            }
-
-            // get normal
-            normals[v_i * _u_res + u_i] = get_normal(coords[v_i * _u_res + u_i],
-                up, up_def,
-                ur, ur_def,
-                rt, rt_def,
-                lr, lr_def,
-                dn, dn_def,
-                ll, ll_def,
-                lf, lf_def,
-                ul, ul_def);
-        }
-    }
+            return glm::vec3(p_x->eval(u, v), p_y->eval(u, v), p_z->eval(u, v));
+        };
+    }, scale, grid);
+}
 
-    // build OpenGL geometry data from vertexes
-    build_graph_geometry(_v_res, _u_res, coords, tex_coords, normals, defined);
+// evaluate a point on the graph in cartesian coordinates
+bool Graph_parametric::eval_point(const double u, const double v, glm::dvec3 & pos)
+{
+    glm::vec3 p = eval(u, v);
+    pos = glm::dvec3(p);
+    return is_defined(p);
+}
 
-    // initialize cursor
-    _cursor_u = (_u_max - _u_min) / 2.0 + _u_min;
-    _cursor_v = (_v_max - _v_min) / 2.0 + _v_min;
-    _cursor_pos = eval(_cursor_u, _cursor_v);
-    _cursor_defined = (std::fpclassify(_cursor_pos.x) == FP_NORMAL || std::fpclassify(_cursor_pos.x) == FP_ZERO) &&
-        (std::fpclassify(_cursor_pos.y) == FP_NORMAL || std::fpclassify(_cursor_pos.y) == FP_ZERO) &&
-        (std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO);
-    _signal_cursor_moved.emit(cursor_text());
+// evaluate points like eval_point, with a parser of its own
+Graph::Point_eval Graph_parametric::make_point_eval() const
+{
+    std::shared_ptr<Equation_parser> p_x(new Equation_parser(_eqn_x, "u", "v", Graph_exception::EQN_X));
+    std::shared_ptr<Equation_parser> p_y(new Equation_parser(_eqn_y, "u", "v", Graph_exception::EQN_Y));
+    std::shared_ptr<Equation_parser> p_z(new Equation_parser(_eqn_z, "u", "v", Graph_exception::EQN_Z));
+    return [p_x, p_y, p_z](const double u, const double v, glm::dvec3 & pos)
+    {
+        pos = glm::dvec3(p_x->eval(u, v), p_y->eval(u, v), p_z->eval(u, v));
+        return is_defined(glm::vec3(pos));
+    };
 }
 
 // cursor funcs
@@ -366,9 +233,19 @@ void Graph_parametric::move_cursor(const Cursor_dir dir)
 
     // evaluate cursors new position
     _cursor_pos = eval(_cursor_u, _cursor_v);
-    _cursor_defined = (std::fpclassify(_cursor_pos.x) == FP_NORMAL || std::fpclassify(_cursor_pos.x) == FP_ZERO) &&
-        (std::fpclassify(_cursor_pos.y) == FP_NORMAL || std::fpclassify(_cursor_pos.y) == FP_ZERO) &&
-        (std::fpclassify(_cursor_pos.z) == FP_NORMAL || std::fpclassify(_cursor_pos.z) == FP_ZERO);
+    _cursor_defined = is_defined(_cursor_pos);
+
+    // signal the move
+    _signal_cursor_moved.emit(cursor_text());
+}
+
+void Graph_parametric::set_cursor(const double u, const double v)
+{
+    // evaluate cursors new position
+    _cursor_u = u;
+    _cursor_v = v;
+    _cursor_pos = eval(_cursor_u, _cursor_v);
+    _cursor_defined = is_defined(_cursor_pos);
 
     // signal the move
     _signal_cursor_moved.emit(cursor_text());
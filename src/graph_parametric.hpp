@@ -24,6 +24,38 @@
 #define GRAPH_PARAMETRIC_H
 
 #include "graph.hpp"
+#include "graph_sampler.hpp"
+
+// Parametric coordinate system policy for sample_graph
+// columns are u, rows are v (decreasing)
+struct Parametric_coords
+{
+    typedef glm::vec3 Value;
+    typedef float Col_data;
+    typedef float Row_data;
+
+    Parametric_coords(const double u_min, const double u_max, const size_t u_res,
+        const double v_min, const double v_max, const size_t v_res):
+        columns(u_min, u_max, u_res), rows(v_max, v_min, v_res)
+    {}
+
+    static Col_data col_data(const double u) { return (float)u; }
+    static Row_data row_data(const double v) { return (float)v; }
+
+    // equations already give cartesian coordinates
+    static glm::vec3 transform(const Col_data u, const Row_data v, const Value & pos)
+    {
+        return pos;
+    }
+
+    glm::vec2 tex_coord(const double u, const double v, const glm::vec3 & pos) const
+    {
+        return glm::vec2((float)((u - columns.start) / (columns.end - columns.start)),
+            (float)((rows.start - v) / (rows.start - rows.end)));
+    }
+
+    Grid_axis columns, rows;
+};
 
 // Parametric graph class - x(u,v), y(u,v), z(u,v)
 class Graph_parametric final: public Graph
@@ -38,10 +70,17 @@ public:
     // evaluate a point on the graph
     glm::vec3 eval(const double u, const double v);
     // calculate & build graph geometry
-    void build_graph() override;
+    void build_graph(const Tile_sink & sink) override;
+    // sample normals on a finer grid, for a normal map
+    void build_normals(const size_t scale, Normal_grid & grid) override;
+    // evaluate a point on the graph in cartesian coordinates
+    bool eval_point(const double u, const double v, glm::dvec3 & pos) override;
+    // evaluate points like eval_point, with a parser of its own, for use on other threads
+    Point_eval make_point_eval() const override;
 
     // cursor funcs
     void move_cursor(const Cursor_dir dir) override;
+    void set_cursor(const double u, const double v) override;
     glm::vec3 cursor_pos() const override;
     bool cursor_defined() const override;
     // return cursor position as a string
@@ -0,0 +1,649 @@
+// graph_sampler.hpp
+// generic grid sampling for all coordinate systems
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef GRAPH_SAMPLER_H
+#define GRAPH_SAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "graph.hpp"
+#include "parallel.hpp"
+
+// one independent variable axis of the sampling grid
+// runs from start to end (which may be in decreasing order)
+struct Grid_axis
+{
+    Grid_axis(const double start, const double end, const size_t res):
+        start(start), end(end), res(res),
+        step(res > 1 ? (end - start) / (double)(res - 1) : 0.0),
+        h(1e-3f * std::abs(end - start) / (float)res)
+    {}
+
+    // value of the variable at an index along the axis
+    double param(const size_t i) const
+    {
+        return start + step * (double)i;
+    }
+
+    double start, end;
+    size_t res;
+    double step;
+    // small offset for calculating normals
+    float h;
+};
+
+// pre-calculated sine and cosine of an angle
+struct Sin_cos
+{
+    float s, c;
+};
+
+inline Sin_cos sin_cos(const double angle)
+{
+    return {sinf(angle), cosf(angle)};
+}
+
+// check for undefined / infinity
+template<typename T>
+inline bool is_defined(const T val)
+{
+    return std::fpclassify(val) == FP_NORMAL || std::fpclassify(val) == FP_ZERO;
+}
+
+inline bool is_defined(const glm::vec3 & val)
+{
+    return is_defined(val.x) && is_defined(val.y) && is_defined(val.z);
+}
+
+// a band of rows of the sampling grid, as it passes through the sampling stages
+// each point has a 3x3 stencil of samples around it, for calculating normals,
+// stored at [point * 9 + row offset * 3 + column offset]
+template<typename Value>
+struct Sample_tile
+{
+    std::vector<Value> samples;
+    std::vector<char> samples_def;
+    std::vector<glm::vec3> pts;
+
+    // finished vertex data
+    Mesh_data geom;
+};
+
+// samples a graph's equation over a grid, and converts it to vertex data
+// Coord_sys is a coordinate system policy class, providing:
+//     Grid_axis columns, rows;                    independent variable axes
+//     typedef Value;                              type returned by eval
+//     typedef Col_data, Row_data;                 per column / row values for transform
+//     static Col_data col_data(double col_param); pre-calculate column values
+//     static Row_data row_data(double row_param); pre-calculate row values
+//     static glm::vec3 transform(Col_data, Row_data, Value);
+//                                                 convert to cartesian coordinates
+//     glm::vec2 tex_coord(double col_param, double row_param, glm::vec3 pos) const;
+// transform only depends on its arguments, so it can be inlined into the sampling loop,
+// and anything expensive (trig functions, etc.) goes into col_data & row_data,
+// which are only called O(rows + columns) times.
+// work is split into stages that each operate on a tile, so that they can be run
+// concurrently on different tiles. only evaluate (and find_seams) call the graph's equation
+// for periodic domains, where the last column / row of points lands on the first,
+// the seam is only evaluated once, and the first column / row is copied onto the last
+template<typename Coord_sys>
+class Graph_sampler
+{
+public:
+    typedef typename Coord_sys::Value Value;
+    typedef typename Coord_sys::Col_data Col_data;
+    typedef typename Coord_sys::Row_data Row_data;
+    typedef Sample_tile<Value> Tile;
+
+    explicit Graph_sampler(const Coord_sys & sys): _sys(sys)
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t num_rows = _sys.rows.res;
+
+        for(int i = 0; i < 3; ++i)
+        {
+            _col_params[i].resize(num_columns);
+            _col_data[i].resize(num_columns);
+            _row_params[i].resize(num_rows);
+            _row_data[i].resize(num_rows);
+        }
+
+        for(size_t col = 0; col < num_columns; ++col)
+        {
+            double param = _sys.columns.param(col);
+            _col_params[0][col] = (float)param - _sys.columns.h;
+            _col_params[1][col] = param;
+            _col_params[2][col] = (float)param + _sys.columns.h;
+
+            for(int i = 0; i < 3; ++i)
+                _col_data[i][col] = Coord_sys::col_data(_col_params[i][col]);
+        }
+
+        for(size_t row = 0; row < num_rows; ++row)
+        {
+            double param = _sys.rows.param(row);
+            _row_params[0][row] = (float)param - _sys.rows.h;
+            _row_params[1][row] = param;
+            _row_params[2][row] = (float)param + _sys.rows.h;
+
+            for(int i = 0; i < 3; ++i)
+                _row_data[i][row] = Coord_sys::row_data(_row_params[i][row]);
+        }
+    }
+
+    // check each axis for a seam, where the graph wraps around onto itself
+    // the lines next to the seam are compared too, so that the surface has to continue
+    // smoothly across it (and not, for example, flip over like a mobius strip)
+    // must be called before evaluate, if at all
+    template<typename Eval>
+    void find_seams(Eval & eval)
+    {
+        const Grid_axis & columns = _sys.columns;
+        const Grid_axis & rows = _sys.rows;
+
+        _wrap_columns = columns.res > 2;
+        for(size_t row = 0; row < rows.res && _wrap_columns; ++row)
+        {
+            double row_param = rows.param(row);
+            _wrap_columns = same_point(eval, columns.start, row_param, columns.end, row_param)
+                && same_point(eval, columns.start - columns.step, row_param, columns.param(columns.res - 2), row_param);
+        }
+
+        _wrap_rows = rows.res > 2;
+        for(size_t col = 0; col < columns.res && _wrap_rows; ++col)
+        {
+            double col_param = columns.param(col);
+            _wrap_rows = same_point(eval, col_param, rows.start, col_param, rows.end)
+                && same_point(eval, col_param, rows.start - rows.step, col_param, rows.param(rows.res - 2));
+        }
+    }
+
+    // evaluate the equation at each point in the tile, and its surrounding points
+    // eval is called as eval(col_param, row_param) and returns a Value
+    template<typename Eval>
+    void evaluate(Tile & tile, Eval & eval) const
+    {
+        begin_evaluate(tile);
+
+        const size_t num_pts = tile.samples.size() / 9;
+        for(size_t i = 0; i < num_pts; ++i)
+            evaluate_point(tile, i, eval);
+    }
+
+    // make room for the tile's samples, before calling evaluate_point on it
+    void begin_evaluate(Tile & tile) const
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t num_pts = (tile.geom.row_end - tile.geom.row_begin) * num_columns;
+
+        tile.samples.resize(num_pts * 9);
+    }
+
+    // evaluate the equation at the tile's i-th point and its surrounding points
+    // different points can be evaluated at the same time, from different threads, each with its own eval
+    template<typename Eval>
+    void evaluate_point(Tile & tile, const size_t i, Eval & eval) const
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t row = tile.geom.row_begin + i / num_columns;
+        const size_t col = i % num_columns;
+
+        Value * stencil = &tile.samples[i * 9];
+
+        // points on a seam are copied from the other side by weld. leave them undefined for now
+        if(on_seam(row, col))
+        {
+            stencil[4] = Value(std::numeric_limits<float>::quiet_NaN());
+            return;
+        }
+
+        stencil[4] = eval(_col_params[1][col], _row_params[1][row]);
+
+        // don't bother with the surrounding points if this one is undefined
+        if(!is_defined(stencil[4]))
+            return;
+
+        for(int row_off = 0; row_off < 3; ++row_off)
+        {
+            for(int col_off = 0; col_off < 3; ++col_off)
+            {
+                if(row_off != 1 || col_off != 1)
+                    stencil[row_off * 3 + col_off] = eval(_col_params[col_off][col], _row_params[row_off][row]);
+            }
+        }
+    }
+
+    // mark undefined / infinite samples
+    void classify(Tile & tile) const
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t num_rows = tile.geom.row_end - tile.geom.row_begin;
+        const size_t num_pts = tile.samples.size() / 9;
+
+        tile.samples_def.resize(num_pts * 9);
+        classify_defined(tile.samples.data(), tile.samples.size(), tile.samples_def.data());
+
+        // surrounding samples aren't evaluated for undefined points
+        for(size_t i = 0; i < num_pts; ++i)
+        {
+            char center_def = tile.samples_def[i * 9 + 4];
+            for(int j = 0; j < 9; ++j)
+                tile.samples_def[i * 9 + j] &= center_def;
+        }
+
+        // pack flags for the points themselves
+        tile.geom.defined = Defined_mask(num_rows, num_columns);
+        std::vector<char> row_def(num_columns);
+
+        for(size_t row = 0; row < num_rows; ++row)
+        {
+            for(size_t col = 0; col < num_columns; ++col)
+                row_def[col] = tile.samples_def[(row * num_columns + col) * 9 + 4];
+
+            tile.geom.defined.set_row(row, row_def.data());
+        }
+    }
+
+    // convert into cartesian coordinates
+    void transform(Tile & tile) const
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t num_pts = tile.samples.size() / 9;
+
+        tile.pts.resize(num_pts * 9);
+        tile.geom.coords.resize(num_pts);
+        tile.geom.tex_coords.resize(num_pts);
+
+        for(size_t row = tile.geom.row_begin; row < tile.geom.row_end; ++row)
+        {
+            for(size_t col = 0; col < num_columns; ++col)
+            {
+                size_t i = (row - tile.geom.row_begin) * num_columns + col;
+
+                if(!tile.samples_def[i * 9 + 4])
+                {
+                    // fallback values
+                    tile.geom.coords[i] = glm::vec3(0.0f);
+                    tile.geom.tex_coords[i] = glm::vec2(0.0f);
+                    continue;
+                }
+
+                for(int row_off = 0; row_off < 3; ++row_off)
+                {
+                    for(int col_off = 0; col_off < 3; ++col_off)
+                    {
+                        size_t j = i * 9 + row_off * 3 + col_off;
+                        if(tile.samples_def[j])
+                            tile.pts[j] = Coord_sys::transform(_col_data[col_off][col], _row_data[row_off][row], tile.samples[j]);
+                    }
+                }
+
+                tile.geom.coords[i] = tile.pts[i * 9 + 4];
+                tile.geom.tex_coords[i] = _sys.tex_coord(_col_params[1][col], _row_params[1][row], tile.geom.coords[i]);
+            }
+        }
+    }
+
+    // calculate normals from surrounding points
+    void normals(Tile & tile) const
+    {
+        const size_t num_pts = tile.geom.coords.size();
+
+        tile.geom.normals.resize(num_pts);
+        get_normals(tile.pts.data(), tile.samples_def.data(), tile.geom.normals.data(), num_pts);
+    }
+
+    // the first row of the graph, saved by weld for copying onto the last row
+    struct First_row
+    {
+        std::vector<glm::vec3> coords, normals;
+        std::vector<char> defined;
+    };
+
+    // copy the first column / row of points onto the seams, so both sides get exactly the
+    // same positions and normals. texture coords are still calculated for each side.
+    // must be called on each tile in order, after normals
+    void weld(Tile & tile, First_row & first_row) const
+    {
+        const size_t num_columns = _sys.columns.res;
+        const size_t num_rows = tile.geom.row_end - tile.geom.row_begin;
+        Mesh_data & geom = tile.geom;
+
+        auto copy_point = [this, &geom, num_columns](const size_t row, const size_t col,
+            const glm::vec3 & coord, const glm::vec3 & normal, const bool defined)
+        {
+            size_t i = row * num_columns + col;
+            geom.coords[i] = coord;
+            geom.normals[i] = normal;
+            geom.tex_coords[i] = defined ? _sys.tex_coord(_col_params[1][col], _row_params[1][geom.row_begin + row], coord) : glm::vec2(0.0f);
+            geom.defined.set(row, col, defined);
+        };
+
+        if(_wrap_columns)
+        {
+            for(size_t row = 0; row < num_rows; ++row)
+            {
+                size_t i = row * num_columns;
+                copy_point(row, num_columns - 1, geom.coords[i], geom.normals[i], geom.defined.get(row, 0));
+            }
+        }
+
+        if(!_wrap_rows)
+            return;
+
+        if(geom.row_begin == 0)
+        {
+            first_row.coords.assign(geom.coords.begin(), geom.coords.begin() + num_columns);
+            first_row.normals.assign(geom.normals.begin(), geom.normals.begin() + num_columns);
+            first_row.defined.resize(num_columns);
+            for(size_t col = 0; col < num_columns; ++col)
+                first_row.defined[col] = geom.defined.get(0, col);
+        }
+
+        if(geom.row_end == _sys.rows.res)
+        {
+            for(size_t col = 0; col < num_columns; ++col)
+                copy_point(num_rows - 1, col, first_row.coords[col], first_row.normals[col], first_row.defined[col]);
+        }
+    }
+
+private:
+    // true if a point isn't evaluated, because it will be copied from the other side of a seam
+    bool on_seam(const size_t row, const size_t col) const
+    {
+        return (_wrap_columns && col == _sys.columns.res - 1) || (_wrap_rows && row == _sys.rows.res - 1);
+    }
+
+    // evaluate two points and check if they are close enough to be the same
+    template<typename Eval>
+    static bool same_point(Eval & eval, const double col_a, const double row_a, const double col_b, const double row_b)
+    {
+        // relative to the distance from the origin
+        const float tolerance = 1e-5f;
+
+        Value val_a = eval(col_a, row_a);
+        Value val_b = eval(col_b, row_b);
+
+        bool def_a = is_defined(val_a);
+        bool def_b = is_defined(val_b);
+        if(!def_a || !def_b)
+            return def_a == def_b;
+
+        glm::vec3 a = Coord_sys::transform(Coord_sys::col_data(col_a), Coord_sys::row_data(row_a), val_a);
+        glm::vec3 b = Coord_sys::transform(Coord_sys::col_data(col_b), Coord_sys::row_data(row_b), val_b);
+
+        return glm::length(a - b) <= tolerance * std::max(1.0f, std::max(glm::length(a), glm::length(b)));
+    }
+
+    Coord_sys _sys;
+
+    // set when the last column / row lands on the first
+    bool _wrap_columns = false;
+    bool _wrap_rows = false;
+
+    // variable values & pre-calculated data for each column / row, and their normal offsets
+    // index 0 is offset left / down, 1 is on the grid, 2 is offset right / up
+    std::vector<double> _col_params[3], _row_params[3];
+    std::vector<Col_data> _col_data[3];
+    std::vector<Row_data> _row_data[3];
+};
+
+// sample a graph's equation and build geometry from it, a tile at a time
+// stages are: evaluate -> classify -> transform -> normals & weld -> index, bvh & contours -> sink
+// each stage runs on its own thread, so they overlap on consecutive tiles.
+// sink runs on the calling thread, so it may upload to OpenGL.
+// eval is only ever called from the evaluate thread
+template<typename Coord_sys, typename Eval>
+void Graph::build_graph_mesh(const Coord_sys & sys, Eval && eval, const Tile_sink & sink)
+{
+    typedef Graph_sampler<Coord_sys> Sampler;
+    typedef typename Sampler::Tile Tile;
+
+    // number of points to process at once
+    const size_t tile_size = 16384;
+    // number of tiles allowed to wait between each stage
+    const size_t queue_size = 2;
+
+    const size_t num_rows = sys.rows.res;
+    const size_t num_columns = sys.columns.res;
+    const size_t tile_rows = std::max<size_t>(1, tile_size / num_columns);
+
+    Sampler sampler(sys);
+    sampler.find_seams(eval);
+
+    _param_origin = glm::dvec2(sys.columns.start, sys.rows.start);
+    _param_step = glm::dvec2(sys.columns.step, sys.rows.step);
+    _param_grid = true;
+    _bvh.begin(num_rows, num_columns);
+    _measure.begin(num_rows, num_columns);
+
+    // gridlines drawn by the shader find their place from the vertex index
+    _implicit_grid.num_columns = num_columns;
+    _implicit_grid.line_step = glm::vec2(num_columns > 1 ? 1.0f / (num_columns - 1) : 0.0f,
+        num_rows > 1 ? 1.0f / (num_rows - 1) : 0.0f);
+
+    // keep the heights of height fields, for contour lines. only x and y depend on the grid position
+    if(_height_field)
+    {
+        _contours.begin(num_rows, num_columns, [sys](const size_t row, const size_t col, const float height)
+        {
+            glm::vec3 pt = Coord_sys::transform(Coord_sys::col_data(sys.columns.param(col)),
+                Coord_sys::row_data(sys.rows.param(row)), typename Coord_sys::Value());
+            pt.z = height;
+            return pt;
+        });
+    }
+    else
+        _contours.clear();
+
+    Bounded_queue<Tile> evaluated(queue_size), classified(queue_size),
+        transformed(queue_size);
+    Bounded_queue<Mesh_data> with_normals(queue_size), indexed(queue_size);
+
+    // declared after the queues, so stages are stopped before the queues are destroyed
+    Pipeline pipeline;
+    pipeline.add_queue(evaluated);
+    pipeline.add_queue(classified);
+    pipeline.add_queue(transformed);
+    pipeline.add_queue(with_normals);
+    pipeline.add_queue(indexed);
+
+    pipeline.add_source([&]()
+    {
+        for(size_t row = 0; row < num_rows; row += tile_rows)
+        {
+            // a cancelled graph is thrown away, so stop sampling it
+            if(_cancelled)
+            {
+                evaluated.close();
+                pipeline.cancel();
+                return;
+            }
+
+            Tile tile;
+            tile.geom.num_rows = num_rows;
+            tile.geom.num_columns = num_columns;
+            tile.geom.row_begin = row;
+            tile.geom.row_end = std::min(row + tile_rows, num_rows);
+
+            sampler.evaluate(tile, eval);
+            if(!evaluated.push(std::move(tile)))
+                return;
+        }
+        evaluated.close();
+    });
+
+    pipeline.add_stage(evaluated, classified, [&sampler](Tile & tile)
+    {
+        sampler.classify(tile);
+        return std::move(tile);
+    });
+
+    pipeline.add_stage(classified, transformed, [&sampler](Tile & tile)
+    {
+        sampler.transform(tile);
+        return std::move(tile);
+    });
+
+    // sample data is dropped here, only vertex data continues
+    typename Sampler::First_row first_row;
+    pipeline.add_stage(transformed, with_normals, [&sampler, &first_row](Tile & tile)
+    {
+        sampler.normals(tile);
+        sampler.weld(tile, first_row);
+        return std::move(tile.geom);
+    });
+
+    std::vector<Defined_mask::Word> prev_row_defined;
+    pipeline.add_stage(with_normals, indexed, [&](Mesh_data & tile)
+    {
+        index_graph_tile(tile, prev_row_defined, optimize_index_order, !shader_grid_flag);
+        _bvh.add_rows(tile.row_begin, tile.row_end, tile.coords.data(), tile.defined);
+        _measure.add_rows(tile.row_begin, tile.row_end, tile.coords.data(), tile.defined);
+        if(_height_field)
+            _contours.add_rows(tile.row_begin, tile.row_end, tile.coords.data(), tile.defined);
+        return std::move(tile);
+    });
+
+    // pass on tiles as they become ready
+    Mesh_data tile;
+    while(indexed.pop(tile))
+        sink(tile);
+
+    // rethrows any errors from the other stages
+    pipeline.join();
+
+    _bvh.end();
+}
+
+// sample normals on a grid scale times finer than sys's, for a normal map
+// stages are: evaluate -> classify -> transform -> normals & weld -> copy into grid
+// the finer grid covers the same range, so every scale-th point lands on a vertex of the graph,
+// and gets the same normal it has. none of the graph's built state (bvh, contours, etc.) is touched.
+// there are many times more points than the graph has, so each tile's points are evaluated
+// over the thread pool, with an eval for each thread from make_eval
+template<typename Coord_sys, typename Make_eval>
+void Graph::build_normal_grid(const Coord_sys & sys, Make_eval && make_eval, const size_t scale, Normal_grid & grid)
+{
+    typedef Graph_sampler<Coord_sys> Sampler;
+    typedef typename Sampler::Tile Tile;
+    typedef decltype(make_eval()) Eval;
+
+    // number of points to process at once
+    const size_t tile_size = 16384;
+    // number of tiles allowed to wait between each stage
+    const size_t queue_size = 2;
+
+    Coord_sys fine = sys;
+    fine.columns = Grid_axis(sys.columns.start, sys.columns.end, (sys.columns.res - 1) * scale + 1);
+    fine.rows = Grid_axis(sys.rows.start, sys.rows.end, (sys.rows.res - 1) * scale + 1);
+
+    const size_t num_rows = fine.rows.res;
+    const size_t num_columns = fine.columns.res;
+    const size_t tile_rows = std::max<size_t>(1, tile_size / num_columns);
+
+    std::vector<Eval> evals;
+    for(size_t i = 0; i < Thread_pool::get().num_threads(); ++i)
+        evals.push_back(make_eval());
+
+    Sampler sampler(fine);
+    sampler.find_seams(evals.front());
+
+    grid.num_rows = num_rows;
+    grid.num_columns = num_columns;
+    grid.normals.assign(num_rows * num_columns, glm::vec3(0.0f));
+
+    Bounded_queue<Tile> evaluated(queue_size), classified(queue_size),
+        transformed(queue_size);
+    Bounded_queue<Mesh_data> with_normals(queue_size);
+
+    // declared after the queues, so stages are stopped before the queues are destroyed
+    Pipeline pipeline;
+    pipeline.add_queue(evaluated);
+    pipeline.add_queue(classified);
+    pipeline.add_queue(transformed);
+    pipeline.add_queue(with_normals);
+
+    pipeline.add_source([&]()
+    {
+        for(size_t row = 0; row < num_rows; row += tile_rows)
+        {
+            Tile tile;
+            tile.geom.num_rows = num_rows;
+            tile.geom.num_columns = num_columns;
+            tile.geom.row_begin = row;
+            tile.geom.row_end = std::min(row + tile_rows, num_rows);
+
+            sampler.begin_evaluate(tile);
+            Thread_pool::get().parallel_for(evals, 0, tile.samples.size() / 9, [&sampler, &tile](Eval & eval, const size_t i)
+            {
+                sampler.evaluate_point(tile, i, eval);
+            });
+
+            if(!evaluated.push(std::move(tile)))
+                return;
+        }
+        evaluated.close();
+    });
+
+    pipeline.add_stage(evaluated, classified, [&sampler](Tile & tile)
+    {
+        sampler.classify(tile);
+        return std::move(tile);
+    });
+
+    pipeline.add_stage(classified, transformed, [&sampler](Tile & tile)
+    {
+        sampler.transform(tile);
+        return std::move(tile);
+    });
+
+    typename Sampler::First_row first_row;
+    pipeline.add_stage(transformed, with_normals, [&sampler, &first_row](Tile & tile)
+    {
+        sampler.normals(tile);
+        sampler.weld(tile, first_row);
+        return std::move(tile.geom);
+    });
+
+    // undefined points are left as zero
+    Mesh_data tile;
+    while(with_normals.pop(tile))
+    {
+        for(size_t i = 0; i < tile.normals.size(); ++i)
+        {
+            if(tile.defined.get(i / num_columns, i % num_columns))
+                grid.normals[tile.row_begin * num_columns + i] = tile.normals[i];
+        }
+    }
+
+    // rethrows any errors from the other stages
+    pipeline.join();
+}
+
+#endif // GRAPH_SAMPLER_H
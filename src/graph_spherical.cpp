@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <iomanip>
+#include <memory>
 #include <sstream>
 
 #include "graph_spherical.hpp"
@@ -90,7 +91,15 @@ Graph_spherical::Graph_spherical(const std::string & eqn,
     _p.DefineVar("phi", &_phi);
     _p.SetExpr(eqn);
 
-    build_graph();
+    // initialize cursor
+    _cursor_theta =  (_theta_max - _theta_min) / 2.0 + _theta_min;
+    _cursor_phi =  (_phi_max - _phi_min) / 2.0 + _phi_min;
+    _cursor_r = eval(_cursor_theta, _cursor_phi);
+    _cursor_pos.x = _cursor_r * sinf(_cursor_phi) * cosf(_cursor_theta);
+    _cursor_pos.y = _cursor_r * sinf(_cursor_phi) * sinf(_cursor_theta);
+    _cursor_pos.z = _cursor_r * cosf(_cursor_phi);
+    _cursor_defined = is_defined(_cursor_r);
+    _signal_cursor_moved.emit(cursor_text());
 }
 
 // evaluate a point on the graph
@@ -109,157 +118,43 @@ double Graph_spherical::eval(const double theta, const double phi)
 }
 
 // calculate & build graph geometry
-void Graph_spherical::build_graph()
+void Graph_spherical::build_graph(const Tile_sink & sink)
 {
-    // OpenGL needs to be initialized before this is run, hence it's not in the ctor
-    std::vector<glm::vec3> coords(_theta_res * _phi_res);
-    std::vector<glm::vec2> tex_coords(_theta_res * _phi_res);
-    std::vector<glm::vec3> normals(_theta_res * _phi_res);
-    std::vector<bool> defined(_theta_res * _phi_res);
-
-    // small offsets for calculating normals
-    float h_phi = 1e-3f * (_phi_max - _phi_min) / (float)_phi_res;
-    float h_theta = 1e-3f * (_theta_max - _theta_min) / (float)_theta_res;
+    // calculate coords, texture cords, and normals, and pass them on to sink a tile at a time
+    Spherical_coords sys(_theta_min, _theta_max, _theta_res, _phi_min, _phi_max, _phi_res);
+    build_graph_mesh(sys, [this](const double theta, const double phi) { return eval(theta, phi); }, sink);
+}
 
-    // calculate coords, texture cords, and normals
-    double phi = _phi_min;
-    for(size_t phi_i = 0; phi_i < _phi_res; ++phi_i,  phi += (_phi_max - _phi_min) / (double)(_phi_res - 1))
+// sample normals on a finer grid, for a normal map
+void Graph_spherical::build_normals(const size_t scale, Normal_grid & grid)
+{
+    Spherical_coords sys(_theta_min, _theta_max, _theta_res, _phi_min, _phi_max, _phi_res);
+    // each thread gets its own parser
+    build_normal_grid(sys, [this]()
     {
-        double theta = _theta_max;
-        for(size_t theta_i = 0; theta_i < _theta_res; ++theta_i, theta -= (_theta_max - _theta_min) / (double)(_theta_res - 1))
-        {
-            double r = eval(theta, phi);
-
-            // check for undefined / infinity
-            if(std::fpclassify(r) != FP_NORMAL &&
-                std::fpclassify(r) != FP_ZERO)
-            {
-                // fallback values
-                coords[phi_i * _theta_res + theta_i] = glm::vec3(0.0f);
-                tex_coords[phi_i * _theta_res + theta_i] = glm::vec2(0.0f);
-                normals[phi_i * _theta_res + theta_i] = glm::vec3(0.0f, 0.0f, 1.0f);
-                // set undefined
-                defined[phi_i * _theta_res + theta_i] = false;
-                continue;
-            }
-
-            // convert into cartesian coordinates
-            // add vertex to lists
-            coords[phi_i * _theta_res + theta_i] = glm::vec3((float)r * sinf(phi) * cosf(theta),
-                (float)r * sinf(phi) * sinf(theta), (float)r * cosf(phi));
-            tex_coords[phi_i * _theta_res + theta_i] = glm::vec2(
-                    (float)((theta - _theta_min) / (_theta_max - _theta_min)),
-                    (float)((phi - _phi_min) / (_phi_max - _phi_min)));
-            defined[phi_i * _theta_res + theta_i] = true;
-
-            // calculate surrounding points for normal calculation
-            glm::vec3 up, dn, lf, rt, ul, ur, ll, lr;
-            bool up_def = false, dn_def = false, lf_def = false, rt_def = false,
-                 ul_def = false, ur_def = false, ll_def = false, lr_def = false;
-
-            // add offsets
-            float l_theta = (float)theta - h_theta;
-            float r_theta = (float)theta + h_theta;
-            float u_phi = (float)phi + h_phi;
-            float d_phi = (float)phi - h_phi;
-
-            // ul
-            r = eval(l_theta, u_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                ul_def = true;
-                ul = glm::vec3(r * sinf(u_phi) * cosf(l_theta), r * sinf(u_phi) * sinf(l_theta), r * cosf(u_phi));
-            }
-
-            // up
-            r = eval(theta, u_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                up_def = true;
-                up = glm::vec3(r * sinf(u_phi) * cosf(theta), r * sinf(u_phi) * sinf(theta), r * cosf(u_phi));
-            }
-
-            // ur
-            r = eval(r_theta, u_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                ur_def = true;
-                ur = glm::vec3(r * sinf(u_phi) * cosf(r_theta), r * sinf(u_phi) * sinf(r_theta), r * cosf(u_phi));
-            }
-
-            // rt
-            r = eval(r_theta, phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                rt_def = true;
-                rt = glm::vec3(r * sinf(phi) * cosf(r_theta), r * sinf(phi) * sinf(r_theta), r * cosf(phi));
-            }
-
-            // lr
-            r = eval(r_theta, d_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                lr_def = true;
-                lr = glm::vec3(r * sinf(d_phi) * cosf(r_theta), r * sinf(d_phi) * sinf(r_theta), r * cosf(d_phi));
-            }
-
-            // dn
-            r = eval(theta, d_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                dn_def = true;
-                dn = glm::vec3(r * sinf(d_phi) * cosf(theta), r * sinf(d_phi) * sinf(theta), r * cosf(d_phi));
-            }
-
-            // ll
-            r = eval(l_theta, d_phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                ll_def = true;
-                ll = glm::vec3(r * sinf(d_phi) * cosf(l_theta), r * sinf(d_phi) * sinf(l_theta), r * cosf(d_phi));
-            }
-
-            // lf
-            r = eval(l_theta, phi);
-            if(std::fpclassify(r) == FP_NORMAL ||
-                std::fpclassify(r) == FP_ZERO)
-            {
-                lf_def = true;
-                lf = glm::vec3(r * sinf(phi) * cosf(l_theta), r * sinf(phi) * sinf(l_theta), r * cosf(phi));
-            }
-
-            // get normal
-            normals[phi_i * _theta_res + theta_i] = get_normal(coords[phi_i * _theta_res + theta_i],
-                up, up_def,
-                ur, ur_def,
-                rt, rt_def,
-                lr, lr_def,
-                dn, dn_def,
-                ll, ll_def,
-                lf, lf_def,
-                ul, ul_def);
-        }
-    }
+        std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "theta", "phi", Graph_exception::EQN));
+        return [p](const double theta, const double phi) { return p->eval(theta, phi); };
+    }, scale, grid);
+}
 
-    // build OpenGL geometry data from vertexes
-    build_graph_geometry(_theta_res, _phi_res, coords, tex_coords, normals, defined);
+// evaluate a point on the graph in cartesian coordinates
+bool Graph_spherical::eval_point(const double theta, const double phi, glm::dvec3 & pos)
+{
+    double r = eval(theta, phi);
+    pos = glm::dvec3(r * sin(phi) * cos(theta), r * sin(phi) * sin(theta), r * cos(phi));
+    return is_defined(r);
+}
 
-    // initialize cursor
-    _cursor_theta =  (_theta_max - _theta_min) / 2.0 + _theta_min;
-    _cursor_phi =  (_phi_max - _phi_min) / 2.0 + _phi_min;
-    _cursor_r = eval(_cursor_theta, _cursor_phi);
-    _cursor_pos.x = _cursor_r * sinf(_cursor_phi) * cosf(_cursor_theta);
-    _cursor_pos.y = _cursor_r * sinf(_cursor_phi) * sinf(_cursor_theta);
-    _cursor_pos.z = _cursor_r * cosf(_cursor_phi);
-    _cursor_defined = std::fpclassify(_cursor_r) == FP_NORMAL || std::fpclassify(_cursor_r) == FP_ZERO;
-    _signal_cursor_moved.emit(cursor_text());
+// evaluate points like eval_point, with a parser of its own
+Graph::Point_eval Graph_spherical::make_point_eval() const
+{
+    std::shared_ptr<Equation_parser> p(new Equation_parser(_eqn, "theta", "phi", Graph_exception::EQN));
+    return [p](const double theta, const double phi, glm::dvec3 & pos)
+    {
+        double r = p->eval(theta, phi);
+        pos = glm::dvec3(r * sin(phi) * cos(theta), r * sin(phi) * sin(theta), r * cos(phi));
+        return is_defined(r);
+    };
 }
 
 // cursor funcs
@@ -296,7 +191,22 @@ void Graph_spherical::move_cursor(const Cursor_dir dir)
     _cursor_pos.x = _cursor_r * sinf(_cursor_phi) * cosf(_cursor_theta);
     _cursor_pos.y = _cursor_r * sinf(_cursor_phi) * sinf(_cursor_theta);
     _cursor_pos.z = _cursor_r * cosf(_cursor_phi);
-    _cursor_defined = std::fpclassify(_cursor_r) == FP_NORMAL || std::fpclassify(_cursor_r) == FP_ZERO;
+    _cursor_defined = is_defined(_cursor_r);
+
+    // signal the move
+    _signal_cursor_moved.emit(cursor_text());
+}
+
+void Graph_spherical::set_cursor(const double theta, const double phi)
+{
+    // evaluate cursors new position
+    _cursor_theta = theta;
+    _cursor_phi = phi;
+    _cursor_r = eval(_cursor_theta, _cursor_phi);
+    _cursor_pos.x = _cursor_r * sinf(_cursor_phi) * cosf(_cursor_theta);
+    _cursor_pos.y = _cursor_r * sinf(_cursor_phi) * sinf(_cursor_theta);
+    _cursor_pos.z = _cursor_r * cosf(_cursor_phi);
+    _cursor_defined = is_defined(_cursor_r);
 
     // signal the move
     _signal_cursor_moved.emit(cursor_text());
@@ -24,6 +24,37 @@
 #define GRAPH_SPHERICAL_H
 
 #include "graph.hpp"
+#include "graph_sampler.hpp"
+
+// Spherical coordinate system policy for sample_graph
+// columns are theta (decreasing), rows are phi
+struct Spherical_coords
+{
+    typedef double Value;
+    typedef Sin_cos Col_data;
+    typedef Sin_cos Row_data;
+
+    Spherical_coords(const double theta_min, const double theta_max, const size_t theta_res,
+        const double phi_min, const double phi_max, const size_t phi_res):
+        columns(theta_max, theta_min, theta_res), rows(phi_min, phi_max, phi_res)
+    {}
+
+    static Col_data col_data(const double theta) { return sin_cos(theta); }
+    static Row_data row_data(const double phi) { return sin_cos(phi); }
+
+    static glm::vec3 transform(const Col_data & theta, const Row_data & phi, const Value r)
+    {
+        return glm::vec3((float)r * phi.s * theta.c, (float)r * phi.s * theta.s, (float)r * phi.c);
+    }
+
+    glm::vec2 tex_coord(const double theta, const double phi, const glm::vec3 & pos) const
+    {
+        return glm::vec2((float)((theta - columns.end) / (columns.start - columns.end)),
+            (float)((phi - rows.start) / (rows.end - rows.start)));
+    }
+
+    Grid_axis columns, rows;
+};
 
 // Spherical graph class - r(θ,ϕ)
 class Graph_spherical final: public Graph
@@ -36,10 +67,17 @@ public:
     // evaluate a point on the graph
     double eval(const double theta, const double phi);
     // calculate & build graph geometry
-    void build_graph() override;
+    void build_graph(const Tile_sink & sink) override;
+    // sample normals on a finer grid, for a normal map
+    void build_normals(const size_t scale, Normal_grid & grid) override;
+    // evaluate a point on the graph in cartesian coordinates
+    bool eval_point(const double theta, const double phi, glm::dvec3 & pos) override;
+    // evaluate points like eval_point, with a parser of its own, for use on other threads
+    Point_eval make_point_eval() const override;
 
     // cursor funcs
     void move_cursor(const Cursor_dir dir) override;
+    void set_cursor(const double theta, const double phi) override;
     glm::vec3 cursor_pos() const override;
     bool cursor_defined() const override;
     // return cursor position as a string
@@ -20,6 +20,10 @@
 // IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "graph.hpp"
 
 Graph_exception::Graph_exception(const mu::Parser::exception_type & mu_e, const Location l):
@@ -31,303 +35,161 @@ Graph_exception::Location Graph_exception::GetLocation() const
     return _location;
 }
 
-// calculate the normal of a point given surrounding points
-glm::vec3 get_normal (glm::vec3 center,
-    glm::vec3 up, bool up_def,
-    glm::vec3 ur, bool ur_def,
-    glm::vec3 rt, bool rt_def,
-    glm::vec3 lr, bool lr_def,
-    glm::vec3 dn, bool dn_def,
-    glm::vec3 ll, bool ll_def,
-    glm::vec3 lf, bool lf_def,
-    glm::vec3 ul, bool ul_def)
+Equation_parser::Equation_parser(const std::string & eqn, const std::string & col_var, const std::string & row_var,
+    const Graph_exception::Location location): _col(0.0), _row(0.0), _location(location)
 {
-    const float epsilon = std::numeric_limits<double>::epsilon() / 2.0f;
-
-    std::vector<glm::dvec3> surrounding;
-
-    // temporary vars
-    glm::dvec3 cr;
-    double length;
-
-    // get tangents through surrounding points
-    glm::dvec3 t_up, t_ur, t_rt, t_lr, t_dn, t_ll, t_lf, t_ul;
+    _p.DefineConst("pi", M_PI);
+    _p.DefineConst("e", M_E);
+    _p.DefineVar(col_var, &_col);
+    _p.DefineVar(row_var, &_row);
+    _p.SetExpr(eqn);
+}
 
-    // check to make sure we have no 0-length vectors, and then normalize
-    if(up_def)
-    {
-        t_up = up - center;
-        length = glm::length(t_up);
-        if(length <= epsilon)
-            up_def = false;
-    }
-    if(ur_def)
-    {
-        t_ur = ur - center;
-        length = glm::length(t_ur);
-        if(length <= epsilon)
-            ur_def = false;
-    }
-    if(rt_def)
-    {
-        t_rt = rt - center;
-        length = glm::length(t_rt);
-        if(length <= epsilon)
-            rt_def = false;
-    }
-    if(lr_def)
-    {
-        t_lr = lr - center;
-        length = glm::length(t_lr);
-        if(length <= epsilon)
-            lr_def = false;
-    }
-    if(dn_def)
-    {
-        t_dn = dn - center;
-        length = glm::length(t_dn);
-        if(length <= epsilon)
-            dn_def = false;
-    }
-    if(ll_def)
-    {
-        t_ll = ll - center;
-        length = glm::length(t_ll);
-        if(length <= epsilon)
-            ll_def = false;
-    }
-    if(lf_def)
+double Equation_parser::eval(const double col_param, const double row_param)
+{
+    _col = col_param; _row = row_param;
+    try
     {
-        t_lf = lf - center;
-        length = glm::length(t_lf);
-        if(length <= epsilon)
-            lf_def = false;
+        return _p.Eval();
     }
-    if(ul_def)
+    catch(const mu::Parser::exception_type & e)
     {
-        t_ul = ul - center;
-        length = glm::length(t_ul);
-        if(length <= epsilon)
-            ul_def = false;
+        Graph_exception ge(e, _location);
+        throw ge;
     }
+}
 
-    // get cross-products from combinations of surrounding points
-    // check for colinearity
-    if(up_def)
-    {
-        if(ur_def)
-        {
-            cr = glm::cross(t_ur, t_up);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(rt_def)
-        {
-            cr = glm::cross(t_rt, t_up);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(lr_def)
-        {
-            cr = glm::cross(t_lr, t_up);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+// calculate normals for a batch of points, given the points surrounding each
+// pts holds a 3x3 stencil of 9 points for each normal, indexed [row offset * 3 + col offset],
+// with the center point at 4. def holds the matching defined flags
+// for each point, cross products are taken between each surrounding tangent and the next 3
+// going around the center, and averaged, flipping any that point the opposite way
+// work is done in fixed size batches in structure-of-arrays form, so the inner loops
+// can be vectorized by the compiler, and nothing is allocated
+void get_normals(const glm::vec3 * pts, const char * def, glm::vec3 * normals, const size_t count)
+{
+    const float epsilon = std::numeric_limits<double>::epsilon() / 2.0f;
+    const float epsilon_sq = epsilon * epsilon;
 
-    if(ur_def)
-    {
-        if(rt_def)
-        {
-            cr = glm::cross(t_rt, t_ur);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(lr_def)
-        {
-            cr = glm::cross(t_lr, t_ur);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(dn_def)
-        {
-            cr = glm::cross(t_dn, t_ur);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+    // stencil index of each surrounding point, going clockwise from up:
+    // up, ur, rt, lr, dn, ll, lf, ul
+    const int dirs[8] = {7, 8, 5, 2, 1, 0, 3, 6};
 
-    if(rt_def)
-    {
-        if(lr_def)
-        {
-            cr = glm::cross(t_lr, t_rt);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(dn_def)
-        {
-            cr = glm::cross(t_dn, t_rt);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(ll_def)
-        {
-            cr = glm::cross(t_ll, t_rt);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+    const size_t batch_size = 64;
 
-    if(lr_def)
-    {
-        if(dn_def)
-        {
-            cr = glm::cross(t_dn, t_lr);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(ll_def)
-        {
-            cr = glm::cross(t_ll, t_lr);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(lf_def)
-        {
-            cr = glm::cross(t_lf, t_lr);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+    // tangents from the center to each surrounding point
+    float t_x[8][batch_size], t_y[8][batch_size], t_z[8][batch_size];
+    float t_def[8][batch_size];
 
-    if(dn_def)
-    {
-        if(ll_def)
-        {
-            cr = glm::cross(t_ll, t_dn);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(lf_def)
-        {
-            cr = glm::cross(t_lf, t_dn);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(ul_def)
-        {
-            cr = glm::cross(t_ul, t_dn);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+    // running sum of normals
+    float n_x[batch_size], n_y[batch_size], n_z[batch_size];
+    float n_count[batch_size];
 
-    if(ll_def)
+    for(size_t batch = 0; batch < count; batch += batch_size)
     {
-        if(lf_def)
-        {
-            cr = glm::cross(t_lf, t_ll);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(ul_def)
-        {
-            cr = glm::cross(t_ul, t_ll);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(up_def)
-        {
-            cr = glm::cross(t_up, t_ll);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-    }
+        const size_t size = std::min(batch_size, count - batch);
+        const glm::vec3 * batch_pts = pts + batch * 9;
+        const char * batch_def = def + batch * 9;
 
-    if(lf_def)
-    {
-        if(ul_def)
+        // get tangents through surrounding points
+        // check to make sure we have no 0-length vectors
+        for(int d = 0; d < 8; ++d)
         {
-            cr = glm::cross(t_ul, t_lf);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(up_def)
-        {
-            cr = glm::cross(t_up, t_lf);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
-        }
-        if(ur_def)
-        {
-            cr = glm::cross(t_ur, t_lf);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
+            for(size_t i = 0; i < size; ++i)
+            {
+                const glm::vec3 & center = batch_pts[i * 9 + 4];
+                const glm::vec3 & pt = batch_pts[i * 9 + dirs[d]];
+
+                t_x[d][i] = pt.x - center.x;
+                t_y[d][i] = pt.y - center.y;
+                t_z[d][i] = pt.z - center.z;
+
+                float len_sq = t_x[d][i] * t_x[d][i] + t_y[d][i] * t_y[d][i] + t_z[d][i] * t_z[d][i];
+                t_def[d][i] = (float)((batch_def[i * 9 + dirs[d]] != 0) & (len_sq > epsilon_sq));
+            }
         }
-    }
 
-    if(ul_def)
-    {
-        if(up_def)
+        for(size_t i = 0; i < size; ++i)
         {
-            cr = glm::cross(t_up, t_ul);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
+            n_x[i] = n_y[i] = n_z[i] = 0.0f;
+            n_count[i] = 0.0f;
         }
-        if(ur_def)
+
+        // get cross-products from combinations of surrounding points
+        // check for colinearity, and add to running total (for averaging)
+        for(int a = 0; a < 8; ++a)
         {
-            cr = glm::cross(t_ur, t_ul);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
+            for(int k = 1; k <= 3; ++k)
+            {
+                const int b = (a + k) % 8;
+
+                for(size_t i = 0; i < size; ++i)
+                {
+                    float cr_x = t_y[b][i] * t_z[a][i] - t_z[b][i] * t_y[a][i];
+                    float cr_y = t_z[b][i] * t_x[a][i] - t_x[b][i] * t_z[a][i];
+                    float cr_z = t_x[b][i] * t_y[a][i] - t_y[b][i] * t_x[a][i];
+
+                    float len_sq = cr_x * cr_x + cr_y * cr_y + cr_z * cr_z;
+                    float valid = t_def[a][i] * t_def[b][i] * (float)(len_sq > epsilon_sq);
+
+                    // zero length for invalid products, so they don't contribute
+                    float scale = valid / std::sqrt(std::max(len_sq, epsilon_sq));
+                    cr_x *= scale;
+                    cr_y *= scale;
+                    cr_z *= scale;
+
+                    // invert inverted normals
+                    // |n + c| > |n| for unit length c is equivalent to 2 n.c + 1 > 0
+                    float dot = n_x[i] * cr_x + n_y[i] * cr_y + n_z[i] * cr_z;
+                    float sign = 2.0f * (float)(2.0f * dot + 1.0f > 0.0f) - 1.0f;
+
+                    n_x[i] += sign * cr_x;
+                    n_y[i] += sign * cr_y;
+                    n_z[i] += sign * cr_z;
+                    n_count[i] += valid;
+                }
+            }
         }
-        if(rt_def)
+
+        for(size_t i = 0; i < size; ++i)
         {
-            cr = glm::cross(t_rt, t_ul);
-            length = glm::length(cr);
-            if(length > epsilon)
-                surrounding.push_back(cr / length);
+            float len = std::sqrt(n_x[i] * n_x[i] + n_y[i] * n_y[i] + n_z[i] * n_z[i]);
+
+            // check to see if we have a good vector before normalizing (to prevent div by 0)
+            if(n_count[i] > 0.0f && len > epsilon)
+                normals[batch + i] = glm::vec3(n_x[i] / len, n_y[i] / len, n_z[i] / len);
+            else
+                // fall back to up vector
+                normals[batch + i] = glm::vec3(0.0f, 0.0f, 1.0f);
         }
     }
+}
 
-    // add surrounding vectors together (for averaging)
-    glm::dvec3 normal(0.0f);
-    for(auto &i: surrounding)
-    {
-        // invert inverted normals
-        if(glm::length(normal + i) > glm::length(normal))
-            normal += i;
-        else
-            normal -= i;
-    }
+// distance along a ray to where it hits a triangle, or infinity if it misses (Möller–Trumbore)
+// bary is set to the barycentric coords of the hit, relative to b and c
+float intersect_triangle(const glm::vec3 & origin, const glm::vec3 & dir,
+    const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c, glm::vec2 & bary)
+{
+    const float miss = std::numeric_limits<float>::infinity();
+
+    glm::vec3 edge_b = b - a;
+    glm::vec3 edge_c = c - a;
+    glm::vec3 p = glm::cross(dir, edge_c);
+    float det = glm::dot(edge_b, p);
+
+    if(std::abs(det) < std::numeric_limits<float>::min())
+        return miss;
+
+    glm::vec3 s = origin - a;
+    bary.x = glm::dot(s, p) / det;
+    if(bary.x < 0.0f || bary.x > 1.0f)
+        return miss;
+
+    glm::vec3 q = glm::cross(s, edge_b);
+    bary.y = glm::dot(dir, q) / det;
+    if(bary.y < 0.0f || bary.x + bary.y > 1.0f)
+        return miss;
 
-    // check to see if we have a good vector before normalizing (to prevent div by 0)
-    if(surrounding.size() > 0 && glm::length(normal) > epsilon)
-        return glm::vec3(glm::normalize(normal));
-    else
-        // fall back to up vector
-        return glm::vec3(0.0f, 0.0f, 1.0f);
+    float dist = glm::dot(edge_c, q) / det;
+    return dist >= 0.0f ? dist : miss;
 }
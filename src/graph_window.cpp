@@ -41,6 +41,8 @@ Graph_window::Graph_window():
     _gl_window(sf::VideoMode(800, 600), -1, sf::ContextSettings(24, 8, 8, 3, 3)),
     _draw_axes("Draw Axes"),
     _draw_cursor("Draw Cursor"),
+    _draw_intersections("Draw Intersections"),
+    _slice("Slice Graphs"),
     _use_orbit_cam("Use Orbiting Camera"),
     _use_free_cam("Use Free Camera")
 {
@@ -111,6 +113,7 @@ Graph_window::Graph_window():
     _notebook.set_scrollable(true);
 
     _cursor_text.set_halign(Gtk::ALIGN_CENTER);
+    _measurement_text.set_halign(Gtk::ALIGN_CENTER);
 
     Gtk::Grid * main_grid = new Gtk::Grid;
     Gtk::Grid * toolbar = new Gtk::Grid;
@@ -151,16 +154,19 @@ Graph_window::Graph_window():
     toolbar->attach(*Gtk::manage(new Gtk::Separator(Gtk::ORIENTATION_VERTICAL)), 2, 0, 1, 1);
     toolbar->attach(_draw_axes, 3, 0, 1, 1);
     toolbar->attach(_draw_cursor, 4, 0, 1, 1);
-    toolbar->attach(*Gtk::manage(new Gtk::Separator(Gtk::ORIENTATION_VERTICAL)), 5, 0, 1, 1);
-    toolbar->attach(_use_orbit_cam, 6, 0, 1, 1);
-    toolbar->attach(_use_free_cam, 7, 0, 1, 1);
-    toolbar->attach(*reset_cam_butt, 8, 0, 1, 1);
-    toolbar->attach(*tool_sep, 9, 0, 1, 1);
-    toolbar->attach(*add_butt, 10, 0, 1, 1);
+    toolbar->attach(_draw_intersections, 5, 0, 1, 1);
+    toolbar->attach(_slice, 6, 0, 1, 1);
+    toolbar->attach(*Gtk::manage(new Gtk::Separator(Gtk::ORIENTATION_VERTICAL)), 7, 0, 1, 1);
+    toolbar->attach(_use_orbit_cam, 8, 0, 1, 1);
+    toolbar->attach(_use_free_cam, 9, 0, 1, 1);
+    toolbar->attach(*reset_cam_butt, 10, 0, 1, 1);
+    toolbar->attach(*tool_sep, 11, 0, 1, 1);
+    toolbar->attach(*add_butt, 12, 0, 1, 1);
 
     main_grid->attach(_gl_window, 0, 2, 1, 1);
     main_grid->attach(_notebook, 1, 2, 1, 1);
     main_grid->attach(_cursor_text, 0, 3, 2, 1);
+    main_grid->attach(_measurement_text, 0, 4, 2, 1);
 
     save_butt->signal_clicked().connect(sigc::mem_fun(*this, &Graph_window::save_graph));
     load_butt->signal_clicked().connect(sigc::mem_fun(*this, &Graph_window::load_graph));
@@ -170,6 +176,8 @@ Graph_window::Graph_window():
 
     _draw_axes.signal_toggled().connect(sigc::mem_fun(*this, &Graph_window::change_flags));
     _draw_cursor.signal_toggled().connect(sigc::mem_fun(*this, &Graph_window::change_flags));
+    _draw_intersections.signal_toggled().connect(sigc::mem_fun(*this, &Graph_window::change_flags));
+    _slice.signal_toggled().connect(sigc::mem_fun(*this, &Graph_window::change_flags));
 
     Gtk::RadioButton::Group cam_g = _use_orbit_cam.get_group();
     _use_free_cam.set_group(cam_g);
@@ -334,6 +342,9 @@ void Graph_window::change_flags()
     // pass changes to GL display
     _gl_window.draw_axes_flag = _draw_axes.get_active();
     _gl_window.draw_cursor_flag = _draw_cursor.get_active();
+    _gl_window.draw_intersections_flag = _draw_intersections.get_active();
+    _gl_window.update_intersections();
+    _gl_window.slice_flag = _slice.get_active();
 
     if(!_draw_cursor.get_active())
         update_cursor("");
@@ -408,6 +419,12 @@ void Graph_window::update_cursor(const std::string & text)
     _cursor_text.set_text(text);
 }
 
+// update measurement text
+void Graph_window::update_measurement(const std::string & text)
+{
+    _measurement_text.set_text(text);
+}
+
 // create a new graph page
 void Graph_window::tab_new()
 {
@@ -434,7 +451,10 @@ void Graph_window::tab_close(Graph_page & page)
     {
         if(_cursor_conn.connected())
             _cursor_conn.disconnect();
+        if(_measured_conn.connected())
+            _measured_conn.disconnect();
         _cursor_text.set_text("");
+        _measurement_text.set_text("");
     }
     guint page_no = _notebook.page_num(page);
     _notebook.remove_page(page);
@@ -444,12 +464,15 @@ void Graph_window::tab_close(Graph_page & page)
 // change active graph
 void Graph_window::tab_change(Gtk::Widget * page, guint page_no)
 {
-    // disconnect existing cursor signal
+    // disconnect existing cursor and measurement signals
     if(_cursor_conn.connected())
         _cursor_conn.disconnect();
+    if(_measured_conn.connected())
+        _measured_conn.disconnect();
 
-    // connect the new one
+    // connect the new ones
     _cursor_conn = dynamic_cast<Graph_page &>(*page).signal_cursor_moved().connect(sigc::mem_fun(*this, &Graph_window::update_cursor));
+    _measured_conn = dynamic_cast<Graph_page &>(*page).signal_measured().connect(sigc::mem_fun(*this, &Graph_window::update_measurement));
 
     // tell the page that it is now active
     dynamic_cast<Graph_page &>(*page).set_active();
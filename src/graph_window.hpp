@@ -65,6 +65,8 @@ private:
     void about();
     // update cursor text
     void update_cursor(const std::string & text);
+    // update measurement text
+    void update_measurement(const std::string & text);
     // create a new graph page
     void tab_new();
     // close a graph page and delete the graph
@@ -77,10 +79,12 @@ private:
     // widgets
     Graph_disp _gl_window;
     Gtk::Label _cursor_text;
-    Gtk::CheckButton _draw_axes, _draw_cursor;
+    Gtk::Label _measurement_text;
+    Gtk::CheckButton _draw_axes, _draw_cursor, _draw_intersections, _slice;
     Gtk::RadioButton _use_orbit_cam, _use_free_cam;
 
     sigc::connection _cursor_conn;
+    sigc::connection _measured_conn;
 
     std::vector<std::string> _startup_files;
 
@@ -0,0 +1,82 @@
+// index_buffer.cpp
+// 16 bit index buffers, shared between graphs with the same topology
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <tuple>
+
+#include "index_buffer.hpp"
+
+Index_buffers::Index_buffers(const GLuint ebo, const GLuint grid_ebo,
+    const std::vector<Mesh_chunk> & chunks, const std::vector<Mesh_chunk> & grid_chunks,
+    const GLenum mode):
+    ebo(ebo), grid_ebo(grid_ebo), chunks(chunks), grid_chunks(grid_chunks), mode(mode)
+{}
+
+Index_buffers::~Index_buffers()
+{
+    if(ebo)
+        glDeleteBuffers(1, &ebo);
+    if(grid_ebo)
+        glDeleteBuffers(1, &grid_ebo);
+}
+
+bool Index_buffer_cache::Key::operator<(const Key & other) const
+{
+    return std::tie(num_rows, num_columns, first_row, defined_hash, optimize_order, index_size, grid_size)
+        < std::tie(other.num_rows, other.num_columns, other.first_row, other.defined_hash, other.optimize_order,
+            other.index_size, other.grid_size);
+}
+
+// cache shared by the whole program
+Index_buffer_cache & Index_buffer_cache::get()
+{
+    static Index_buffer_cache cache;
+    return cache;
+}
+
+// look up buffers. returns null if there are none for key
+std::shared_ptr<const Index_buffers> Index_buffer_cache::find(const Key & key)
+{
+    auto entry = _entries.find(key);
+    if(entry == _entries.end())
+        return nullptr;
+
+    auto buffers = entry->second.lock();
+    if(!buffers)
+        _entries.erase(entry);
+
+    return buffers;
+}
+
+// add buffers to the cache
+void Index_buffer_cache::insert(const Key & key, const std::shared_ptr<const Index_buffers> & buffers)
+{
+    // clear out entries for buffers that have been freed
+    for(auto i = _entries.begin(); i != _entries.end();)
+    {
+        if(i->second.expired())
+            i = _entries.erase(i);
+        else
+            ++i;
+    }
+
+    _entries[key] = buffers;
+}
@@ -0,0 +1,111 @@
+// index_buffer.hpp
+// 16 bit index buffers, shared between graphs with the same topology
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <SFML/OpenGL.hpp>
+
+// a range of 16 bit indexes, relative to a base vertex
+// graphs are split into chunks of rows, each with no more than 65535 verticies
+struct Mesh_chunk
+{
+    GLint base_vertex;
+    size_t index_begin, index_count;
+};
+
+// restart marker for 16 bit indexes
+const GLushort restart_index = 0xFFFF;
+
+// surface and grid line index buffers for a section of a graph
+// owns the OpenGL buffers, which are deleted along with it
+struct Index_buffers
+{
+    Index_buffers(const GLuint ebo, const GLuint grid_ebo,
+        const std::vector<Mesh_chunk> & chunks, const std::vector<Mesh_chunk> & grid_chunks,
+        const GLenum mode = GL_TRIANGLE_STRIP);
+    ~Index_buffers();
+
+    GLuint ebo;
+    GLuint grid_ebo;
+    std::vector<Mesh_chunk> chunks;
+    std::vector<Mesh_chunk> grid_chunks;
+    // primitive type for ebo
+    GLenum mode;
+
+    // make non-copyable
+    Index_buffers(const Index_buffers &) = delete;
+    Index_buffers(const Index_buffers &&) = delete;
+    Index_buffers & operator=(const Index_buffers &) = delete;
+    Index_buffers & operator=(const Index_buffers &&) = delete;
+};
+
+// index buffers for graph sections, keyed by their topology
+// buffers are reference counted by the graphs using them, and are freed when the last one is done
+// must only be used from the thread with the OpenGL context
+class Index_buffer_cache
+{
+public:
+    // everything the index buffer contents depend on
+    struct Key
+    {
+        size_t num_rows, num_columns;
+        // first row of the section of the graph the buffers are for
+        size_t first_row;
+        // hash of the section's defined mask
+        uint64_t defined_hash;
+        bool optimize_order;
+        // a cheap guard against hash collisions
+        size_t index_size, grid_size;
+
+        bool operator<(const Key & other) const;
+    };
+
+    // cache shared by the whole program
+    static Index_buffer_cache & get();
+
+    // look up buffers. returns null if there are none for key
+    std::shared_ptr<const Index_buffers> find(const Key & key);
+
+    // add buffers to the cache
+    void insert(const Key & key, const std::shared_ptr<const Index_buffers> & buffers);
+
+private:
+    Index_buffer_cache() = default;
+
+    std::map<Key, std::weak_ptr<const Index_buffers>> _entries;
+
+    // make non-copyable
+    Index_buffer_cache(const Index_buffer_cache &) = delete;
+    Index_buffer_cache(const Index_buffer_cache &&) = delete;
+    Index_buffer_cache & operator=(const Index_buffer_cache &) = delete;
+    Index_buffer_cache & operator=(const Index_buffer_cache &&) = delete;
+};
+
+#endif // INDEX_BUFFER_H
@@ -0,0 +1,166 @@
+// marching_cubes.cpp
+// triangle table for marching cubes
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "marching_cubes.hpp"
+
+// edge between two corners that differ in one coordinate
+static unsigned char corner_edge(const unsigned char a, const unsigned char b)
+{
+    const unsigned char low = a & b;
+    const int axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+    return axis * 4 + ((low >> u) & 1) + (((low >> v) & 1) << 1);
+}
+
+static std::array<std::array<unsigned char, 2>, 12> build_edges()
+{
+    std::array<std::array<unsigned char, 2>, 12> edges;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for(int k = 0; k < 4; ++k)
+        {
+            unsigned char low = ((k & 1) << u) | (((k >> 1) & 1) << v);
+            edges[axis * 4 + k] = {{low, (unsigned char)(low | (1 << axis))}};
+        }
+    }
+    return edges;
+}
+
+const std::array<std::array<unsigned char, 2>, 12> marching_cubes_edges = build_edges();
+
+// connect the edges where the surface crosses each face into loops, and fill the loops with triangles
+// on each face, walking its corners counter-clockwise as seen from outside, each edge where the walk
+// goes inside is joined to the next edge where it comes back out. the surface crosses the face along
+// those segments, and since every face is walked from outside, the loops all turn the same way
+static Marching_cubes_case build_case(const unsigned int inside, const bool flip)
+{
+    Marching_cubes_case result = {};
+
+    int next[12];
+    for(auto & n: next)
+        n = -1;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for(int side = 0; side < 2; ++side)
+        {
+            // counter-clockwise around +axis, reversed for the face looking down -axis
+            const int order[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+            unsigned char corners[4];
+            for(int i = 0; i < 4; ++i)
+            {
+                const int * uv = order[side ? i : 3 - i];
+                corners[i] = (side << axis) | (uv[0] << u) | (uv[1] << v);
+            }
+
+            for(int i = 0; i < 4; ++i)
+            {
+                const unsigned char a = corners[i], b = corners[(i + 1) % 4];
+                if(((inside >> a) & 1) || !((inside >> b) & 1))
+                    continue;
+
+                // going in between a and b. find where the walk comes back out
+                for(int j = 1; j < 4; ++j)
+                {
+                    const unsigned char c = corners[(i + j) % 4], d = corners[(i + j + 1) % 4];
+                    if(((inside >> c) & 1) && !((inside >> d) & 1))
+                    {
+                        next[corner_edge(a, b)] = corner_edge(c, d);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    bool used[12] = {};
+    for(int start = 0; start < 12; ++start)
+    {
+        if(next[start] < 0 || used[start])
+            continue;
+
+        int loop[12];
+        int loop_size = 0;
+        for(int e = start; !used[e]; e = next[e])
+        {
+            used[e] = true;
+            loop[loop_size++] = e;
+        }
+
+        for(int i = 1; i + 1 < loop_size; ++i)
+        {
+            unsigned char * tri = result.edges[result.num_triangles++];
+            tri[0] = loop[0];
+            tri[1] = loop[flip ? i + 1 : i];
+            tri[2] = loop[flip ? i : i + 1];
+        }
+    }
+
+    return result;
+}
+
+static std::array<Marching_cubes_case, 256> build_table()
+{
+    // find which way the loops turn from the case with only corner 0 inside,
+    // and flip them if needed to wind counter-clockwise from outside
+    Marching_cubes_case corner = build_case(1, false);
+
+    auto edge_midpoint = [](const int edge)
+    {
+        std::array<float, 3> pt;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            pt[axis] = 0.5f * (((marching_cubes_edges[edge][0] >> axis) & 1)
+                + ((marching_cubes_edges[edge][1] >> axis) & 1));
+        }
+        return pt;
+    };
+
+    std::array<float, 3> a = edge_midpoint(corner.edges[0][0]);
+    std::array<float, 3> b = edge_midpoint(corner.edges[0][1]);
+    std::array<float, 3> c = edge_midpoint(corner.edges[0][2]);
+    std::array<float, 3> ab = {{b[0] - a[0], b[1] - a[1], b[2] - a[2]}};
+    std::array<float, 3> ac = {{c[0] - a[0], c[1] - a[1], c[2] - a[2]}};
+
+    // corner 0 is at the origin, so the triangle's normal should point away from it
+    float normal_dot_pos = (ab[1] * ac[2] - ab[2] * ac[1]) * a[0]
+        + (ab[2] * ac[0] - ab[0] * ac[2]) * a[1]
+        + (ab[0] * ac[1] - ab[1] * ac[0]) * a[2];
+    const bool flip = normal_dot_pos < 0.0f;
+
+    std::array<Marching_cubes_case, 256> table;
+    for(unsigned int inside = 0; inside < 256; ++inside)
+        table[inside] = build_case(inside, flip);
+
+    return table;
+}
+
+// triangles for each case, indexed by a mask of which corners are inside
+const std::array<Marching_cubes_case, 256> & marching_cubes_table()
+{
+    static const std::array<Marching_cubes_case, 256> table = build_table();
+    return table;
+}
@@ -0,0 +1,48 @@
+// marching_cubes.hpp
+// triangle table for marching cubes
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef MARCHING_CUBES_H
+#define MARCHING_CUBES_H
+
+#include <array>
+
+// cube corners are numbered by their offset from corner 0: bit 0 is x, bit 1 is y, bit 2 is z.
+// edges are numbered axis * 4 + k, where k is the corner offset along the other two axes
+// (in the order (axis + 1) % 3, (axis + 2) % 3)
+
+// corners at each end of an edge. the first is the one with the lower coordinate
+extern const std::array<std::array<unsigned char, 2>, 12> marching_cubes_edges;
+
+// triangles for one arrangement of corners inside the surface, as triples of edge numbers
+// triangles are wound counter-clockwise when seen from outside
+struct Marching_cubes_case
+{
+    unsigned char num_triangles;
+    unsigned char edges[12][3];
+};
+
+// triangles for each case, indexed by a mask of which corners are inside (bit n for corner n)
+// faces with 2 inside corners on opposite diagonals are split so that the inside corners are
+// kept apart. neighboring cubes agree on this, so the surface is closed
+const std::array<Marching_cubes_case, 256> & marching_cubes_table();
+
+#endif // MARCHING_CUBES_H
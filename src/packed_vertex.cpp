@@ -0,0 +1,96 @@
+// packed_vertex.cpp
+// compact interleaved vertex format for graphs and the cursor
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cmath>
+#include <cstddef>
+
+#include "packed_vertex.hpp"
+
+// encode a vertex
+Packed_vertex pack_vertex(const glm::vec3 & pos, const glm::vec2 & tex_coords, const glm::vec3 & normal)
+{
+    return Packed_vertex{pos, glm::packHalf2x16(tex_coords), glm::packSnorm2x16(octahedral_encode(normal))};
+}
+
+// map a unit vector onto the [-1, 1] square
+// project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half out over the corners
+glm::vec2 octahedral_encode(const glm::vec3 & normal)
+{
+    float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+
+    // zero length normals get encoded as +z
+    if(l1 == 0.0f)
+        return glm::vec2(0.0f, 0.0f);
+
+    glm::vec2 enc(normal.x / l1, normal.y / l1);
+
+    if(normal.z < 0.0f)
+    {
+        enc = glm::vec2((1.0f - std::fabs(enc.y)) * (enc.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::fabs(enc.x)) * (enc.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    return enc;
+}
+
+// encode a vertex
+Height_vertex pack_height_vertex(const float height, const glm::vec3 & normal)
+{
+    return Height_vertex{height, glm::packSnorm2x16(octahedral_encode(normal))};
+}
+
+// set attribute pointers for Packed_vertex data in the bound GL_ARRAY_BUFFER
+void set_packed_vertex_attribs()
+{
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Packed_vertex),
+        (const GLvoid *)offsetof(Packed_vertex, pos));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Packed_vertex),
+        (const GLvoid *)offsetof(Packed_vertex, tex_coords));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(Packed_vertex),
+        (const GLvoid *)offsetof(Packed_vertex, normal));
+    glEnableVertexAttribArray(2);
+}
+
+// set attribute pointers for Height_vertex data in the bound GL_ARRAY_BUFFER
+void set_height_vertex_attribs()
+{
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(Height_vertex),
+        (const GLvoid *)offsetof(Height_vertex, height));
+    glEnableVertexAttribArray(0);
+
+    glDisableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(Height_vertex),
+        (const GLvoid *)offsetof(Height_vertex, normal));
+    glEnableVertexAttribArray(2);
+}
+
+// set attribute pointers for baked ambient occlusion in the bound GL_ARRAY_BUFFER
+void set_occlusion_attribs()
+{
+    glVertexAttribPointer(3, 2, GL_UNSIGNED_BYTE, GL_TRUE, 2 * sizeof(GLubyte), (const GLvoid *)0);
+    glEnableVertexAttribArray(3);
+}
@@ -0,0 +1,77 @@
+// packed_vertex.hpp
+// compact interleaved vertex format for graphs and the cursor
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef PACKED_VERTEX_H
+#define PACKED_VERTEX_H
+
+#include <GL/glew.h>
+
+#include <SFML/OpenGL.hpp>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// 20 bytes per vertex, vs. 32 for separate float arrays
+// positions are full floats, so tiles can be uploaded before the graph's bounds are known
+// tex coords are half floats, to allow for values outside of [0, 1] (textures repeat)
+// normals are octahedral encoded into 2 16 bit signed normalized values
+// decoded in graph.vert
+struct Packed_vertex
+{
+    glm::vec3 pos;
+    GLuint tex_coords;
+    GLuint normal;
+};
+
+// encode a vertex
+Packed_vertex pack_vertex(const glm::vec3 & pos, const glm::vec2 & tex_coords, const glm::vec3 & normal);
+
+// map a unit vector onto the [-1, 1] square
+glm::vec2 octahedral_encode(const glm::vec3 & normal);
+
+// set attribute pointers for Packed_vertex data in the bound GL_ARRAY_BUFFER
+// location 0: position, 1: tex coords, 2: encoded normal
+void set_packed_vertex_attribs();
+
+// 8 byte vertex for graphs on an implicit grid (see Graph::Implicit_grid)
+// x, y, and tex coords are rebuilt from the vertex index in the vertex shader.
+// undefined verticies are never indexed, so they need no flag
+struct Height_vertex
+{
+    GLfloat height;
+    GLuint normal;
+};
+
+// encode a vertex
+Height_vertex pack_height_vertex(const float height, const glm::vec3 & normal);
+
+// set attribute pointers for Height_vertex data in the bound GL_ARRAY_BUFFER
+// location 0: height (as x), 2: encoded normal. location 1 is unused
+void set_height_vertex_attribs();
+
+// baked ambient occlusion is kept in its own VBO, so graphs without it pay nothing.
+// 2 unsigned normalized bytes per vertex: light reaching the front and the back of the surface
+// set attribute pointers for it in the bound GL_ARRAY_BUFFER, at location 3.
+// when the array is disabled, the shaders get the default value set by Graph_disp (no occlusion)
+void set_occlusion_attribs();
+
+#endif // PACKED_VERTEX_H
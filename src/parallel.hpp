@@ -0,0 +1,377 @@
+// parallel.hpp
+// threading helpers for building graph geometry
+
+// Copyright 2018 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed capacity FIFO queue for passing work between threads
+// push blocks while full, pop blocks while empty
+template<typename T>
+class Bounded_queue
+{
+public:
+    explicit Bounded_queue(const size_t capacity): _capacity(capacity)
+    {}
+
+    // add an item to the queue. returns false if the queue has been cancelled
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this](){ return _queue.size() < _capacity || _cancelled; });
+
+        if(_cancelled)
+            return false;
+
+        _queue.push(std::move(item));
+        _not_empty.notify_one();
+        return true;
+    }
+
+    // remove an item from the queue.
+    // returns false once the queue is closed and empty, or has been cancelled
+    bool pop(T & item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this](){ return !_queue.empty() || _closed || _cancelled; });
+
+        if(_cancelled || _queue.empty())
+            return false;
+
+        item = std::move(_queue.front());
+        _queue.pop();
+        _not_full.notify_one();
+        return true;
+    }
+
+    // signal that no more items will be pushed
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _closed = true;
+        _not_empty.notify_all();
+    }
+
+    // abandon the queue, waking up any waiting threads
+    void cancel()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cancelled = true;
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+private:
+    std::queue<T> _queue;
+    size_t _capacity;
+    bool _closed = false;
+    bool _cancelled = false;
+
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+
+    // make non-copyable
+    Bounded_queue(const Bounded_queue &) = delete;
+    Bounded_queue(const Bounded_queue &&) = delete;
+    Bounded_queue & operator=(const Bounded_queue &) = delete;
+    Bounded_queue & operator=(const Bounded_queue &&) = delete;
+};
+
+// a set of stages, each running on its own thread, connected by Bounded_queues
+// if any stage throws, all queues are cancelled, and the exception is rethrown by join
+class Pipeline
+{
+public:
+    Pipeline() = default;
+
+    ~Pipeline()
+    {
+        // if we're being destroyed early (an exception on the calling thread), stop the stages
+        if(!_threads.empty())
+        {
+            cancel();
+            for(auto & t: _threads)
+                t.join();
+        }
+    }
+
+    // register a queue to be cancelled when a stage fails
+    template<typename T>
+    void add_queue(Bounded_queue<T> & queue)
+    {
+        _cancel_funcs.push_back([&queue](){ queue.cancel(); });
+    }
+
+    // start a stage which produces items. it is responsible for closing its output queue
+    void add_source(const std::function<void()> & func)
+    {
+        _threads.emplace_back([this, func]()
+        {
+            try
+            {
+                func();
+            }
+            catch(...)
+            {
+                fail(std::current_exception());
+            }
+        });
+    }
+
+    // start a stage which pops items from in, calls func on them, and pushes them to out
+    template<typename In, typename Out, typename Func>
+    void add_stage(Bounded_queue<In> & in, Bounded_queue<Out> & out, Func func)
+    {
+        add_source([&in, &out, func]()
+        {
+            In item;
+            while(in.pop(item))
+            {
+                if(!out.push(func(item)))
+                    return;
+            }
+            out.close();
+        });
+    }
+
+    // wait for all stages to finish. rethrows the first exception thrown by any stage
+    void join()
+    {
+        for(auto & t: _threads)
+            t.join();
+        _threads.clear();
+
+        if(_error)
+            std::rethrow_exception(_error);
+    }
+
+    // abandon the work in progress. every stage stops at its next push or pop
+    // can be called from a stage. join still waits for them
+    void cancel()
+    {
+        for(auto & f: _cancel_funcs)
+            f();
+    }
+
+private:
+    // record an exception and shut down the pipeline
+    void fail(const std::exception_ptr & e)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_error_mutex);
+            if(!_error)
+                _error = e;
+        }
+        cancel();
+    }
+
+    std::vector<std::thread> _threads;
+    std::vector<std::function<void()>> _cancel_funcs;
+
+    std::exception_ptr _error;
+    std::mutex _error_mutex;
+
+    // make non-copyable
+    Pipeline(const Pipeline &) = delete;
+    Pipeline(const Pipeline &&) = delete;
+    Pipeline & operator=(const Pipeline &) = delete;
+    Pipeline & operator=(const Pipeline &&) = delete;
+};
+
+// fixed set of worker threads for splitting loops across all cores
+class Thread_pool
+{
+public:
+    explicit Thread_pool(const size_t num_threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        // the calling thread does work too, so we need one fewer
+        for(size_t i = 1; i < num_threads; ++i)
+            _threads.emplace_back(&Thread_pool::worker, this);
+    }
+
+    ~Thread_pool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _cond.notify_all();
+
+        for(auto & t: _threads)
+            t.join();
+    }
+
+    // pool shared by the whole program
+    static Thread_pool & get()
+    {
+        static Thread_pool pool;
+        return pool;
+    }
+
+    size_t num_threads() const
+    {
+        return _threads.size() + 1;
+    }
+
+    // call func(i) for each i in [begin, end), split into contiguous blocks over the pool
+    // blocks until all calls are complete, and rethrows the first exception thrown by func
+    template<typename Func>
+    void parallel_for(const size_t begin, const size_t end, const Func & func)
+    {
+        if(begin >= end)
+            return;
+
+        // a few blocks per thread, to even out blocks that take longer
+        const size_t max_blocks = std::min(end - begin, num_threads() * 4);
+        const size_t block_size = (end - begin + max_blocks - 1) / max_blocks;
+        const size_t num_blocks = (end - begin + block_size - 1) / block_size;
+
+        auto state = std::make_shared<Loop_state>();
+        state->remaining = num_blocks;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for(size_t block_begin = begin; block_begin < end; block_begin += block_size)
+            {
+                size_t block_end = std::min(block_begin + block_size, end);
+                _jobs.push([state, &func, block_begin, block_end]()
+                {
+                    try
+                    {
+                        for(size_t i = block_begin; i < block_end; ++i)
+                            func(i);
+                    }
+                    catch(...)
+                    {
+                        std::unique_lock<std::mutex> lock(state->mutex);
+                        if(!state->error)
+                            state->error = std::current_exception();
+                    }
+
+                    if(--state->remaining == 0)
+                    {
+                        std::unique_lock<std::mutex> lock(state->mutex);
+                        state->done.notify_all();
+                    }
+                });
+            }
+        }
+        _cond.notify_all();
+
+        // help out until the queue is empty, then wait for the stragglers
+        while(state->remaining > 0 && run_job())
+        {}
+
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->done.wait(lock, [&state](){ return state->remaining == 0; });
+        }
+
+        if(state->error)
+            std::rethrow_exception(state->error);
+    }
+
+    // call func(state, i) for each i in [begin, end), where each call gets one of states to itself,
+    // for work that needs its own copy of something on each thread (like a muparser object).
+    // there's one call per state, each taking items from a shared counter until they run out
+    template<typename State, typename Func>
+    void parallel_for(std::vector<State> & states, const size_t begin, const size_t end, const Func & func)
+    {
+        std::atomic<size_t> next(begin);
+        parallel_for(0, states.size(), [&](const size_t s)
+        {
+            for(size_t i = next++; i < end; i = next++)
+                func(states[s], i);
+        });
+    }
+
+private:
+    // completion tracking for one parallel_for call
+    struct Loop_state
+    {
+        std::atomic<size_t> remaining;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    // run one queued job, if there is one
+    bool run_job()
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_jobs.empty())
+                return false;
+
+            job = std::move(_jobs.front());
+            _jobs.pop();
+        }
+        job();
+        return true;
+    }
+
+    void worker()
+    {
+        while(true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [this](){ return !_jobs.empty() || _quit; });
+
+                if(_quit)
+                    return;
+
+                job = std::move(_jobs.front());
+                _jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    std::queue<std::function<void()>> _jobs;
+    bool _quit = false;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+
+    // make non-copyable
+    Thread_pool(const Thread_pool &) = delete;
+    Thread_pool(const Thread_pool &&) = delete;
+    Thread_pool & operator=(const Thread_pool &) = delete;
+    Thread_pool & operator=(const Thread_pool &&) = delete;
+};
+
+#endif // PARALLEL_H